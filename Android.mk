@@ -54,6 +54,14 @@ ifeq ($(KERNELFLINGER_DISABLE_DEBUG_PRINT),true)
     EFIWRAPPER_CFLAGS += -DDISABLE_DEBUG_PRINT
 endif
 
+ifeq ($(EFIWRAPPER_PROFILE_SERVICES),true)
+    EFIWRAPPER_CFLAGS += -DPROFILE_SERVICES
+endif
+
+ifeq ($(EFIWRAPPER_TRACE_EVENTS),true)
+    EFIWRAPPER_CFLAGS += -DTRACE_EVENTS
+endif
+
 ifeq ($(IOC_USE_SLCAN),true)
     EFIWRAPPER_CFLAGS += -DIOC_USE_SLCAN
 else ifeq ($(IOC_USE_CBC),true)
@@ -65,7 +73,8 @@ EFIWRAPPER_HOST_CFLAGS := \
 	-fshort-wchar \
 	-DEFI_FUNCTION_WRAPPER \
 	-DGNU_EFI_USE_MS_ABI \
-	-DHOST
+	-DHOST \
+	-DTRACE_EVENTS
 
 ifeq ($(TARGET_IAFW_ARCH),x86_64)
     EFIWRAPPER_HOST_ARCH += x86_64
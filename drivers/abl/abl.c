@@ -34,6 +34,8 @@
 #include <libpayload.h>
 #include <smbios.h>
 #include <ewarg.h>
+#include <ewevent.h>
+#include <ewtrace.h>
 #include <ewvar.h>
 #include <libsmbios.h>
 
@@ -148,11 +150,46 @@ static EFI_STATUS set_smbios_fields(void)
 
 extern ewvar_storage_t reboot_target_storage;
 
+/* Longest busy wait of WaitForEvent() before the wait events are
+ * checked again, in microseconds */
+#define EVENT_POLL_US	1000
+
+static UINT64 abl_event_now(void)
+{
+	return timer_us(0) * 10;
+}
+
+/* Single-threaded: nothing but a timer or a wait event notify
+ * function can signal an event while waiting */
+static void abl_event_sleep(UINT64 deadline)
+{
+	UINT64 now = abl_event_now();
+
+	if (deadline <= now)
+		return;
+
+	udelay(MIN((deadline - now) / 10, EVENT_POLL_US));
+}
+
+static ewevent_backend_t event_backend = {
+	.now = abl_event_now,
+	.sleep = abl_event_sleep
+};
+
 static EFI_STATUS abl_init(__attribute__((__unused__)) EFI_SYSTEM_TABLE *st)
 {
+	EFI_STATUS ret;
+
 	if (!st)
 		return EFI_INVALID_PARAMETER;
 
+	/* Same TSC as the default trace clock, now of known frequency */
+	ewtrace_set_clock(timer_raw_value, timer_hz());
+
+	ret = ewevent_register_backend(&event_backend);
+	if (EFI_ERROR(ret))
+		return ret;
+
 	ewvar_register_storage(&reboot_target_storage);
 
 	return set_smbios_fields();
@@ -164,6 +201,7 @@ static EFI_STATUS abl_exit(EFI_SYSTEM_TABLE *st)
 		return EFI_INVALID_PARAMETER;
 
 	ewvar_unregister_storage();
+	ewevent_unregister_backend();
 
 	return EFI_SUCCESS;
 }
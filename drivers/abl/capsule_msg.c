@@ -30,6 +30,7 @@
 #include <kconfig.h>
 #include <libpayload-config.h>
 #include <libpayload.h>
+#include <ewcrc.h>
 #include <ewvar.h>
 #include <ewlog.h>
 #include <efilib.h>
@@ -37,41 +38,12 @@
 #include "heci/heci_protocol.h"
 #include <storage.h>
 
-/*  Compute CRC for one byte (shift register-based: one bit at a time). */
-static uint32_t crc32c_byte(uint32_t crc, unsigned byte)
-{
-	int i;
-	uint32_t c;
-
-	for (i = 0 ; i < 8 ; i += 1) {
-		c = (crc ^ byte) & 1;
-		if (c)
-			crc = (crc >> 1) ^ CRC32C_POLYNOMIAL;
-		else
-			crc = (crc >> 1);
-		byte >>= 1;
-	}
-
-	return crc;
-}
-
-/*  Compute CRC for a given buffer. */
-static uint32_t crc32c_buf(uint32_t crc, const void *addr, unsigned len)
-{
-	unsigned i;
-
-	for (i = 0 ; i < len ; i += 1)
-		crc = crc32c_byte(crc, *(uint8_t *)(addr + i));
-
-	return crc;
-}
-
 uint32_t crc32c_msg(const char *msg, UINTN offset, const void *addr, size_t len)
 {
 	uint32_t crc;
 
-	crc = crc32c_buf(~0, msg, offset);
-	crc = crc32c_buf(crc, addr, len);
+	crc = ewcrc32c_update(~0, msg, offset);
+	crc = ewcrc32c_update(crc, addr, len);
 	return crc;
 }
 
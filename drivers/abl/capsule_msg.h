@@ -48,8 +48,6 @@
 #define CDATA_TAG_USER_CMD		0x4d
 #define NVRAM_VALID_FLAG		0x12
 
-#define CRC32C_POLYNOMIAL 		0x82F63B78 /* CRC32C Castagnoli */
-
 union _cdata_header {
 	uint32_t data;
 	struct {
@@ -145,6 +145,15 @@ NvmeWriteBlocks (
 **/
 EFI_STATUS EFIAPI NvmeInitialize (IN UINTN NvmeHcPciBase);
 
+/**
+  The initialization can be split to overlap the controller enable time
+  with other work: NvmeStart() enables the controller, NvmePoll() returns
+  EFI_NOT_READY until it is ready and NvmeInitialize() completes the
+  initialization.  NvmePoll() only reads the controller registers.
+**/
+EFI_STATUS EFIAPI NvmeStart (IN UINTN NvmeHcPciBase);
+EFI_STATUS EFIAPI NvmePoll (VOID);
+
 EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL *NvmeGetPassthru(void);
 
 EFI_STORAGE_SECURITY_COMMAND_PROTOCOL *NvmeGetSecurityInterface(void);
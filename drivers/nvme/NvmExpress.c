@@ -24,6 +24,7 @@
 #define PCI_BASE_ADDRESSREG_OFFSET                  0x10
 
 NVME_CONTROLLER_PRIVATE_DATA        *mNvmeCtrlPrivate;
+NVME_CONTROLLER_PRIVATE_DATA        *mNvmeStartingPrivate;  // Started, not yet initialized
 NVME_DEVICE_PRIVATE_DATA            *mMultiNvmeDrive[10]; //maxium 10
 NvmCtrlPlatformInfo NvmCtrlInfo = { {1,0,0} };
 
@@ -254,29 +255,19 @@ DiscoverAllNamespaces (
 }
 
 /**
-  Starts a device controller or a bus controller.
-
-  The Start() function is designed to be invoked from the EFI boot service ConnectController().
-  As a result, much of the error checking on the parameters to Start() has been moved into this
-  common boot service. It is legal to call Start() from other locations,
-  but the following calling restrictions must be followed or the system behavior will not be deterministic.
-  1. ControllerHandle must be a valid EFI_HANDLE.
-  2. If RemainingDevicePath is not NULL, then it must be a pointer to a naturally aligned
-     EFI_DEVICE_PATH_PROTOCOL.
-  3. Prior to calling Start(), the Supported() function for the driver specified by This must
-     have been called with the same calling parameters, and Supported() must have returned EFI_SUCCESS.
+  Starts enabling the Nvme controller.  NvmeInitialize() completes the
+  initialization once NvmePoll() reports the controller ready.
 
-  @param[in]  VOID
+  @param[in]  NvmeHcPciBase        Nvme Host Controller's PCI ConfigSpace Base address
 
-  @retval EFI_SUCCESS              The device was started.
-  @retval EFI_DEVICE_ERROR         The device could not be started due to a device error.Currently not implemented.
+  @retval EFI_SUCCESS              The controller is being enabled.
   @retval EFI_OUT_OF_RESOURCES     The request could not be completed due to a lack of resources.
   @retval Others                   The driver failded to start the device.
 
 **/
 EFI_STATUS
 EFIAPI
-NvmeInitialize (
+NvmeStart (
   IN  UINTN               NvmeHcPciBase
   )
 {
@@ -284,7 +275,7 @@ NvmeInitialize (
   EFI_STATUS                          Status;
   NVME_CONTROLLER_PRIVATE_DATA        *Private;
 
-  DEBUG_NVME ((EFI_D_INFO, "NvmeInitialize:\n"));
+  DEBUG_NVME ((EFI_D_INFO, "NvmeStart:\n"));
 
   Private          = NULL;
 
@@ -329,7 +320,91 @@ NvmeInitialize (
   Private->NvmeHCBase = (addr & ~0xf);
   DEBUG_NVME ((EFI_D_INFO, "NvmeControllerInit: NvmeHCBase = 0x%X\n", addr));
 
-  Status = NvmeControllerInit (Private);
+  Status = NvmeControllerStart (Private);
+  if (EFI_ERROR(Status)) {
+    goto Exit;
+  }
+  mNvmeStartingPrivate = Private;
+
+  DEBUG_NVME ((EFI_D_INFO, "NvmeStart: end successfully\n"));
+  return EFI_SUCCESS;
+
+Exit:
+  DEBUG_NVME ((EFI_D_INFO, "NvmeStart: end with 0x%X\n", Status));
+
+  return Status;
+}
+
+/**
+  Checks if the controller started by NvmeStart() is ready.  It only
+  reads the controller registers.
+
+  @retval EFI_SUCCESS              The controller is ready or was not started.
+  @retval EFI_NOT_READY            The controller is not ready yet.
+  @retval Others                   The controller failed to get ready.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmePoll (
+  VOID
+  )
+{
+  if (mNvmeStartingPrivate == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  return NvmeControllerReady (mNvmeStartingPrivate);
+}
+
+/**
+  Starts a device controller or a bus controller.
+
+  The Start() function is designed to be invoked from the EFI boot service ConnectController().
+  As a result, much of the error checking on the parameters to Start() has been moved into this
+  common boot service. It is legal to call Start() from other locations,
+  but the following calling restrictions must be followed or the system behavior will not be deterministic.
+  1. ControllerHandle must be a valid EFI_HANDLE.
+  2. If RemainingDevicePath is not NULL, then it must be a pointer to a naturally aligned
+     EFI_DEVICE_PATH_PROTOCOL.
+  3. Prior to calling Start(), the Supported() function for the driver specified by This must
+     have been called with the same calling parameters, and Supported() must have returned EFI_SUCCESS.
+
+  @param[in]  VOID
+
+  @retval EFI_SUCCESS              The device was started.
+  @retval EFI_DEVICE_ERROR         The device could not be started due to a device error.Currently not implemented.
+  @retval EFI_OUT_OF_RESOURCES     The request could not be completed due to a lack of resources.
+  @retval Others                   The driver failded to start the device.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmeInitialize (
+  IN  UINTN               NvmeHcPciBase
+  )
+{
+  EFI_STATUS                          Status;
+  NVME_CONTROLLER_PRIVATE_DATA        *Private;
+
+  DEBUG_NVME ((EFI_D_INFO, "NvmeInitialize:\n"));
+
+  if (mNvmeStartingPrivate == NULL) {
+    Status = NvmeStart (NvmeHcPciBase);
+    if (EFI_ERROR(Status)) {
+      return Status;
+    }
+  }
+
+  Private              = mNvmeStartingPrivate;
+  mNvmeStartingPrivate = NULL;
+
+  Status = NvmeWaitControllerReady (Private);
+  if (EFI_ERROR(Status)) {
+    goto Exit;
+  }
+
+  Status = NvmeControllerComplete (Private);
   if (EFI_ERROR(Status)) {
     goto Exit;
   }
@@ -178,6 +178,11 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   //
   NVME_CAP                            Cap;
 
+  //
+  // timer_us() deadline of the controller ready transition
+  //
+  UINT64                              ReadyDeadline;
+
   VOID                                *Mapping;
 
   //
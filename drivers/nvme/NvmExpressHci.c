@@ -13,6 +13,8 @@
 
 **/
 
+#include <kconfig.h>
+#include <libpayload.h>
 #include <efi.h>
 #include <efilib.h>
 #include <arch/io.h>
@@ -474,29 +476,22 @@ NvmeDisableController (
 }
 
 /**
-  Enable the Nvm Express controller.
+  Set the enable bit of the Nvm Express controller.
 
   @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
 
-  @return EFI_SUCCESS      Successfully enable the controller.
+  @return EFI_SUCCESS      Successfully set the enable bit.
   @return EFI_DEVICE_ERROR Fail to enable the controller.
-  @return EFI_TIMEOUT      Fail to enable the controller in given time slot.
 
 **/
 EFI_STATUS
-NvmeEnableController (
+NvmeStartController (
 	IN NVME_CONTROLLER_PRIVATE_DATA     *Private
 )
 {
 	NVME_CC                Cc;
-	NVME_CSTS              Csts;
 	EFI_STATUS             Status;
-	UINT32                 Index;
 	UINT8                  Timeout;
-	UINT32                 NvmeHCBase;
-
-	//NVME PCI base address
-	NvmeHCBase = Private->NvmeHCBase;
 
 	//
 	// Enable the controller.
@@ -507,36 +502,85 @@ NvmeEnableController (
 	Cc.Iosqes = 6;
 	Cc.Iocqes = 4;
 
-	Status = WriteNvmeControllerConfiguration (NvmeHCBase, &Cc);
+	Status = WriteNvmeControllerConfiguration (Private->NvmeHCBase, &Cc);
 	if (EFI_ERROR(Status))
 		return Status;
 
 	//
 	// Cap.To specifies max delay time in 500ms increments for Csts.Rdy to set after
-	// Cc.Enable. Loop produces a 1 millisecond delay per itteration, up to 500 * Cap.To.
+	// Cc.Enable.
 	//
 	if (Private->Cap.To == 0)
 		Timeout = 1;
 	else
 		Timeout = Private->Cap.To;
 
-	for (Index = (Timeout * 500); Index != 0; --Index) {
-		NanoSecondDelay(1000 * 1000);
+	Private->ReadyDeadline = timer_us(0) + Timeout * 500 * 1000;
 
-		//
-		// Check if the controller is initialized
-		//
-		Status = ReadNvmeControllerStatus (NvmeHCBase, &Csts);
+	return EFI_SUCCESS;
+}
 
-		if (EFI_ERROR(Status))
-			return Status;
+/**
+  Check if the Nvm Express controller enabled by NvmeStartController() is ready.
 
-		if (Csts.Rdy)
-			break;
-	}
+  It only reads the controller registers so that it can be polled while
+  the other drivers are brought up.
 
-	if (Index == 0)
-		Status = EFI_TIMEOUT;
+  @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @return EFI_SUCCESS      The controller is ready.
+  @return EFI_NOT_READY    The controller is not ready yet.
+  @return EFI_DEVICE_ERROR Fail to read the controller status.
+  @return EFI_TIMEOUT      Fail to enable the controller in given time slot.
+
+**/
+EFI_STATUS
+NvmeControllerReady (
+	IN NVME_CONTROLLER_PRIVATE_DATA     *Private
+)
+{
+	NVME_CSTS              Csts;
+	EFI_STATUS             Status;
+	BOOLEAN                Expired;
+
+	//
+	// Sample the time first: the controller may have become ready
+	// while we were not polling.
+	//
+	Expired = timer_us(0) > Private->ReadyDeadline;
+
+	Status = ReadNvmeControllerStatus (Private->NvmeHCBase, &Csts);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	if (Csts.Rdy)
+		return EFI_SUCCESS;
+
+	return Expired ? EFI_TIMEOUT : EFI_NOT_READY;
+}
+
+/**
+  Wait for the Nvm Express controller enabled by NvmeStartController() to be ready.
+
+  @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @return EFI_SUCCESS      Successfully enable the controller.
+  @return EFI_DEVICE_ERROR Fail to enable the controller.
+  @return EFI_TIMEOUT      Fail to enable the controller in given time slot.
+
+**/
+EFI_STATUS
+NvmeWaitControllerReady (
+	IN NVME_CONTROLLER_PRIVATE_DATA     *Private
+)
+{
+	EFI_STATUS             Status;
+
+	//
+	// Loop produces a 1 millisecond delay per itteration.
+	//
+	while ((Status = NvmeControllerReady (Private)) == EFI_NOT_READY)
+		NanoSecondDelay(1000 * 1000);
 
 	DEBUG_NVME ((EFI_D_INFO, "NVMe controller is enabled with status [0x%x].\n", Status));
 	return Status;
@@ -786,16 +830,18 @@ NvmeCreateIoSubmissionQueue (
 }
 
 /**
-  Initialize the Nvm Express controller.
+  Start the initialization of the Nvm Express controller: program the
+  admin queues and set the enable bit.  The controller is ready when
+  NvmeControllerReady() returns EFI_SUCCESS.
 
   @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
 
-  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
+  @retval EFI_SUCCESS                The NVM Express Controller is being enabled.
   @retval Others                     A device error occurred while initializing the controller.
 
 **/
 EFI_STATUS
-NvmeControllerInit (
+NvmeControllerStart (
 	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
 )
 {
@@ -803,8 +849,6 @@ NvmeControllerInit (
 	NVME_AQA                        Aqa;
 	NVME_ASQ                        Asq;
 	NVME_ACQ                        Acq;
-	UINT8                           Sn[21];
-	UINT8                           Mn[41];
 	UINT32                          NvmeHCBase;
 
 	//NVME PCI base address
@@ -908,9 +952,27 @@ NvmeControllerInit (
 	if (EFI_ERROR(Status))
 		return Status;
 
-	Status = NvmeEnableController (Private);
-	if (EFI_ERROR(Status))
-		return Status;
+	return NvmeStartController (Private);
+}
+
+/**
+  Complete the initialization of the Nvm Express controller once it is
+  ready: identify it and create the I/O queues.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
+  @retval Others                     A device error occurred while initializing the controller.
+
+**/
+EFI_STATUS
+NvmeControllerComplete (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+)
+{
+	EFI_STATUS                      Status;
+	UINT8                           Sn[21];
+	UINT8                           Mn[41];
 
 	//
 	// Allocate buffer for Identify Controller data
@@ -970,3 +1032,30 @@ NvmeControllerInit (
 	return Status;
 }
 
+/**
+  Initialize the Nvm Express controller.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
+  @retval Others                     A device error occurred while initializing the controller.
+
+**/
+EFI_STATUS
+NvmeControllerInit (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+)
+{
+	EFI_STATUS                      Status;
+
+	Status = NvmeControllerStart (Private);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = NvmeWaitControllerReady (Private);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	return NvmeControllerComplete (Private);
+}
+
@@ -69,6 +69,68 @@ NvmeControllerInit (
 	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
 );
 
+/**
+  Start the initialization of the Nvm Express controller: program the
+  admin queues and set the enable bit.  The controller is ready when
+  NvmeControllerReady() returns EFI_SUCCESS.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is being enabled.
+  @retval Others                     A device error occurred while initializing the controller.
+
+**/
+EFI_STATUS
+NvmeControllerStart (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+);
+
+/**
+  Check if the Nvm Express controller enabled by NvmeStartController() is ready.
+
+  @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @return EFI_SUCCESS      The controller is ready.
+  @return EFI_NOT_READY    The controller is not ready yet.
+  @return EFI_DEVICE_ERROR Fail to read the controller status.
+  @return EFI_TIMEOUT      Fail to enable the controller in given time slot.
+
+**/
+EFI_STATUS
+NvmeControllerReady (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+);
+
+/**
+  Wait for the Nvm Express controller enabled by NvmeStartController() to be ready.
+
+  @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @return EFI_SUCCESS      Successfully enable the controller.
+  @return EFI_DEVICE_ERROR Fail to enable the controller.
+  @return EFI_TIMEOUT      Fail to enable the controller in given time slot.
+
+**/
+EFI_STATUS
+NvmeWaitControllerReady (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+);
+
+/**
+  Complete the initialization of the Nvm Express controller once it is
+  ready: identify it and create the I/O queues.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
+  @retval Others                     A device error occurred while initializing the controller.
+
+**/
+EFI_STATUS
+NvmeControllerComplete (
+	IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+);
+
 /**
   Get identify controller data.
 
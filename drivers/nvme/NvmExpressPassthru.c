@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <efi.h>
 #include <efidebug.h>
+#include <ewtrace.h>
 
 #include "NvmExpress.h"
 
@@ -386,9 +387,9 @@ EXIT:
   @retval EFI_TIMEOUT                A timeout occurred while waiting for the NVM Express Command Packet to execute.
 
 **/
+static
 EFI_STATUS
-EFIAPI
-NvmExpressPassThru (
+NvmExpressPassThruInternal (
 	IN     EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL          *This,
 	IN     UINT32                                      NamespaceId,
 	IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    *Packet,
@@ -672,6 +673,25 @@ EXIT:
 	return Status;
 }
 
+EFI_STATUS
+EFIAPI
+NvmExpressPassThru (
+	IN     EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL          *This,
+	IN     UINT32                                      NamespaceId,
+	IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    *Packet,
+	IN     ASYNC_IO_CALL_BACK                          *Event
+)
+{
+	EFI_STATUS                     Status;
+
+	ewtrace_begin("NvmExpressPassThru",
+		      Packet && Packet->NvmeCmd ? Packet->NvmeCmd->Cdw0.Opcode : 0);
+	Status = NvmExpressPassThruInternal(This, NamespaceId, Packet, Event);
+	ewtrace_end("NvmExpressPassThru");
+
+	return Status;
+}
+
 /**
   Used to retrieve the next namespace ID for this NVM Express controller.
 
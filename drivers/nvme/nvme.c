@@ -41,10 +41,8 @@ static struct supported_device {
 	{ .vid = 0x8086, .did = NVME_PCI_DID },
 };
 
-static EFI_STATUS _init(storage_t *s)
+static pcidev_t find_device(void)
 {
-	DEVICE_BLOCK_INFO	  BlockInfo;
-	EFI_STATUS ret;
 	pcidev_t pci_dev = 0;
 	size_t i;
 
@@ -55,6 +53,16 @@ static EFI_STATUS _init(storage_t *s)
 			break;
 
 	DEBUG_NVME ((EFI_D_INFO, "pci_dev = 0x%X\n", pci_dev));
+	return pci_dev;
+}
+
+static EFI_STATUS _init(storage_t *s)
+{
+	DEVICE_BLOCK_INFO	  BlockInfo;
+	EFI_STATUS ret;
+	pcidev_t pci_dev;
+
+	pci_dev = find_device();
 	if (!pci_dev)
 		return EFI_UNSUPPORTED;
 
@@ -125,6 +133,31 @@ static EFI_HANDLE nvme_handle;
 static EFI_GUID nvme_pass_thru_guid = EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL_GUID;
 static EFI_GUID nvme_security_guid = EFI_STORAGE_SECURITY_COMMAND_PROTOCOL_GUID;
 
+/* Enable the controller and let the other drivers come up while it
+ * gets ready, which can take up to CAP.TO x 500 ms */
+static EFI_STATUS nvme_drv_start(__attribute__((__unused__)) EFI_SYSTEM_TABLE *st)
+{
+	boot_dev_t *boot_dev;
+	pcidev_t pci_dev;
+
+	boot_dev = get_boot_media();
+	if (!boot_dev)
+		return EFI_INVALID_PARAMETER;
+	if (boot_dev->type != STORAGE_NVME)
+		return EFI_SUCCESS;
+
+	pci_dev = find_device();
+	if (!pci_dev)
+		return EFI_UNSUPPORTED;
+
+	return NvmeStart(pci_dev) ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+}
+
+static EFI_STATUS nvme_drv_poll(__attribute__((__unused__)) EFI_SYSTEM_TABLE *st)
+{
+	return NvmePoll();
+}
+
 static EFI_STATUS nvme_drv_init(EFI_SYSTEM_TABLE *st)
 {
 	EFI_STATUS ret;
@@ -189,10 +222,16 @@ static EFI_STATUS nvme_drv_exit(EFI_SYSTEM_TABLE *st)
 	return ret;
 }
 
+/* The storage protocols rely on the event backend of the platform */
+static const char *nvme_depends[] = { "abl", NULL };
+
 ewdrv_t nvme_drv = {
 	.name = "nvme",
 	.description = "PCI NVME driver",
 	.init = nvme_drv_init,
-	.exit = nvme_drv_exit
+	.exit = nvme_drv_exit,
+	.start = nvme_drv_start,
+	.poll = nvme_drv_poll,
+	.depends = nvme_depends
 };
 
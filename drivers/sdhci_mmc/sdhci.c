@@ -27,6 +27,7 @@
 #include <libpayload.h>
 #include <pci/pci.h>
 #include <ewlog.h>
+#include <ewtrace.h>
 
 #include "sdhci_mmc/sdhci-internal.h"
 #include "sdhci_mmc/mmc.h"
@@ -389,6 +390,7 @@ sdhci_send_cmd(struct mmc *m, struct cmd *c)
 	struct sdhci *host = m->host;
 	uint16_t tmode = 0;
 
+	ewtrace_begin("sdhci_send_cmd", c->index);
 	sdhci_wait_for_state_unset(host, SDHCI_CMD_INHIBIT, 100000);
 
 	if (c->index != CMD_MMC_SEND_TUNING_BLOCK_HS200)
@@ -425,6 +427,7 @@ sdhci_send_cmd(struct mmc *m, struct cmd *c)
 	}
 	sdhci_write32(host, SDHCI_ARGUMENT, c->args);
 	sdhci_write16(host, SDHCI_CMD_REG, sdhci_make_cmd(c));
+	ewtrace_end("sdhci_send_cmd");
 
 	return;
 }
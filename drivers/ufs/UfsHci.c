@@ -14,6 +14,7 @@
 #include <arch/io.h>
 #include <kconfig.h>
 #include <libpayload.h>
+#include <ewtrace.h>
 #include "UfsInternal.h"
 
 #ifndef ClockCycles
@@ -1644,7 +1645,9 @@ UfsExecScsiCmds(
 
 	Status = EFI_SUCCESS;
 	for (TryIndex = 0; TryIndex < 10; TryIndex++) {
+		ewtrace_begin("UfsExecScsiCmdsInternal", *(UINT8 *)Packet->Cdb);
 		Status = UfsExecScsiCmdsInternal(Private, Lun, Packet);
+		ewtrace_end("UfsExecScsiCmdsInternal");
 		if (!EFI_ERROR(Status)) {
 			break;
 		}
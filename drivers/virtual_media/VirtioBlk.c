@@ -27,6 +27,7 @@
 #include <libpayload-config.h>
 #include <libpayload.h>
 #include <ewlib.h>
+#include <ewtrace.h>
 #include <efilib.h>
 
 #include "VirtioDeviceCommon.h"
@@ -277,8 +278,7 @@ VerifyReadWriteRequest (
 
 STATIC
 EFI_STATUS
-EFIAPI
-SynchronousRequest (
+SynchronousRequestInternal (
 	IN              VBLK_DEV *Dev,
 	IN              EFI_LBA  Lba,
 	IN              UINTN    BufferSize,
@@ -534,6 +534,28 @@ SynchronousRequest (
 	return Status;
 }
 
+STATIC
+EFI_STATUS
+EFIAPI
+SynchronousRequest (
+	IN              VBLK_DEV *Dev,
+	IN              EFI_LBA  Lba,
+	IN              UINTN    BufferSize,
+	IN OUT volatile VOID     *Buffer,
+	IN              BOOLEAN  RequestIsWrite,
+	IN              UINT32   RequestType
+	)
+{
+	EFI_STATUS              Status;
+
+	ewtrace_begin("SynchronousRequest", RequestType);
+	Status = SynchronousRequestInternal (Dev, Lba, BufferSize, Buffer,
+					     RequestIsWrite, RequestType);
+	ewtrace_end("SynchronousRequest");
+
+	return Status;
+}
+
 
 EFI_STATUS
 EFIAPI
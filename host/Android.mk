@@ -17,8 +17,12 @@ LOCAL_SRC_FILES := \
 	gop.c \
 	image.c \
 	pe.c \
+	serial.c \
+	host_memory.c \
 	host_time.c \
-	terminal_conin.c
+	terminal_conin.c \
+	variables.c \
+	trace.c
 LOCAL_LDFLAGS := -ldl 
 LOCAL_MODULE_HOST_ARCH := $(EFIWRAPPER_HOST_ARCH)
 LOCAL_C_INCLUDES := $(EFIWRAPPER_HOST_C_INCLUDES)
@@ -33,6 +33,7 @@
 #include <ewlog.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +43,7 @@
 #include <unistd.h>
 #include <storage.h>
 #include <sdio.h>
+#include <ewiostats.h>
 
 #include "disk.h"
 
@@ -122,20 +124,15 @@ static EFI_LBA read_or_write(storage_t *s, EFI_LBA start, EFI_LBA count,
 	if (fd == -1)
 		return EFI_NOT_STARTED;
 
-	off = lseek64(fd, start * s->blk_sz, SEEK_SET);
-	if (off != (off64_t)start * s->blk_sz) {
-		ewerr("Failed to seek in the disk file, %s",
-		      strerror(errno));
-		return 0;
-	}
-
+	/* Positioned I/O as requests may be run by the aio thread */
+	off = start * s->blk_sz;
 	b = buf;
 	total = 0;
 	for (remaining = count * s->blk_sz; remaining > 0; remaining -= ret) {
 		if (do_read)
-			ret = read(fd, b, remaining);
+			ret = pread64(fd, b, remaining, off + total);
 		else
-			ret = write(fd, b, remaining);
+			ret = pwrite64(fd, b, remaining, off + total);
 
 		if (do_read && ret == 0) {
 			ewerr("End of file detected");
@@ -166,13 +163,155 @@ static EFI_LBA _write(storage_t *s, EFI_LBA start, EFI_LBA count,
 	return read_or_write(s, start, count, (void *)buf, false);
 }
 
+/* Asynchronous requests are run in order by a single thread */
+typedef struct aio_job {
+	struct aio_job *next;
+	storage_request_t *req;
+	EFI_STATUS status;
+} aio_job_t;
+
+typedef struct aio_queue {
+	aio_job_t *head;
+	aio_job_t *tail;
+} aio_queue_t;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	BOOLEAN started;
+	BOOLEAN stopping;
+	aio_queue_t pending;
+	aio_queue_t completed;
+} aio = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static void aio_push(aio_queue_t *queue, aio_job_t *job)
+{
+	job->next = NULL;
+	if (queue->tail)
+		queue->tail->next = job;
+	else
+		queue->head = job;
+	queue->tail = job;
+}
+
+static aio_job_t *aio_pop(aio_queue_t *queue)
+{
+	aio_job_t *job = queue->head;
+
+	if (job) {
+		queue->head = job->next;
+		if (!queue->head)
+			queue->tail = NULL;
+	}
+
+	return job;
+}
+
+static void *aio_run(void *arg)
+{
+	storage_t *s = arg;
+	storage_request_t *req;
+	aio_job_t *job;
+	EFI_LBA count;
+
+	pthread_mutex_lock(&aio.lock);
+	for (;;) {
+		while (!aio.pending.head && !aio.stopping)
+			pthread_cond_wait(&aio.cond, &aio.lock);
+		job = aio_pop(&aio.pending);
+		if (!job)
+			break;
+		pthread_mutex_unlock(&aio.lock);
+
+		req = job->req;
+		count = read_or_write(s, req->start, req->count, req->buf,
+				      !req->write);
+		job->status = count == req->count ?
+			EFI_SUCCESS : EFI_DEVICE_ERROR;
+
+		pthread_mutex_lock(&aio.lock);
+		aio_push(&aio.completed, job);
+	}
+	pthread_mutex_unlock(&aio.lock);
+
+	return NULL;
+}
+
+static EFI_STATUS _submit(storage_t *s, storage_request_t *req)
+{
+	EFI_STATUS ret = EFI_SUCCESS;
+	aio_job_t *job;
+
+	job = malloc(sizeof(*job));
+	if (!job)
+		return EFI_OUT_OF_RESOURCES;
+	job->req = req;
+
+	pthread_mutex_lock(&aio.lock);
+	if (!aio.started) {
+		aio.stopping = FALSE;
+		if (pthread_create(&aio.thread, NULL, aio_run, s)) {
+			ret = EFI_DEVICE_ERROR;
+			goto out;
+		}
+		aio.started = TRUE;
+	}
+
+	aio_push(&aio.pending, job);
+	pthread_cond_signal(&aio.cond);
+
+out:
+	pthread_mutex_unlock(&aio.lock);
+	if (EFI_ERROR(ret))
+		free(job);
+	return ret;
+}
+
+static void _poll(__attribute__((__unused__)) storage_t *s)
+{
+	aio_queue_t completed;
+	aio_job_t *job;
+
+	pthread_mutex_lock(&aio.lock);
+	completed = aio.completed;
+	aio.completed.head = aio.completed.tail = NULL;
+	pthread_mutex_unlock(&aio.lock);
+
+	while ((job = aio_pop(&completed))) {
+		job->req->done(job->req, job->status);
+		free(job);
+	}
+}
+
+static void aio_stop(void)
+{
+	pthread_mutex_lock(&aio.lock);
+	if (!aio.started) {
+		pthread_mutex_unlock(&aio.lock);
+		return;
+	}
+	aio.stopping = TRUE;
+	pthread_cond_signal(&aio.cond);
+	pthread_mutex_unlock(&aio.lock);
+
+	pthread_join(aio.thread, NULL);
+	aio.started = FALSE;
+}
+
 static storage_t disk_storage = {
 	.init = _init,
 	.read = _read,
 	.write = _write,
 	.erase = NULL,
 	.pci_function = 0,
-	.pci_device = 0
+	.pci_device = 0,
+	.cache_flags = STORAGE_CACHE_WRITE_BACK,
+	.submit = _submit,
+	.poll = _poll
 };
 
 static EFI_HANDLE handle;
@@ -199,6 +338,81 @@ static EFI_STATUS disk_init(EFI_SYSTEM_TABLE *st)
 	return ret;
 }
 
+/* Append the non-empty buckets of HISTOGRAM to LINE */
+static void format_histogram(char *line, size_t size, const char *unit,
+			     const UINT64 *histogram)
+{
+	size_t len = 0;
+	int res;
+	UINTN i;
+
+	line[0] = '\0';
+	for (i = 0; i < EFIWRAPPER_IO_HISTOGRAM_SIZE && len < size; i++) {
+		if (!histogram[i])
+			continue;
+		res = snprintf(line + len, size - len, " %llu%s:%llu",
+			       1ULL << i, unit,
+			       (unsigned long long)histogram[i]);
+		if (res < 0)
+			break;
+		len += res;
+	}
+}
+
+void disk_dump_stats(EFI_SYSTEM_TABLE *st)
+{
+	static const char *OP_NAMES[] = { "read", "write", "erase", "flush" };
+	static EFI_GUID iostats_guid = EFIWRAPPER_IO_STATS_PROTOCOL_GUID;
+	EFIWRAPPER_IO_STATS_PROTOCOL *iostats;
+	EFIWRAPPER_IO_STATS stats;
+	EFIWRAPPER_IO_OP_STATS *op;
+	EFI_STATUS ret;
+	char line[512];
+	UINTN i;
+
+	if (!st || !handle)
+		return;
+
+	ret = uefi_call_wrapper(st->BootServices->HandleProtocol, 3,
+				handle, &iostats_guid, (VOID **)&iostats);
+	if (EFI_ERROR(ret))
+		return;
+
+	ret = uefi_call_wrapper(iostats->GetStats, 2, iostats, &stats);
+	if (EFI_ERROR(ret))
+		return;
+
+	for (i = 0; i < EfiwrapperIoMax; i++) {
+		op = &stats.Op[i];
+		if (!op->Operations)
+			continue;
+
+		printf("disk %s: %llu ops, %llu errors, %llu bytes, "
+		       "avg %llu us, max %llu us\n", OP_NAMES[i],
+		       (unsigned long long)op->Operations,
+		       (unsigned long long)op->Errors,
+		       (unsigned long long)op->Bytes,
+		       (unsigned long long)(op->TotalTime / op->Operations / 10),
+		       (unsigned long long)(op->MaxTime / 10));
+
+		format_histogram(line, sizeof(line), "B", op->SizeHistogram);
+		if (line[0])
+			printf("disk %s sizes:%s\n", OP_NAMES[i], line);
+
+		if (!stats.Timed)
+			continue;
+
+		format_histogram(line, sizeof(line), "us",
+				 op->LatencyHistogram);
+		printf("disk %s latencies:%s\n", OP_NAMES[i], line);
+	}
+
+	if (stats.UnalignedHeads || stats.UnalignedTails)
+		printf("disk unaligned DiskIo accesses: %llu heads, %llu tails\n",
+		       (unsigned long long)stats.UnalignedHeads,
+		       (unsigned long long)stats.UnalignedTails);
+}
+
 static EFI_STATUS disk_exit(EFI_SYSTEM_TABLE *st)
 {
 	EFI_STATUS ret;
@@ -209,17 +423,22 @@ static EFI_STATUS disk_exit(EFI_SYSTEM_TABLE *st)
 	if (!handle)
 		return EFI_NOT_STARTED;
 
-	if (fd != -1)
-		close(fd);
-
 	ret = sdio_free(st, handle);
 	if (EFI_ERROR(ret))
 		return ret;
 
+	/* Completes the in-flight requests and flushes the block cache */
 	ret = storage_free(st, handle);
 	if (EFI_ERROR(ret))
 		return ret;
 
+	aio_stop();
+
+	if (fd != -1) {
+		close(fd);
+		fd = -1;
+	}
+
 	handle = NULL;
 	return EFI_SUCCESS;
 }
@@ -36,4 +36,8 @@
 
 extern ewdrv_t disk_drv;
 
+/* Print the I/O statistics of the disk.  Called before ewdrv_exit()
+ * as the statistics go away with the storage. */
+void disk_dump_stats(EFI_SYSTEM_TABLE *st);
+
 #endif	/* _DISK_H_ */
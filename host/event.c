@@ -31,220 +31,247 @@
 
 #include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
+#include <ewevent.h>
 #include <ewlog.h>
-#include <string.h>
 
 #include "event.h"
 
-typedef struct event {
-	UINT32 type;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+
+/* The application thread TPL is maintained by the library.  The other
+ * threads, dispatchers included, have their own. */
+static pthread_t app_thread;
+static __thread EFI_TPL thread_tpl = TPL_APPLICATION;
+
+/* Deferred notify functions are run by a pool of dispatcher threads.
+ * A notify function may block, like the terminal WaitForKey one, so
+ * a new thread is started whenever no idle thread is available for a
+ * job.  Only up to DISPATCHER_IDLE_MAX idle threads are kept. */
+#define DISPATCHER_IDLE_MAX	4
+
+typedef struct job {
+	struct job *next;
+	void (*fun)(void *);
+	void *arg;
 	EFI_TPL tpl;
-	EFI_EVENT_NOTIFY notify;
-	VOID *context;
+} job_t;
+
+static struct {
 	pthread_mutex_t lock;
 	pthread_cond_t cond;
-} event_t;
+	job_t *jobs;		/* Highest TPL first, FIFO within a TPL */
+	size_t nb_jobs;
+	size_t nb_threads;
+	size_t nb_idle;
+	BOOLEAN stopping;
+} dispatcher = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
 
-static void *call_notify(void *arg)
+static UINT64 host_now(void)
 {
-	event_t *event = (event_t *)arg;
+	struct timespec ts;
 
-	event->notify(event, event->context);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	return NULL;
+	return (UINT64)ts.tv_sec * 10000000 + ts.tv_nsec / 100;
 }
 
-static EFIAPI EFI_STATUS
-create_event(UINT32 Type,
-	     EFI_TPL NotifyTpl,
-	     EFI_EVENT_NOTIFY NotifyFunction,
-	     VOID *NotifyContext,
-	     EFI_EVENT *Event)
+static void host_lock(void)
 {
-	event_t *event;
-	int ret;
+	pthread_mutex_lock(&lock);
+}
 
-	if (!Event ||
-	    (Type & EVT_NOTIFY_SIGNAL && Type & EVT_NOTIFY_WAIT) ||
-	    (!NotifyFunction && (Type & EVT_NOTIFY_SIGNAL || Type & EVT_NOTIFY_WAIT)))
-		return EFI_INVALID_PARAMETER;
+static void host_unlock(void)
+{
+	pthread_mutex_unlock(&lock);
+}
 
-	event = malloc(sizeof(*event));
-	if (!event)
-		return EFI_OUT_OF_RESOURCES;
+static void host_sleep(UINT64 deadline)
+{
+	struct timespec ts;
 
-	event->type = Type;
-	event->tpl = NotifyTpl;
-	event->notify = NotifyFunction;
-	event->context = NotifyContext;
-	if (event->type != EVT_NOTIFY_SIGNAL) {
-		ret = pthread_mutex_init(&event->lock, NULL);
-		if (ret)
-			goto err;
-
-		ret = pthread_cond_init(&event->cond, NULL);
-		if (ret)
-			goto err;
+	if (deadline == EWEVENT_NO_DEADLINE) {
+		pthread_cond_wait(&cond, &lock);
+		return;
 	}
 
-	*Event = event;
-
-	return EFI_SUCCESS;
-
-err:
-	free(event);
-	return EFI_DEVICE_ERROR;
+	ts.tv_sec = deadline / 10000000;
+	ts.tv_nsec = (deadline % 10000000) * 100;
+	pthread_cond_timedwait(&cond, &lock, &ts);
+}
 
+static void host_wake(void)
+{
+	pthread_cond_broadcast(&cond);
 }
 
-static EFIAPI EFI_STATUS
-set_timer(__attribute__((__unused__)) EFI_EVENT Event,
-	  __attribute__((__unused__)) EFI_TIMER_DELAY Type,
-	  __attribute__((__unused__)) UINT64 TriggerTime)
+static EFI_TPL *host_thread_tpl(void)
 {
-	return EFI_UNSUPPORTED;
+	if (pthread_equal(pthread_self(), app_thread))
+		return NULL;
+	return &thread_tpl;
 }
 
-static EFIAPI EFI_STATUS
-wait_for_event(UINTN NumberOfEvents,
-	       EFI_EVENT *Event,
-	       UINTN *Index)
+static void *dispatch(__attribute__((__unused__)) void *arg)
 {
-	event_t *event;
-	int ret;
-	pthread_t thread_notify;
+	job_t *job;
+
+	pthread_mutex_lock(&dispatcher.lock);
+	for (;;) {
+		while (!dispatcher.jobs && !dispatcher.stopping) {
+			if (dispatcher.nb_idle == DISPATCHER_IDLE_MAX)
+				goto exit;
+			dispatcher.nb_idle++;
+			pthread_cond_wait(&dispatcher.cond, &dispatcher.lock);
+			dispatcher.nb_idle--;
+		}
+		if (!dispatcher.jobs)
+			break;
 
-	if (!Event || !Index)
-		return EFI_INVALID_PARAMETER;
+		job = dispatcher.jobs;
+		dispatcher.jobs = job->next;
+		dispatcher.nb_jobs--;
+		pthread_mutex_unlock(&dispatcher.lock);
 
-	if (NumberOfEvents != 1)
-		return EFI_UNSUPPORTED;
+		thread_tpl = job->tpl;
+		job->fun(job->arg);
+		thread_tpl = TPL_APPLICATION;
+		free(job);
 
-	event = (event_t *)*Event;
-	if (event->type == EVT_NOTIFY_SIGNAL)
-		return EFI_INVALID_PARAMETER;
+		pthread_mutex_lock(&dispatcher.lock);
+	}
+exit:
+	dispatcher.nb_threads--;
+	pthread_mutex_unlock(&dispatcher.lock);
 
-	ret = pthread_mutex_lock(&event->lock);
-	if (ret)
-		return EFI_DEVICE_ERROR;
+	return NULL;
+}
 
-	if (event->type == EVT_NOTIFY_WAIT) {
-		ret = pthread_create(&thread_notify, NULL, call_notify, event);
-		if (ret) {
-			pthread_mutex_unlock(&event->lock);
-			return EFI_DEVICE_ERROR;
-		}
-		ret = pthread_detach(thread_notify);
-		if (ret)
-			ewdbg("Fail to detach notify thread");
-	}
+static EFI_STATUS start_dispatcher(void)
+{
+	pthread_t thread;
+	int ret;
 
-        ret = pthread_cond_wait(&event->cond, &event->lock);
-	if (ret) {
-		pthread_mutex_unlock(&event->lock);
+	ret = pthread_create(&thread, NULL, dispatch, NULL);
+	if (ret)
 		return EFI_DEVICE_ERROR;
-	}
 
-        ret = pthread_mutex_unlock(&event->lock);
+	ret = pthread_detach(thread);
 	if (ret)
-		return EFI_DEVICE_ERROR;
+		ewdbg("Fail to detach dispatcher thread");
 
-	*Index = 0;
+	dispatcher.nb_threads++;
 
 	return EFI_SUCCESS;
 }
 
-static EFIAPI EFI_STATUS
-signal_event(EFI_EVENT Event)
+static EFI_STATUS
+host_defer(void (*fun)(void *), void *arg, EFI_TPL tpl)
 {
-	event_t *event = (event_t *)Event;
-	int ret;
+	EFI_STATUS ret = EFI_SUCCESS;
+	job_t *job, **p;
 
-	if (!Event)
-		return EFI_INVALID_PARAMETER;
+	job = malloc(sizeof(*job));
+	if (!job)
+		return EFI_OUT_OF_RESOURCES;
 
-	if (event->type == EVT_NOTIFY_SIGNAL) {
-		event->notify(Event, event->context);
-		return EFI_SUCCESS;
-	}
+	job->fun = fun;
+	job->arg = arg;
+	job->tpl = tpl;
 
-	ret = pthread_mutex_lock(&event->lock);
-	if (ret)
-		return EFI_DEVICE_ERROR;
+	pthread_mutex_lock(&dispatcher.lock);
 
-	ret = pthread_cond_signal(&event->cond);
-	if (ret) {
-		pthread_mutex_unlock(&event->lock);
-		return EFI_DEVICE_ERROR;
+	/* Each idle thread takes one of the queued jobs */
+	if (dispatcher.nb_jobs >= dispatcher.nb_idle)
+		ret = start_dispatcher();
+
+	if (EFI_ERROR(ret)) {
+		pthread_mutex_unlock(&dispatcher.lock);
+		free(job);
+		ewerr("Failed to start a dispatcher thread");
+		return ret;
 	}
 
-	ret = pthread_mutex_unlock(&event->lock);
-	if (ret)
-		return EFI_DEVICE_ERROR;
+	for (p = &dispatcher.jobs; *p && (*p)->tpl >= tpl; p = &(*p)->next)
+		;
+	job->next = *p;
+	*p = job;
+	dispatcher.nb_jobs++;
 
-	return EFI_SUCCESS;
-}
+	pthread_cond_signal(&dispatcher.cond);
+	pthread_mutex_unlock(&dispatcher.lock);
 
-static EFIAPI EFI_STATUS
-close_event(EFI_EVENT Event)
-{
-	free(Event);
 	return EFI_SUCCESS;
 }
 
-static EFIAPI EFI_STATUS
-check_event(__attribute__((__unused__)) EFI_EVENT Event)
-{
-	return EFI_UNSUPPORTED;
-}
-
-static EFI_CREATE_EVENT saved_create_event;
-static EFI_SET_TIMER saved_set_timer;
-static EFI_WAIT_FOR_EVENT saved_wait_for_event;
-static EFI_SIGNAL_EVENT saved_signal_event;
-static EFI_CLOSE_EVENT saved_close_event;
-static EFI_CHECK_EVENT saved_check_event;
+static ewevent_backend_t host_backend = {
+	.now = host_now,
+	.lock = host_lock,
+	.unlock = host_unlock,
+	.sleep = host_sleep,
+	.wake = host_wake,
+	.defer = host_defer,
+	.thread_tpl = host_thread_tpl
+};
 
 static EFI_STATUS event_init(EFI_SYSTEM_TABLE *st)
 {
+	EFI_STATUS ret;
+	pthread_condattr_t attr;
+
 	if (!st)
 		return EFI_INVALID_PARAMETER;
 
-	saved_create_event = st->BootServices->CreateEvent;
-	saved_set_timer = st->BootServices->SetTimer;
-	saved_wait_for_event = st->BootServices->WaitForEvent;
-	saved_signal_event = st->BootServices->SignalEvent;
-	saved_close_event = st->BootServices->CloseEvent;
-	saved_check_event = st->BootServices->CheckEvent;
+	/* Deadlines are expressed on the monotonic clock */
+	if (pthread_condattr_init(&attr) ||
+	    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) ||
+	    pthread_cond_init(&cond, &attr))
+		return EFI_DEVICE_ERROR;
+	pthread_condattr_destroy(&attr);
+
+	pthread_mutex_lock(&dispatcher.lock);
+	dispatcher.stopping = FALSE;
+	pthread_mutex_unlock(&dispatcher.lock);
 
-	st->BootServices->CreateEvent = create_event;
-	st->BootServices->SetTimer = set_timer;
-	st->BootServices->WaitForEvent = wait_for_event;
-	st->BootServices->SignalEvent = signal_event;
-	st->BootServices->CloseEvent = close_event;
-	st->BootServices->CheckEvent = check_event;
+	app_thread = pthread_self();
+	ret = ewevent_register_backend(&host_backend);
+	if (EFI_ERROR(ret))
+		pthread_cond_destroy(&cond);
 
-	return EFI_SUCCESS;
+	return ret;
 }
 
 static EFI_STATUS event_exit(EFI_SYSTEM_TABLE *st)
 {
+	EFI_STATUS ret;
+
 	if (!st)
 		return EFI_INVALID_PARAMETER;
 
-	st->BootServices->CreateEvent = saved_create_event;
-	st->BootServices->SetTimer = saved_set_timer;
-	st->BootServices->WaitForEvent = saved_wait_for_event;
-	st->BootServices->SignalEvent = saved_signal_event;
-	st->BootServices->CloseEvent = saved_close_event;
-	st->BootServices->CheckEvent = saved_check_event;
+	ret = ewevent_unregister_backend();
+	if (EFI_ERROR(ret))
+		return ret;
+
+	/* Idle dispatchers exit.  Busy ones may be blocked in a notify
+	 * function and are not waited for. */
+	pthread_mutex_lock(&dispatcher.lock);
+	dispatcher.stopping = TRUE;
+	pthread_cond_broadcast(&dispatcher.cond);
+	pthread_mutex_unlock(&dispatcher.lock);
+
+	pthread_cond_destroy(&cond);
 
 	return EFI_SUCCESS;
 }
 
 ewdrv_t event_drv = {
 	.name = "event",
-	.description = "Event management for host",
+	.description = "Event management for host: monotonic clock, \
+sleeping WaitForEvent() and EVT_NOTIFY_WAIT notify functions dispatcher",
 	.init = event_init,
 	.exit = event_exit
 };
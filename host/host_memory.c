@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ewlog.h>
+#include <ewlib.h>
+
+#include "host_memory.h"
+
+/* The pages are allocated in a single address range reserved at
+ * initialization time.  The memory map describes this range and each
+ * EFI physical address is the host virtual address. */
+#define ARENA_SIZE		((UINT64)1024 * 1024 * 1024)
+#define ARENA_MIN_SIZE		((UINT64)64 * 1024 * 1024)
+#define HUGEPAGE_SIZE		((UINT64)2 * 1024 * 1024)
+
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) & ~((UINT64)(a) - 1))
+
+static void *arena;
+static UINT64 arena_size;
+
+static EFI_MEMORY_DESCRIPTOR *memmap;
+static UINTN memmap_nb, memmap_max;
+static UINTN map_key;
+
+static EFI_ALLOCATE_PAGES saved_allocate_pages;
+static EFI_FREE_PAGES saved_free_pages;
+static EFI_GET_MEMORY_MAP saved_get_memory_map;
+
+static BOOLEAN is_code(EFI_MEMORY_TYPE type)
+{
+	return type == EfiLoaderCode || type == EfiBootServicesCode ||
+		type == EfiRuntimeServicesCode;
+}
+
+static int type_to_prot(EFI_MEMORY_TYPE type)
+{
+	if (type == EfiConventionalMemory)
+		return PROT_NONE;
+
+	if (is_code(type))
+		return PROT_READ | PROT_WRITE | PROT_EXEC;
+
+	return PROT_READ | PROT_WRITE;
+}
+
+static UINT64 descr_end(EFI_MEMORY_DESCRIPTOR *descr)
+{
+	return descr->PhysicalStart + descr->NumberOfPages * EFI_PAGE_SIZE;
+}
+
+static void set_mem_descr(EFI_MEMORY_DESCRIPTOR *descr,
+			  EFI_PHYSICAL_ADDRESS start, EFI_PHYSICAL_ADDRESS end,
+			  EFI_MEMORY_TYPE type)
+{
+	memset(descr, 0, sizeof(*descr));
+	descr->Type = type;
+	descr->PhysicalStart = start;
+	descr->VirtualStart = start;
+	descr->NumberOfPages = (end - start) / EFI_PAGE_SIZE;
+	descr->Attribute = EFI_MEMORY_WB;
+	if (type != EfiConventionalMemory && !is_code(type))
+		descr->Attribute |= EFI_MEMORY_XP;
+}
+
+static EFI_STATUS memmap_reserve(UINTN nb)
+{
+	EFI_MEMORY_DESCRIPTOR *new;
+	UINTN max;
+
+	if (nb <= memmap_max)
+		return EFI_SUCCESS;
+
+	max = max(nb, memmap_max * 2);
+	new = realloc(memmap, max * sizeof(*memmap));
+	if (!new)
+		return EFI_OUT_OF_RESOURCES;
+
+	memmap = new;
+	memmap_max = max;
+
+	return EFI_SUCCESS;
+}
+
+static void insert_mem_descr_at(size_t pos, EFI_PHYSICAL_ADDRESS start,
+				EFI_PHYSICAL_ADDRESS end, EFI_MEMORY_TYPE type)
+{
+	memmove(&memmap[pos + 1], &memmap[pos],
+		(memmap_nb - pos) * sizeof(*memmap));
+	memmap_nb++;
+	set_mem_descr(&memmap[pos], start, end, type);
+}
+
+static void merge_mem_descr(size_t pos)
+{
+	EFI_MEMORY_DESCRIPTOR *cur = &memmap[pos], *next = cur + 1;
+
+	if (pos + 1 >= memmap_nb || cur->Type != next->Type ||
+	    descr_end(cur) != next->PhysicalStart)
+		return;
+
+	cur->NumberOfPages += next->NumberOfPages;
+	memmove(next, next + 1, (memmap_nb - pos - 2) * sizeof(*memmap));
+	memmap_nb--;
+}
+
+/* Give type TYPE to the START:END range which must be included in the
+ * POS memory descriptor.  The caller must have reserved room for two
+ * more descriptors. */
+static void set_range(size_t pos, EFI_PHYSICAL_ADDRESS start,
+		      EFI_PHYSICAL_ADDRESS end, EFI_MEMORY_TYPE type)
+{
+	EFI_PHYSICAL_ADDRESS cur_start = memmap[pos].PhysicalStart;
+	EFI_PHYSICAL_ADDRESS cur_end = descr_end(&memmap[pos]);
+	EFI_MEMORY_TYPE cur_type = memmap[pos].Type;
+
+	if (start > cur_start)
+		insert_mem_descr_at(pos++, cur_start, start, cur_type);
+
+	set_mem_descr(&memmap[pos], start, end, type);
+
+	if (end < cur_end)
+		insert_mem_descr_at(pos + 1, end, cur_end, cur_type);
+
+	merge_mem_descr(pos);
+	if (pos > 0)
+		merge_mem_descr(pos - 1);
+
+	map_key++;
+}
+
+static EFI_STATUS find_range(EFI_ALLOCATE_TYPE Type, UINT64 size,
+			     EFI_PHYSICAL_ADDRESS address, size_t *pos_p,
+			     EFI_PHYSICAL_ADDRESS *start_p)
+{
+	EFI_PHYSICAL_ADDRESS start, cur_start, cur_end;
+	UINT64 align;
+	size_t i;
+
+	for (i = 0; i < memmap_nb; i++) {
+		if (memmap[i].Type != EfiConventionalMemory)
+			continue;
+
+		cur_start = memmap[i].PhysicalStart;
+		cur_end = descr_end(&memmap[i]);
+
+		if (Type == AllocateAddress) {
+			if (address < cur_start || address + size > cur_end)
+				continue;
+			start = address;
+			goto found;
+		}
+
+		/* Large allocations are placed on a huge page boundary
+		 * when possible */
+		align = size >= HUGEPAGE_SIZE ? HUGEPAGE_SIZE : EFI_PAGE_SIZE;
+		start = ALIGN_UP(cur_start, align);
+		if (start + size > cur_end)
+			start = cur_start;
+		if (start + size > cur_end)
+			continue;
+
+		if (Type == AllocateMaxAddress && start + size - 1 > address)
+			continue;
+
+		goto found;
+	}
+
+	return EFI_NOT_FOUND;
+
+found:
+	*pos_p = i;
+	*start_p = start;
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+allocate_pages(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType,
+	       UINTN NoPages, EFI_PHYSICAL_ADDRESS *Memory)
+{
+	EFI_STATUS ret;
+	EFI_PHYSICAL_ADDRESS start;
+	UINT64 size;
+	size_t pos;
+
+	if (Type >= MaxAllocateType || !Memory || NoPages == 0)
+		return EFI_INVALID_PARAMETER;
+
+	if ((MemoryType >= EfiMaxMemoryType && MemoryType <= 0x7fffffff) ||
+	    MemoryType == EfiConventionalMemory)
+		return EFI_INVALID_PARAMETER;
+
+	if (Type == AllocateAddress && *Memory % EFI_PAGE_SIZE)
+		return EFI_NOT_FOUND;
+
+	if (NoPages > arena_size / EFI_PAGE_SIZE)
+		return EFI_OUT_OF_RESOURCES;
+	size = (UINT64)NoPages * EFI_PAGE_SIZE;
+
+	ret = memmap_reserve(memmap_nb + 2);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = find_range(Type, size, *Memory, &pos, &start);
+	if (EFI_ERROR(ret))
+		return Type == AllocateAddress ? ret : EFI_OUT_OF_RESOURCES;
+
+	if (mprotect((void *)(UINTN)start, size, type_to_prot(MemoryType))) {
+		ewerr("Failed to map %zu pages, %s", (size_t)NoPages,
+		      strerror(errno));
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	/* Best effort, depends on the transparent hugepage setting */
+	if (start % HUGEPAGE_SIZE == 0 && size >= HUGEPAGE_SIZE)
+		madvise((void *)(UINTN)start, size, MADV_HUGEPAGE);
+
+	set_range(pos, start, start + size, MemoryType);
+	*Memory = start;
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+free_pages(EFI_PHYSICAL_ADDRESS Memory, UINTN NoPages)
+{
+	EFI_STATUS ret;
+	EFI_PHYSICAL_ADDRESS end;
+	size_t i;
+
+	if (Memory % EFI_PAGE_SIZE || NoPages == 0 ||
+	    NoPages > arena_size / EFI_PAGE_SIZE)
+		return EFI_INVALID_PARAMETER;
+
+	end = Memory + (UINT64)NoPages * EFI_PAGE_SIZE;
+	for (i = 0; i < memmap_nb; i++)
+		if (memmap[i].PhysicalStart <= Memory &&
+		    Memory < descr_end(&memmap[i]))
+			break;
+
+	if (i == memmap_nb || end > descr_end(&memmap[i]) ||
+	    memmap[i].Type == EfiConventionalMemory)
+		return EFI_NOT_FOUND;
+
+	ret = memmap_reserve(memmap_nb + 2);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	/* Give the pages back to the host */
+	madvise((void *)(UINTN)Memory, end - Memory, MADV_DONTNEED);
+	mprotect((void *)(UINTN)Memory, end - Memory, PROT_NONE);
+
+	set_range(i, Memory, end, EfiConventionalMemory);
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+get_memory_map(UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap,
+	       UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion)
+{
+	UINTN size;
+
+	if (!MemoryMapSize)
+		return EFI_INVALID_PARAMETER;
+
+	size = memmap_nb * sizeof(*memmap);
+	if (size > *MemoryMapSize) {
+		*MemoryMapSize = size;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	if (!MemoryMap || !MapKey || !DescriptorSize || !DescriptorVersion)
+		return EFI_INVALID_PARAMETER;
+
+	*MemoryMapSize = size;
+	memcpy(MemoryMap, memmap, size);
+	*MapKey = map_key;
+	*DescriptorSize = sizeof(*memmap);
+	*DescriptorVersion = EFI_MEMORY_DESCRIPTOR_VERSION;
+
+	return EFI_SUCCESS;
+}
+
+/* EFI applications commonly require memory below 4 GB so a smaller
+ * arena in the low address space is preferred to a larger one above
+ * it. */
+static void *reserve_arena(UINT64 *size_p)
+{
+	static const int extra_flags[] = {
+#ifdef MAP_32BIT
+		MAP_32BIT,
+#endif
+		0
+	};
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	UINT64 size;
+	size_t i;
+	void *addr;
+
+	for (i = 0; i < ARRAY_SIZE(extra_flags); i++)
+		for (size = ARENA_SIZE; size >= ARENA_MIN_SIZE; size /= 2) {
+			addr = mmap(NULL, size, PROT_NONE,
+				    flags | extra_flags[i], -1, 0);
+			if (addr != MAP_FAILED) {
+				*size_p = size;
+				return addr;
+			}
+		}
+
+	return NULL;
+}
+
+static EFI_STATUS update_crc(EFI_BOOT_SERVICES *bs)
+{
+	bs->Hdr.CRC32 = 0;
+	return uefi_call_wrapper(bs->CalculateCrc32, 3, bs, sizeof(*bs),
+				 &bs->Hdr.CRC32);
+}
+
+static EFI_STATUS memory_init(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+	EFI_PHYSICAL_ADDRESS start;
+
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	if (arena)
+		return EFI_ALREADY_STARTED;
+
+	arena = reserve_arena(&arena_size);
+	if (!arena) {
+		ewerr("Failed to reserve the memory arena, %s",
+		      strerror(errno));
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	ret = memmap_reserve(16);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	start = (EFI_PHYSICAL_ADDRESS)(UINTN)arena;
+	set_mem_descr(&memmap[0], start, start + arena_size,
+		      EfiConventionalMemory);
+	memmap_nb = 1;
+
+	saved_allocate_pages = st->BootServices->AllocatePages;
+	saved_free_pages = st->BootServices->FreePages;
+	saved_get_memory_map = st->BootServices->GetMemoryMap;
+	st->BootServices->AllocatePages = allocate_pages;
+	st->BootServices->FreePages = free_pages;
+	st->BootServices->GetMemoryMap = get_memory_map;
+
+	return update_crc(st->BootServices);
+
+err:
+	munmap(arena, arena_size);
+	arena = NULL;
+	return ret;
+}
+
+static EFI_STATUS memory_exit(EFI_SYSTEM_TABLE *st)
+{
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	if (!arena)
+		return EFI_NOT_STARTED;
+
+	st->BootServices->AllocatePages = saved_allocate_pages;
+	st->BootServices->FreePages = saved_free_pages;
+	st->BootServices->GetMemoryMap = saved_get_memory_map;
+
+	munmap(arena, arena_size);
+	arena = NULL;
+	free(memmap);
+	memmap = NULL;
+	memmap_nb = memmap_max = 0;
+
+	return update_crc(st->BootServices);
+}
+
+ewdrv_t memory_drv = {
+	.name = "memory",
+	.description = "Provide AllocatePages, FreePages and GetMemoryMap \
+boot services backed by a reserved mmap() arena.",
+	.init = memory_init,
+	.exit = memory_exit
+};
@@ -41,6 +41,7 @@
 #include <libgen.h>
 #include <ewlog.h>
 #include <ewlib.h>
+#include <ewprof.h>
 #include <setjmp.h>
 #include <string.h>
 #include <errno.h>
@@ -55,10 +56,15 @@
 #include "fileio.h"
 #include "gop.h"
 #include "image.h"
+#include "host_memory.h"
 #include "host_time.h"
+#include "serial.h"
 #include "terminal_conin.h"
+#include "trace.h"
+#include "variables.h"
 
 static ewdrv_t *host_drivers[] = {
+	&memory_drv,
 	&disk_drv,
 	&event_drv,
 	&tcp4_drv,
@@ -67,6 +73,8 @@ static ewdrv_t *host_drivers[] = {
 	&image_drv,
 	&time_drv,
 	&terminal_conin_drv,
+	&serial_drv,
+	&variables_drv,
 	NULL
 };
 ewdrv_t **ew_drivers = host_drivers;
@@ -75,6 +83,7 @@ typedef EFI_STATUS (*efi_main_t)(EFI_HANDLE image, EFI_SYSTEM_TABLE *st);
 static jmp_buf jmp;
 static EFI_STATUS reset_status;
 static char *cmdname;
+static bool profile;
 
 static EFIAPI EFI_STATUS
 reset_system(__attribute__((__unused__)) EFI_RESET_TYPE ResetType,
@@ -228,6 +237,11 @@ static void usage(int ret)
 	printf(" -h,--help                      Print this help\n");
 	printf(" --list-drivers                 List available drivers\n");
 	printf(" --disable-drivers=DRV1,DRV2    Disable drivers DRV1 and DRV2\n");
+	printf(" --variables=FILE               Persist the variables in FILE\n");
+	printf(" --trace=FILE                   Export a Chrome trace to FILE\n");
+	printf(" --profile                      Profile the boot and runtime services\n");
+	printf(" --serial=TRANSPORT             Connect SerialIo to TRANSPORT: pty[:LINK],\n");
+	printf("                                unix:SOCKET or file:IN,OUT\n");
 	exit(ret);
 }
 
@@ -289,6 +303,31 @@ static void disable_drivers(char *names)
 	}
 }
 
+static void set_variables_path(char *path)
+{
+	if (!*path)
+		error("Invalid variables file path\n");
+	variables_set_path(path);
+}
+
+static void enable_trace(char *path)
+{
+	if (!*path || EFI_ERROR(trace_start(path)))
+		error("Failed to enable the trace to '%s'\n", path);
+}
+
+static void enable_profile(__attribute__((__unused__)) char *arg)
+{
+	profile = true;
+	trace_set_host_clock();
+}
+
+static void enable_serial(char *transport)
+{
+	if (EFI_ERROR(serial_configure(transport)))
+		error("Invalid serial transport '%s'\n", transport);
+}
+
 static struct option {
 	const char *name;
 	bool has_argument;
@@ -297,7 +336,11 @@ static struct option {
 	{ "-h", false, help },
 	{ "--help", false, help },
 	{ "--list-drivers", false, list_drivers },
-	{ "--disable-drivers", true, disable_drivers }
+	{ "--disable-drivers", true, disable_drivers },
+	{ "--variables", true, set_variables_path },
+	{ "--trace", true, enable_trace },
+	{ "--profile", false, enable_profile },
+	{ "--serial", true, enable_serial }
 };
 
 static struct option *get_option(char *name, char **arg)
@@ -371,11 +414,21 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if (profile) {
+		ret = ewprof_start(st);
+		if (EFI_ERROR(ret))
+			ewerr("Failed to start the services profiler");
+	}
+
 	ret = load_and_execute(argv[1], image, st);
 	if (EFI_ERROR(ret))
 		ewerr("%s load and execute failed, ret=0x%zx",
 		      argv[1], (size_t)ret);
 
+	if (profile)
+		ewprof_stop(st);
+
+	disk_dump_stats(st);
 	ret = ewdrv_exit(st);
 	if (ret)
 		ewerr("drivers release failed");
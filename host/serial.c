@@ -0,0 +1,649 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <ewlib.h>
+#include <ewlog.h>
+#include <ewtrace.h>
+
+#include "serial.h"
+
+/* Size of the receive and transmit rings, a power of two */
+#define RING_SIZE	4096
+#define RING_MASK	(RING_SIZE - 1)
+
+/* Polling interval used when the input file is at its end */
+#define EOF_POLL_NS	1000000ULL
+
+typedef struct ring {
+	UINT8 data[RING_SIZE];
+	UINTN head;		/* Free running producer index */
+	UINTN tail;		/* Free running consumer index */
+} ring_t;
+
+typedef enum transport {
+	TRANSPORT_NONE,
+	TRANSPORT_PTY,
+	TRANSPORT_UNIX,
+	TRANSPORT_FILE
+} transport_t;
+
+static struct {
+	transport_t transport;
+	char *path;		/* pty link, socket or input file */
+	char *out_path;		/* output file */
+} config;
+
+static int rx_fd = -1, tx_fd = -1, pty_slave = -1;
+static bool rx_eof;
+static ring_t rx, tx;
+static UINT32 control;
+static UINT64 start_ns;
+
+static struct {
+	UINT64 rx_bytes;
+	UINT64 tx_bytes;
+	UINT64 rx_wait_ns;
+	UINT64 tx_wait_ns;
+	UINT64 rx_timeouts;
+	UINT64 tx_timeouts;
+} stats;
+
+static SERIAL_IO_INTERFACE *serialio;
+static SERIAL_IO_INTERFACE saved_serialio;
+
+static UINT64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static UINTN ring_used(ring_t *ring)
+{
+	return ring->head - ring->tail;
+}
+
+static UINTN ring_put(ring_t *ring, const UINT8 *buf, UINTN len)
+{
+	UINTN i;
+
+	len = min(len, RING_SIZE - ring_used(ring));
+	for (i = 0; i < len; i++)
+		ring->data[ring->head++ & RING_MASK] = buf[i];
+
+	return len;
+}
+
+static UINTN ring_get(ring_t *ring, UINT8 *buf, UINTN len)
+{
+	UINTN i;
+
+	len = min(len, ring_used(ring));
+	for (i = 0; i < len; i++)
+		buf[i] = ring->data[ring->tail++ & RING_MASK];
+
+	return len;
+}
+
+/* Move the pending input bytes into the receive ring */
+static EFI_STATUS rx_fill(void)
+{
+	UINTN offset, len;
+	ssize_t nb;
+
+	rx_eof = false;
+	while (ring_used(&rx) < RING_SIZE) {
+		offset = rx.head & RING_MASK;
+		len = min(RING_SIZE - ring_used(&rx), RING_SIZE - offset);
+
+		nb = read(rx_fd, &rx.data[offset], len);
+		if (nb > 0) {
+			rx.head += nb;
+			continue;
+		}
+
+		if (nb == 0) {
+			rx_eof = true;
+			return EFI_SUCCESS;
+		}
+
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return EFI_SUCCESS;
+
+		ewerr("Failed to read from the serial port, %s",
+		      strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/* Write as much of the transmit ring as the transport accepts */
+static EFI_STATUS tx_drain(void)
+{
+	UINTN offset, len;
+	ssize_t nb;
+
+	while (ring_used(&tx)) {
+		offset = tx.tail & RING_MASK;
+		len = min(ring_used(&tx), RING_SIZE - offset);
+
+		if (config.transport == TRANSPORT_UNIX)
+			nb = send(tx_fd, &tx.data[offset], len, MSG_NOSIGNAL);
+		else
+			nb = write(tx_fd, &tx.data[offset], len);
+		if (nb > 0) {
+			tx.tail += nb;
+			continue;
+		}
+
+		if (nb == -1 && errno == EINTR)
+			continue;
+		if (nb == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return EFI_NOT_READY;
+
+		ewerr("Failed to write to the serial port, %s",
+		      strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/* Wait for FD to be ready for EVENTS until the DEADLINE */
+static EFI_STATUS wait_fd(int fd, short events, UINT64 deadline,
+			  UINT64 *waited)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+	struct timespec ts;
+	UINT64 now, remaining;
+	int ret;
+
+	now = now_ns();
+	if (now >= deadline)
+		return EFI_TIMEOUT;
+
+	remaining = deadline - now;
+	if (fd == rx_fd && rx_eof)
+		remaining = min(remaining, EOF_POLL_NS);
+	ts.tv_sec = remaining / 1000000000ULL;
+	ts.tv_nsec = remaining % 1000000000ULL;
+
+	if (fd == rx_fd && rx_eof)
+		ret = nanosleep(&ts, NULL);
+	else
+		ret = ppoll(&pfd, 1, &ts, NULL);
+	*waited += now_ns() - now;
+
+	if (ret == -1 && errno != EINTR) {
+		ewerr("Failed to wait for the serial port, %s",
+		      strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+serial_reset(SERIAL_IO_INTERFACE *This)
+{
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	rx.tail = rx.head;
+	control = 0;
+
+	return uefi_call_wrapper(This->SetAttributes, 7, This, 0, 0, 0,
+				 DefaultParity, 0, DefaultStopBits);
+}
+
+static EFIAPI EFI_STATUS
+serial_set_control(SERIAL_IO_INTERFACE *This, UINT32 Control)
+{
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	control = Control;
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+serial_get_control(SERIAL_IO_INTERFACE *This, UINT32 *Control)
+{
+	EFI_STATUS ret;
+
+	if (!This || !Control)
+		return EFI_INVALID_PARAMETER;
+
+	ret = rx_fill();
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = tx_drain();
+	if (ret == EFI_DEVICE_ERROR)
+		return ret;
+
+	*Control = control;
+	if (!ring_used(&rx))
+		*Control |= EFI_SERIAL_INPUT_BUFFER_EMPTY;
+	if (!ring_used(&tx))
+		*Control |= EFI_SERIAL_OUTPUT_BUFFER_EMPTY;
+
+	return EFI_SUCCESS;
+}
+
+/* The SerialIo timeout applies to each character: the deadline is
+ * pushed back every time some progress is made. */
+static EFIAPI EFI_STATUS
+serial_write(SERIAL_IO_INTERFACE *This, UINTN *BufferSize, VOID *Buffer)
+{
+	EFI_STATUS ret = EFI_SUCCESS;
+	UINT64 timeout, deadline;
+	UINTN done, nb;
+
+	if (!This || !BufferSize || (*BufferSize && !Buffer))
+		return EFI_INVALID_PARAMETER;
+
+	ewtrace_begin("SerialIo.Write", *BufferSize);
+
+	timeout = This->Mode->Timeout * 1000ULL;
+	deadline = now_ns() + timeout;
+	for (done = 0; done < *BufferSize; ) {
+		nb = ring_put(&tx, (UINT8 *)Buffer + done, *BufferSize - done);
+		done += nb;
+
+		ret = tx_drain();
+		if (ret == EFI_DEVICE_ERROR)
+			break;
+		ret = EFI_SUCCESS;
+
+		if (done == *BufferSize)
+			break;
+
+		if (nb || ring_used(&tx) < RING_SIZE) {
+			deadline = now_ns() + timeout;
+			continue;
+		}
+
+		ret = wait_fd(tx_fd, POLLOUT, deadline, &stats.tx_wait_ns);
+		if (ret == EFI_TIMEOUT)
+			stats.tx_timeouts++;
+		if (EFI_ERROR(ret))
+			break;
+	}
+
+	stats.tx_bytes += done;
+	*BufferSize = done;
+
+	ewtrace_end("SerialIo.Write");
+
+	return ret;
+}
+
+static EFIAPI EFI_STATUS
+serial_read(SERIAL_IO_INTERFACE *This, UINTN *BufferSize, VOID *Buffer)
+{
+	EFI_STATUS ret = EFI_SUCCESS;
+	UINT64 timeout, deadline;
+	UINTN done, nb;
+
+	if (!This || !BufferSize || (*BufferSize && !Buffer))
+		return EFI_INVALID_PARAMETER;
+
+	ewtrace_begin("SerialIo.Read", *BufferSize);
+
+	timeout = This->Mode->Timeout * 1000ULL;
+	deadline = now_ns() + timeout;
+	for (done = 0; done < *BufferSize; ) {
+		ret = rx_fill();
+		if (EFI_ERROR(ret))
+			break;
+
+		nb = ring_get(&rx, (UINT8 *)Buffer + done, *BufferSize - done);
+		if (nb) {
+			done += nb;
+			deadline = now_ns() + timeout;
+			continue;
+		}
+
+		ret = wait_fd(rx_fd, POLLIN, deadline, &stats.rx_wait_ns);
+		if (ret == EFI_TIMEOUT)
+			stats.rx_timeouts++;
+		if (EFI_ERROR(ret))
+			break;
+	}
+
+	stats.rx_bytes += done;
+	*BufferSize = done;
+
+	ewtrace_end("SerialIo.Read");
+
+	return ret;
+}
+
+EFI_STATUS serial_configure(const char *transport)
+{
+	const char *arg;
+	char *comma;
+
+	if (!transport)
+		return EFI_INVALID_PARAMETER;
+
+	free(config.path);
+	memset(&config, 0, sizeof(config));
+
+	if (!strcmp(transport, "pty")) {
+		config.transport = TRANSPORT_PTY;
+		return EFI_SUCCESS;
+	}
+
+	if (!strncmp(transport, "pty:", 4)) {
+		config.transport = TRANSPORT_PTY;
+		arg = transport + 4;
+	} else if (!strncmp(transport, "unix:", 5)) {
+		config.transport = TRANSPORT_UNIX;
+		arg = transport + 5;
+	} else if (!strncmp(transport, "file:", 5)) {
+		config.transport = TRANSPORT_FILE;
+		arg = transport + 5;
+	} else
+		return EFI_INVALID_PARAMETER;
+
+	if (!*arg)
+		goto err;
+
+	config.path = strdup(arg);
+	if (!config.path)
+		goto err;
+
+	if (config.transport != TRANSPORT_FILE)
+		return EFI_SUCCESS;
+
+	comma = strchr(config.path, ',');
+	if (!comma || comma == config.path || !comma[1]) {
+		free(config.path);
+		goto err;
+	}
+
+	*comma = '\0';
+	config.out_path = comma + 1;
+
+	return EFI_SUCCESS;
+
+err:
+	memset(&config, 0, sizeof(config));
+	return EFI_INVALID_PARAMETER;
+}
+
+static EFI_STATUS open_pty(void)
+{
+	struct termios term;
+	char *name;
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd == -1 || grantpt(fd) || unlockpt(fd))
+		goto err;
+
+	name = ptsname(fd);
+	if (!name)
+		goto err;
+
+	/* Keeping the slave side open prevents the master side from
+	 * failing while no peer is connected. */
+	pty_slave = open(name, O_RDWR | O_NOCTTY);
+	if (pty_slave == -1 || tcgetattr(pty_slave, &term))
+		goto err;
+
+	cfmakeraw(&term);
+	if (tcsetattr(pty_slave, TCSANOW, &term))
+		goto err;
+
+	if (config.path) {
+		unlink(config.path);
+		if (symlink(name, config.path))
+			goto err;
+	}
+
+	ewdbg("Serial port available at %s", name);
+	rx_fd = tx_fd = fd;
+	return EFI_SUCCESS;
+
+err:
+	ewerr("Failed to set up the serial pty, %s", strerror(errno));
+	if (pty_slave != -1)
+		close(pty_slave);
+	if (fd != -1)
+		close(fd);
+	pty_slave = -1;
+	return EFI_DEVICE_ERROR;
+}
+
+static EFI_STATUS open_unix(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(config.path) >= sizeof(addr.sun_path)) {
+		ewerr("'%s' socket path is too long", config.path);
+		return EFI_INVALID_PARAMETER;
+	}
+	strcpy(addr.sun_path, config.path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		ewerr("Failed to create the serial socket, %s",
+		      strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		ewerr("Failed to connect to %s, %s", config.path,
+		      strerror(errno));
+		close(fd);
+		return EFI_DEVICE_ERROR;
+	}
+
+	rx_fd = tx_fd = fd;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS open_files(void)
+{
+	rx_fd = open(config.path, O_RDONLY | O_NONBLOCK);
+	if (rx_fd == -1) {
+		ewerr("Failed to open %s, %s", config.path, strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	tx_fd = open(config.out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (tx_fd == -1) {
+		ewerr("Failed to open %s, %s", config.out_path,
+		      strerror(errno));
+		close(rx_fd);
+		rx_fd = -1;
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static void close_transport(void)
+{
+	if (tx_fd != -1 && tx_fd != rx_fd)
+		close(tx_fd);
+	if (rx_fd != -1)
+		close(rx_fd);
+	if (pty_slave != -1)
+		close(pty_slave);
+	if (config.transport == TRANSPORT_PTY && config.path)
+		unlink(config.path);
+
+	rx_fd = tx_fd = pty_slave = -1;
+}
+
+static EFI_STATUS set_nonblock(int fd)
+{
+	int flags;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		ewerr("Failed to make the serial port non-blocking, %s",
+		      strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS serial_init(EFI_SYSTEM_TABLE *st)
+{
+	EFI_GUID serialio_guid = SERIAL_IO_PROTOCOL;
+	EFI_STATUS ret;
+
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	if (config.transport == TRANSPORT_NONE)
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(st->BootServices->LocateProtocol, 3,
+				&serialio_guid, NULL, (void **)&serialio);
+	if (EFI_ERROR(ret)) {
+		ewerr("Failed to locate the SerialIo protocol");
+		return ret;
+	}
+
+	switch (config.transport) {
+	case TRANSPORT_PTY:
+		ret = open_pty();
+		break;
+	case TRANSPORT_UNIX:
+		ret = open_unix();
+		break;
+	default:
+		ret = open_files();
+	}
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = set_nonblock(rx_fd);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	ret = set_nonblock(tx_fd);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	saved_serialio = *serialio;
+	serialio->Reset = serial_reset;
+	serialio->SetControl = serial_set_control;
+	serialio->GetControl = serial_get_control;
+	serialio->Write = serial_write;
+	serialio->Read = serial_read;
+
+	memset(&stats, 0, sizeof(stats));
+	start_ns = now_ns();
+
+	return EFI_SUCCESS;
+
+err:
+	close_transport();
+	return ret;
+}
+
+static EFI_STATUS serial_exit(__attribute__((__unused__)) EFI_SYSTEM_TABLE *st)
+{
+	UINT64 deadline, elapsed;
+	EFI_STATUS ret;
+
+	if (rx_fd == -1)
+		return EFI_SUCCESS;
+
+	deadline = now_ns() + serialio->Mode->Timeout * 1000ULL;
+	while ((ret = tx_drain()) == EFI_NOT_READY)
+		if (EFI_ERROR(wait_fd(tx_fd, POLLOUT, deadline,
+				      &stats.tx_wait_ns)))
+			break;
+	if (ring_used(&tx))
+		ewerr("%lu bytes of serial output lost",
+		      (unsigned long)ring_used(&tx));
+
+	elapsed = now_ns() - start_ns;
+	printf("serial: %llu bytes sent, %llu bytes received in %llu ms\n",
+	       (unsigned long long)stats.tx_bytes,
+	       (unsigned long long)stats.rx_bytes,
+	       (unsigned long long)elapsed / 1000000);
+	printf("serial: %llu B/s sent, %llu B/s received\n",
+	       elapsed ? (unsigned long long)stats.tx_bytes * 1000000000ULL /
+			 elapsed : 0,
+	       elapsed ? (unsigned long long)stats.rx_bytes * 1000000000ULL /
+			 elapsed : 0);
+	printf("serial: waited %llu us to send, %llu us to receive, "
+	       "%llu write and %llu read timeouts\n",
+	       (unsigned long long)stats.tx_wait_ns / 1000,
+	       (unsigned long long)stats.rx_wait_ns / 1000,
+	       (unsigned long long)stats.tx_timeouts,
+	       (unsigned long long)stats.rx_timeouts);
+
+	serialio->Reset = saved_serialio.Reset;
+	serialio->SetControl = saved_serialio.SetControl;
+	serialio->GetControl = saved_serialio.GetControl;
+	serialio->Write = saved_serialio.Write;
+	serialio->Read = saved_serialio.Read;
+	serialio = NULL;
+
+	rx.head = rx.tail = tx.head = tx.tail = 0;
+	close_transport();
+
+	return EFI_SUCCESS;
+}
+
+ewdrv_t serial_drv = {
+	.name = "serial",
+	.description = "Provide a SerialIo over a pty, a Unix socket or files",
+	.init = serial_init,
+	.exit = serial_exit
+};
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewlog.h>
+#include <ewtrace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static const char *trace_path;
+
+static UINT64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static UINT32 thread_id(void)
+{
+	static __thread UINT32 tid;
+
+	if (!tid)
+		tid = syscall(SYS_gettid);
+	return tid;
+}
+
+static void write_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', f);
+		fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+static void export(void)
+{
+	static const char PHASES[] = { 'B', 'E', 'i' };
+	ewtrace_record_t *records;
+	UINT64 frequency;
+	UINTN i, nb;
+	FILE *f;
+
+	records = malloc(EWTRACE_RING_SIZE * sizeof(*records));
+	if (!records) {
+		ewerr("Failed to allocate the trace export buffer");
+		return;
+	}
+
+	nb = ewtrace_snapshot(records, EWTRACE_RING_SIZE);
+	frequency = ewtrace_frequency();
+
+	f = fopen(trace_path, "w");
+	if (!f) {
+		ewerr("Failed to open '%s'", trace_path);
+		free(records);
+		return;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (i = 0; i < nb; i++) {
+		fprintf(f, "%s{\"name\":", i ? ",\n" : "");
+		write_string(f, records[i].name);
+		fprintf(f, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+			PHASES[records[i].type],
+			frequency ? records[i].timestamp * 1e6 / frequency :
+			(double)records[i].timestamp, records[i].tid);
+		if (records[i].type == EWTRACE_INSTANT)
+			fprintf(f, ",\"s\":\"t\"");
+		if (records[i].type != EWTRACE_END)
+			fprintf(f, ",\"args\":{\"arg\":%u}", records[i].arg);
+		fputc('}', f);
+	}
+	fprintf(f, "\n]}\n");
+
+	fclose(f);
+	free(records);
+	ewdbg("%u trace records exported to '%s'", (UINT32)nb, trace_path);
+}
+
+void trace_set_host_clock(void)
+{
+	ewtrace_set_clock(now_ns, 1000000000);
+	ewtrace_set_thread_id(thread_id);
+}
+
+EFI_STATUS trace_start(const char *path)
+{
+	if (!path)
+		return EFI_INVALID_PARAMETER;
+
+	trace_path = path;
+	trace_set_host_clock();
+
+	if (atexit(export))
+		return EFI_OUT_OF_RESOURCES;
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <ewlog.h>
+#include <ewvar_log.h>
+#include <storage.h>
+
+#include "variables.h"
+
+static const char *variables_path = "./variables.img";
+static const UINT32 VARIABLES_BLK_SZ = 512;
+static const EFI_LBA VARIABLES_BLK_CNT = 512;
+
+static int fd = -1;
+
+static EFI_LBA read_or_write(storage_t *s, EFI_LBA start, EFI_LBA count,
+			     void *buf, BOOLEAN do_read)
+{
+	ssize_t ret;
+	size_t total, size = count * s->blk_sz;
+	off_t off = start * s->blk_sz;
+
+	for (total = 0; total < size; total += ret) {
+		if (do_read)
+			ret = pread(fd, (char *)buf + total, size - total,
+				    off + total);
+		else
+			ret = pwrite(fd, (char *)buf + total, size - total,
+				     off + total);
+
+		if (ret == -1 && errno == EINTR) {
+			ret = 0;
+			continue;
+		}
+
+		/* Reading past the end of the file: never written yet */
+		if (do_read && ret == 0) {
+			memset((char *)buf + total, 0, size - total);
+			break;
+		}
+
+		if (ret <= 0) {
+			ewerr("Failed to %s variables file, %s",
+			      do_read ? "read from" : "write to",
+			      strerror(errno));
+			return total / s->blk_sz;
+		}
+	}
+
+	if (!do_read && fdatasync(fd) == -1) {
+		ewerr("Failed to sync variables file, %s", strerror(errno));
+		return 0;
+	}
+
+	return count;
+}
+
+static EFI_LBA _read(storage_t *s, EFI_LBA start, EFI_LBA count,
+		     void *buf)
+{
+	return read_or_write(s, start, count, buf, TRUE);
+}
+
+static EFI_LBA _write(storage_t *s, EFI_LBA start, EFI_LBA count,
+		      const void *buf)
+{
+	return read_or_write(s, start, count, (void *)buf, FALSE);
+}
+
+static storage_t variables_storage = {
+	.read = _read,
+	.write = _write,
+	.erase = NULL
+};
+
+void variables_set_path(const char *path)
+{
+	variables_path = path;
+}
+
+static EFI_STATUS variables_init(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	if (fd != -1)
+		return EFI_ALREADY_STARTED;
+
+	fd = open(variables_path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1) {
+		ewerr("Failed to open %s variables file, %s",
+		      variables_path, strerror(errno));
+		return EFI_DEVICE_ERROR;
+	}
+
+	variables_storage.blk_sz = VARIABLES_BLK_SZ;
+	variables_storage.blk_cnt = VARIABLES_BLK_CNT;
+
+	ret = ewvar_log_register(&variables_storage, 0, VARIABLES_BLK_CNT);
+	if (EFI_ERROR(ret)) {
+		close(fd);
+		fd = -1;
+	}
+
+	return ret;
+}
+
+static EFI_STATUS variables_exit(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	if (fd == -1)
+		return EFI_NOT_STARTED;
+
+	ret = ewvar_log_unregister();
+	close(fd);
+	fd = -1;
+
+	return ret;
+}
+
+ewdrv_t variables_drv = {
+	.name = "variables",
+	.description = "Persist the non-volatile variables in a \
+log-structured file",
+	.init = variables_init,
+	.exit = variables_exit
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWBLKCACHE_H_
+#define _EWBLKCACHE_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Statistics of the block cache of a storage device.  This protocol
+ * is installed on the storage handles which have a block cache. */
+#define EFIWRAPPER_BLOCK_CACHE_PROTOCOL_GUID				\
+	{ 0x82459e96, 0xff3e, 0x4e28,					\
+	  { 0x89, 0xdf, 0x85, 0x0a, 0x6e, 0x03, 0x88, 0x6c }}
+
+#define EFIWRAPPER_BLOCK_CACHE_PROTOCOL_REVISION 0x00010000
+
+typedef struct {
+	UINT64 Hits;		/* Blocks read from the cache */
+	UINT64 Misses;		/* Blocks read from the storage and cached */
+	UINT64 Bypassed;	/* Blocks of large reads, not cached */
+	UINT64 Evictions;	/* Blocks dropped to make room */
+	UINT64 Invalidations;	/* Blocks dropped on write or erase */
+	UINT64 WriteBackBlocks;	/* Dirty blocks written to the storage */
+	UINT64 WriteBackRequests; /* Vectored storage writes issued */
+	UINT32 CachedBlocks;
+	UINT32 CapacityBlocks;
+	UINT32 DirtyBlocks;
+	BOOLEAN WriteThrough;
+	BOOLEAN WriteBack;
+} EFIWRAPPER_BLOCK_CACHE_STATS;
+
+typedef struct _EFIWRAPPER_BLOCK_CACHE_PROTOCOL EFIWRAPPER_BLOCK_CACHE_PROTOCOL;
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_BLOCK_CACHE_GET_STATS)(EFIWRAPPER_BLOCK_CACHE_PROTOCOL *This,
+					   EFIWRAPPER_BLOCK_CACHE_STATS *Stats);
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_BLOCK_CACHE_RESET_STATS)(EFIWRAPPER_BLOCK_CACHE_PROTOCOL *This);
+
+struct _EFIWRAPPER_BLOCK_CACHE_PROTOCOL {
+	UINT32 Revision;
+	EFIWRAPPER_BLOCK_CACHE_GET_STATS GetStats;
+	EFIWRAPPER_BLOCK_CACHE_RESET_STATS ResetStats;
+};
+
+#endif	/* _EWBLKCACHE_H_ */
@@ -35,17 +35,40 @@
 #include <efi.h>
 #include <efiapi.h>
 
+/* The bring-up of a driver can be split to overlap its hardware waits
+ * with the bring-up of the other drivers:
+ * - start() initiates it,
+ * - poll() returns EFI_NOT_READY until the hardware is ready.  The
+ *   poll() functions of the drivers being brought up are interleaved,
+ *   so it must not block,
+ * - init() completes it.
+ * start() and poll() are optional.  Once start() has succeeded, exit()
+ * is called even if the bring-up does not complete.
+ *
+ * A driver is brought up once its DEPENDS drivers are initialized.
+ * Without DEPENDS, it depends on all the drivers before it in the list.
+ * Dependencies absent from the list are ignored.  The drivers with a
+ * poll() function are started first.
+ *
+ * For instance, the nvme driver enables its controller in start() and
+ * only depends on the abl driver: listed after the drivers it does not
+ * need, its controller ready wait overlaps with their bring-up. */
 typedef struct ewdrv {
 	const char *name;	/* Mandatory */
 	const char *description;
 	EFI_STATUS (*init)(EFI_SYSTEM_TABLE *st); /* Mandatory */
 	EFI_STATUS (*exit)(EFI_SYSTEM_TABLE *st);
+	EFI_STATUS (*start)(EFI_SYSTEM_TABLE *st);
+	EFI_STATUS (*poll)(EFI_SYSTEM_TABLE *st);
+	const char **depends;	/* NULL terminated driver names */
 	void *priv;
 } ewdrv_t;
 
 /* NULL terminated driver list */
 extern ewdrv_t **ew_drivers;
 
+/* Bring up the drivers and log the startup timing of each of them at
+ * the info level */
 EFI_STATUS ewdrv_init(EFI_SYSTEM_TABLE *st);
 EFI_STATUS ewdrv_exit(EFI_SYSTEM_TABLE *st);
 
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWEVENT_H_
+#define _EWEVENT_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+#define EWEVENT_NO_DEADLINE	((UINT64)-1)
+
+#ifndef EFI_EVENT_GROUP_EXIT_BOOT_SERVICES
+#define EFI_EVENT_GROUP_EXIT_BOOT_SERVICES				\
+	{ 0x27abf055, 0xb1b8, 0x4c26,					\
+	  { 0x80, 0x48, 0x74, 0x8f, 0x37, 0xba, 0xa2, 0xdf } }
+#endif
+
+/* Environment hooks of the event boot services.  Any of them can be
+ * NULL.  Without a clock the timer events are not supported and
+ * without a sleep function WaitForEvent() polls. */
+typedef struct ewevent_backend {
+	UINT64 (*now)(void);	/* Monotonic time in 100 ns unit */
+	void (*lock)(void);
+	void (*unlock)(void);
+	/* Called locked.  Release the lock until wake() is called or
+	 * the DEADLINE time is reached. */
+	void (*sleep)(UINT64 deadline);
+	void (*wake)(void);
+	/* Run FUN asynchronously.  Used for the notify function of the
+	 * EVT_NOTIFY_WAIT events which may block. */
+	EFI_STATUS (*defer)(void (*fun)(void *), void *arg, EFI_TPL tpl);
+	/* TPL of the calling thread, NULL for the thread running the
+	 * EFI application.  Only the latter dispatches the notify
+	 * functions of the EVT_NOTIFY_SIGNAL events. */
+	EFI_TPL *(*thread_tpl)(void);
+} ewevent_backend_t;
+
+EFI_STATUS ewevent_register_backend(ewevent_backend_t *b);
+EFI_STATUS ewevent_unregister_backend(void);
+
+#endif	/* _EWEVENT_H_ */
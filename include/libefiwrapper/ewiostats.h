@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWIOSTATS_H_
+#define _EWIOSTATS_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* I/O statistics of a storage device.  This protocol is installed on
+ * all the storage handles. */
+#define EFIWRAPPER_IO_STATS_PROTOCOL_GUID				\
+	{ 0x5d0e2c8a, 0x3b71, 0x4f96,					\
+	  { 0xa4, 0x1e, 0x6c, 0x93, 0x2f, 0xd8, 0x07, 0xb5 }}
+
+#define EFIWRAPPER_IO_STATS_PROTOCOL_REVISION 0x00010000
+
+/* Number of buckets of the log2 histograms */
+#define EFIWRAPPER_IO_HISTOGRAM_SIZE	32
+
+typedef enum {
+	EfiwrapperIoRead,
+	EfiwrapperIoWrite,
+	EfiwrapperIoErase,
+	EfiwrapperIoFlush,
+	EfiwrapperIoMax
+} EFIWRAPPER_IO_TYPE;
+
+typedef struct {
+	UINT64 Operations;
+	UINT64 Errors;
+	UINT64 Bytes;
+	UINT64 TotalTime;	/* In 100 ns unit */
+	UINT64 MaxTime;
+	/* Bucket N counts the requests of 2^N to 2^(N+1) - 1 bytes */
+	UINT64 SizeHistogram[EFIWRAPPER_IO_HISTOGRAM_SIZE];
+	/* Bucket N counts the requests which took 2^N to 2^(N+1) - 1
+	 * microseconds, bucket 0 includes the shorter ones */
+	UINT64 LatencyHistogram[EFIWRAPPER_IO_HISTOGRAM_SIZE];
+} EFIWRAPPER_IO_OP_STATS;
+
+typedef struct {
+	EFIWRAPPER_IO_OP_STATS Op[EfiwrapperIoMax];
+	UINT64 UnalignedHeads;	/* DiskIo accesses to a partial first block */
+	UINT64 UnalignedTails;	/* DiskIo accesses to a partial last block */
+	UINT32 BlockSize;
+	BOOLEAN Timed;		/* FALSE if no clock measures the latencies */
+} EFIWRAPPER_IO_STATS;
+
+typedef struct _EFIWRAPPER_IO_STATS_PROTOCOL EFIWRAPPER_IO_STATS_PROTOCOL;
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_IO_STATS_GET_STATS)(EFIWRAPPER_IO_STATS_PROTOCOL *This,
+					EFIWRAPPER_IO_STATS *Stats);
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_IO_STATS_RESET_STATS)(EFIWRAPPER_IO_STATS_PROTOCOL *This);
+
+struct _EFIWRAPPER_IO_STATS_PROTOCOL {
+	UINT32 Revision;
+	EFIWRAPPER_IO_STATS_GET_STATS GetStats;
+	EFIWRAPPER_IO_STATS_RESET_STATS ResetStats;
+};
+
+#endif	/* _EWIOSTATS_H_ */
@@ -46,16 +46,81 @@
 
 #define EWLOG_PREFIX "efiwrapper: "
 
+typedef enum {
+	EWLOG_ERROR,
+	EWLOG_WARNING,
+	EWLOG_INFO,
+	EWLOG_DEBUG,
+	EWLOG_VERBOSE
+} ewlog_level_t;
+
+/* Messages are formatted into an in-memory ring drained to the console
+ * when the boot services are idle, when the ring is getting full, on
+ * error messages and on ExitBootServices().  Before ewlog_init() and
+ * after ewlog_free() they are printed directly. */
+#ifndef EWLOG_RING_SIZE
+#define EWLOG_RING_SIZE		128	/* Power of two */
+#endif
+#define EWLOG_MSG_SIZE		232
+
+/* Each module, by default the base name of the source file, has its
+ * own level */
+#ifndef EWLOG_MODULE
+#define EWLOG_MODULE __FILE__
+#endif
+
+typedef struct ewlog_site {
+	const char *module;
+	UINT32 generation;	/* Configuration LEVEL was resolved for */
+	UINT32 level;
+} ewlog_site_t;
+
+extern UINT32 ewlog_generation;
+void ewlog_resolve(ewlog_site_t *site);
+
+static inline BOOLEAN ewlog_enabled(ewlog_site_t *site, ewlog_level_t level)
+{
+	if (site->generation != ewlog_generation)
+		ewlog_resolve(site);
+	return level <= site->level;
+}
+
+void ewlog_add(ewlog_site_t *site, ewlog_level_t level, const char *fmt, ...);
+
+#define ewlog(level, fmt, ...) do { \
+	static ewlog_site_t ewlog_site = { .module = EWLOG_MODULE }; \
+	if (ewlog_enabled(&ewlog_site, level)) \
+		ewlog_add(&ewlog_site, level, fmt, ##__VA_ARGS__); \
+} while (0)
+
+/* TRUE if a LEVEL message of the calling module would be logged, to
+ * skip the computation of the arguments of a series of messages */
+#define ewlog_wanted(level) ({ \
+	static ewlog_site_t ewlog_site = { .module = EWLOG_MODULE }; \
+	ewlog_enabled(&ewlog_site, level); \
+})
+
 #if DEBUG_MESSAGES
-#define ewdbg(fmt, ...) do { \
-    printf(EWLOG_PREFIX fmt "\n", ##__VA_ARGS__); \
-} while(0)
+#define ewdbg(fmt, ...) ewlog(EWLOG_DEBUG, fmt, ##__VA_ARGS__)
 #else
 #define ewdbg(fmt, ...) (void)0
 #endif
 
-#define ewerr(fmt, ...) do { \
-	printf(EWLOG_PREFIX fmt "\n", ##__VA_ARGS__); \
-} while (0)
+#define ewerr(fmt, ...) ewlog(EWLOG_ERROR, fmt, ##__VA_ARGS__)
+
+/* Set the level of MODULE, or the default level if MODULE is NULL */
+EFI_STATUS ewlog_set_level(const char *module, ewlog_level_t level);
+
+/* Apply a "LEVEL,MODULE:LEVEL,..." configuration where LEVEL is a
+ * number or a level name ("error", "warning", "info", "debug" or
+ * "verbose") */
+EFI_STATUS ewlog_configure(const char *config);
+
+/* Print the messages of the ring */
+void ewlog_flush(void);
+BOOLEAN ewlog_pending(void);
+
+EFI_STATUS ewlog_init(EFI_SYSTEM_TABLE *st);
+EFI_STATUS ewlog_free(EFI_SYSTEM_TABLE *st);
 
 #endif	/* _EWLOG_H_ */
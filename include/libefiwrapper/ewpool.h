@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWPOOL_H_
+#define _EWPOOL_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Memory pool usage statistics of the AllocatePool boot service.
+ * Memory types above EfiMaxMemoryType are accounted together. */
+#define EFIWRAPPER_POOL_STATS_PROTOCOL_GUID				\
+	{ 0x89c62623, 0xc876, 0x48df,					\
+	  { 0xad, 0x7f, 0x15, 0x39, 0x1e, 0x56, 0xec, 0xc0 }}
+
+#define EFIWRAPPER_POOL_STATS_PROTOCOL_REVISION 0x00010000
+
+typedef struct {
+	UINT64 CurrentBytes;	/* Currently allocated, as requested */
+	UINT64 PeakBytes;	/* High-water mark of CurrentBytes */
+	UINT64 CurrentCount;	/* Number of live allocations */
+	UINT64 TotalCount;	/* Number of allocations so far */
+} EFIWRAPPER_POOL_STATS;
+
+typedef struct _EFIWRAPPER_POOL_STATS_PROTOCOL EFIWRAPPER_POOL_STATS_PROTOCOL;
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_POOL_GET_STATS)(EFIWRAPPER_POOL_STATS_PROTOCOL *This,
+				    EFI_MEMORY_TYPE MemoryType,
+				    EFIWRAPPER_POOL_STATS *Stats);
+
+typedef EFI_STATUS
+(EFIAPI *EFIWRAPPER_POOL_RESET_PEAK)(EFIWRAPPER_POOL_STATS_PROTOCOL *This);
+
+struct _EFIWRAPPER_POOL_STATS_PROTOCOL {
+	UINT32 Revision;
+	EFIWRAPPER_POOL_GET_STATS GetStats;
+	EFIWRAPPER_POOL_RESET_PEAK ResetPeak;
+};
+
+#endif	/* _EWPOOL_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWPROF_H_
+#define _EWPROF_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Boot and runtime services profiler.  The entries of the services
+ * tables are swapped with wrappers accounting the number of calls, the
+ * cumulative and maximum time of each service, globally and per caller
+ * return address.  Time is measured with the trace clock (see
+ * ewtrace_set_clock()).
+ *
+ * The profiler should be started once the drivers have installed their
+ * own services and stopped before they are released.  The report is
+ * printed on ExitBootServices() or, if it has not been, on stop.  The
+ * variadic services are not profiled. */
+EFI_STATUS ewprof_start(EFI_SYSTEM_TABLE *st);
+EFI_STATUS ewprof_stop(EFI_SYSTEM_TABLE *st);
+
+/* Print the report on the console, whatever the log level */
+void ewprof_report(void);
+
+#endif	/* _EWPROF_H_ */
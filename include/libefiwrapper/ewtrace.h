@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EWTRACE_H_
+#define _EWTRACE_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Tracing is opt-in: the events are only recorded, and the ring only
+ * saved at ExitBootServices(), if TRACE_EVENTS is defined.  Android
+ * target builds define it when EFIWRAPPER_TRACE_EVENTS is true, the
+ * host builds always do for the --trace option. */
+
+/* Number of records kept by the trace ring, a power of two */
+#ifndef EWTRACE_RING_SIZE
+#define EWTRACE_RING_SIZE	4096
+#endif
+
+typedef enum {
+	EWTRACE_BEGIN,
+	EWTRACE_END,
+	EWTRACE_INSTANT
+} ewtrace_type_t;
+
+typedef struct ewtrace_record {
+	UINT64 timestamp;	/* In ticks of the trace clock */
+	const char *name;	/* Must be a static string */
+	UINT32 arg;
+	UINT32 tid;		/* See ewtrace_set_thread_id() */
+	UINT16 type;		/* ewtrace_type_t */
+	UINT16 lap;		/* Ring lap of the record, internal */
+} ewtrace_record_t;
+
+/* Record an event.  Lock-free and callable from any context. */
+void ewtrace_add(ewtrace_type_t type, const char *name, UINT32 arg);
+
+#ifdef TRACE_EVENTS
+#define ewtrace_begin(name, arg) ewtrace_add(EWTRACE_BEGIN, name, arg)
+#define ewtrace_end(name) ewtrace_add(EWTRACE_END, name, 0)
+#define ewtrace_instant(name, arg) ewtrace_add(EWTRACE_INSTANT, name, arg)
+#else
+#define ewtrace_begin(name, arg) (void)0
+#define ewtrace_end(name) (void)0
+#define ewtrace_instant(name, arg) (void)0
+#endif
+
+/* The default clock is the TSC, of unknown frequency, on x86 and none
+ * otherwise.  The clock should be set before any event is recorded as
+ * the timestamps of the records are not converted.  FREQUENCY is in Hz,
+ * 0 if unknown. */
+void ewtrace_set_clock(UINT64 (*now)(void), UINT64 frequency);
+UINT64 ewtrace_frequency(void);
+
+/* Identify the thread or CPU recording an event.  The records are
+ * attributed to thread 0 by default. */
+void ewtrace_set_thread_id(UINT32 (*thread_id)(void));
+
+/* Current time of the trace clock, 0 if there is none */
+UINT64 ewtrace_now(void);
+
+/* Convert a duration of the trace clock to microseconds.  TICKS is
+ * returned as is if the clock frequency is unknown. */
+UINT64 ewtrace_to_us(UINT64 ticks);
+
+/* Copy the records of the ring, oldest first, to RECORDS.  Return the
+ * number of records copied, at most MAX. */
+UINTN ewtrace_snapshot(ewtrace_record_t *records, UINTN max);
+
+/* Binary dump of the ring, as saved in the EWTRACE_VARIABLE_NAME
+ * variable: a header followed by NbRecords records and the string table
+ * the records name offsets refer to. */
+#define EWTRACE_VARIABLE_GUID						\
+	{ 0x0c6e8f3b, 0x9a52, 0x4d17,					\
+	  { 0xb8, 0x2d, 0x61, 0xf4, 0x37, 0xa0, 0x95, 0xce }}
+#define EWTRACE_VARIABLE_NAME	L"EfiwrapperTrace"
+
+#define EWTRACE_DUMP_MAGIC	0x52545745	/* "EWTR" */
+#define EWTRACE_DUMP_VERSION	2
+
+typedef struct {
+	UINT32 Magic;
+	UINT16 Version;
+	UINT16 RecordSize;
+	UINT64 Frequency;
+	UINT32 NbRecords;
+	UINT32 StringsOffset;
+} __attribute__((__packed__)) EWTRACE_DUMP_HEADER;
+
+typedef struct {
+	UINT64 Timestamp;
+	UINT32 Arg;
+	UINT32 Tid;
+	UINT16 Name;		/* Offset in the string table */
+	UINT16 Type;
+} __attribute__((__packed__)) EWTRACE_DUMP_RECORD;
+
+/* Save the binary dump of the ring in a volatile variable.  Done
+ * automatically on ExitBootServices(). */
+EFI_STATUS ewtrace_save(EFI_SYSTEM_TABLE *st);
+
+EFI_STATUS ewtrace_init(EFI_SYSTEM_TABLE *st);
+EFI_STATUS ewtrace_free(EFI_SYSTEM_TABLE *st);
+
+#endif	/* _EWTRACE_H_ */
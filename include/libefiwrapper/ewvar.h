@@ -34,25 +34,32 @@
 
 #include <efi.h>
 #include <efiapi.h>
+#include <htable.h>
 
+/* Variables are indexed by a hash of (GUID, name) and linked in
+ * insertion order for GetNextVariableName().  The name and the initial
+ * data are stored in the same allocation as the ewvar_t structure. */
 typedef struct ewvar {
+	hnode_t node;		/* Must be first */
+	struct ewvar *prev;
 	struct ewvar *next;
 	CHAR16 *name;
 	EFI_GUID guid;
 	UINT32 attributes;
 	void *data;
 	UINTN size;
+	UINTN capacity;
 } ewvar_t;
 
 ewvar_t *ewvar_new(CHAR16 *name, EFI_GUID *guid, UINT32 attr,
 		     UINTN size, VOID *data);
-void ewvar_add(ewvar_t *var);
+EFI_STATUS ewvar_add(ewvar_t *var);
 
-ewvar_t *ewvar_get(const CHAR16 *name, EFI_GUID *guid, ewvar_t **prev_p);
+ewvar_t *ewvar_get(const CHAR16 *name, EFI_GUID *guid);
 ewvar_t *ewvar_get_first(void);
 EFI_STATUS ewvar_update(ewvar_t *var, UINTN size, VOID *data);
 
-EFI_STATUS ewvar_del(ewvar_t *var, ewvar_t *prev);
+EFI_STATUS ewvar_del(ewvar_t *var);
 
 void ewvar_free(ewvar_t *var);
 void ewvar_free_all(void);
@@ -61,9 +68,11 @@ typedef struct ewvar_storage {
 	EFI_STATUS (*load)(void);
 	EFI_STATUS (*save)(ewvar_t *);
 	EFI_STATUS (*delete)(ewvar_t *);
+	EFI_STATUS (*flush)(void);	/* Commit batched writes */
 } ewvar_storage_t;
 
 EFI_STATUS ewvar_register_storage(ewvar_storage_t *s);
 EFI_STATUS ewvar_unregister_storage(void);
+EFI_STATUS ewvar_flush(void);
 
 #endif	/* _EWVAR_H_ */
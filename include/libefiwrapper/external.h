@@ -34,6 +34,7 @@
 
 #include <efi.h>
 #include <efiapi.h>
+#include <stdarg.h>
 
 #ifndef EXIT_FAILURE
 #define EXIT_FAILURE 1
@@ -74,6 +75,7 @@ int strncmp(const char *s1, const char *s2, size_t n);
 /* stdio.h */
 int printf(const char *format, ...);
 int snprintf(char *str, size_t size, const char *fmt, ...);
+int vsnprintf(char *str, size_t size, const char *fmt, va_list ap);
 
 /* libpayload.h */
 void ndelay(unsigned int n);
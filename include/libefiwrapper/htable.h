@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _HTABLE_H_
+#define _HTABLE_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+#include "external.h"
+
+/* Intrusive chained hash table.  The hnode_t structure must be the
+ * first field of the hashed objects so that a node pointer can be cast
+ * back to the object it is embedded in.  The hash value is stored in
+ * the node so that the table can grow without calling back the
+ * caller. */
+typedef struct hnode {
+	struct hnode *next;
+	UINT32 hash;
+} hnode_t;
+
+typedef struct htable {
+	hnode_t **buckets;
+	size_t size;		/* Always a power of two */
+	size_t count;
+} htable_t;
+
+typedef BOOLEAN (*hmatch_t)(hnode_t *node, const void *key);
+
+#define HASH_INIT 2166136261U
+
+EFI_STATUS htable_init(htable_t *t, size_t size);
+void htable_free(htable_t *t);
+
+void htable_add(htable_t *t, hnode_t *node, UINT32 hash);
+hnode_t *htable_find(htable_t *t, UINT32 hash, hmatch_t match,
+		     const void *key);
+void htable_del(htable_t *t, hnode_t *node);
+
+UINT32 hash_buf(const void *buf, size_t size, UINT32 hash);
+UINT32 hash_ptr(const void *ptr);
+
+#endif	/* _HTABLE_H_ */
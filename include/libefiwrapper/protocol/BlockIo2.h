@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __EFI_BLOCK_IO2_PROTOCOL_H__
+#define __EFI_BLOCK_IO2_PROTOCOL_H__
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Block I/O 2 protocol as introduced in the UEFI Specification 2.3.1,
+ * for the gnu-efi versions which do not provide it. */
+#ifndef EFI_BLOCK_IO2_PROTOCOL_GUID
+#define EFI_BLOCK_IO2_PROTOCOL_GUID					\
+	{ 0xa77b2472, 0xe282, 0x4e9f,					\
+	  { 0xa2, 0x45, 0xc2, 0xc0, 0xe2, 0x7b, 0xbc, 0xc1 } }
+
+typedef struct _EFI_BLOCK_IO2_PROTOCOL EFI_BLOCK_IO2_PROTOCOL;
+
+typedef struct {
+	/* If Event is NULL, then blocking I/O is performed.  Otherwise
+	 * Event is signaled when the request is completed. */
+	EFI_EVENT Event;
+	EFI_STATUS TransactionStatus;
+} EFI_BLOCK_IO2_TOKEN;
+
+typedef EFI_STATUS
+(EFIAPI *EFI_BLOCK_RESET_EX)(EFI_BLOCK_IO2_PROTOCOL *This,
+			     BOOLEAN ExtendedVerification);
+
+typedef EFI_STATUS
+(EFIAPI *EFI_BLOCK_READ_EX)(EFI_BLOCK_IO2_PROTOCOL *This,
+			    UINT32 MediaId,
+			    EFI_LBA LBA,
+			    EFI_BLOCK_IO2_TOKEN *Token,
+			    UINTN BufferSize,
+			    VOID *Buffer);
+
+typedef EFI_STATUS
+(EFIAPI *EFI_BLOCK_WRITE_EX)(EFI_BLOCK_IO2_PROTOCOL *This,
+			     UINT32 MediaId,
+			     EFI_LBA LBA,
+			     EFI_BLOCK_IO2_TOKEN *Token,
+			     UINTN BufferSize,
+			     VOID *Buffer);
+
+typedef EFI_STATUS
+(EFIAPI *EFI_BLOCK_FLUSH_EX)(EFI_BLOCK_IO2_PROTOCOL *This,
+			     EFI_BLOCK_IO2_TOKEN *Token);
+
+struct _EFI_BLOCK_IO2_PROTOCOL {
+	EFI_BLOCK_IO_MEDIA *Media;
+	EFI_BLOCK_RESET_EX Reset;
+	EFI_BLOCK_READ_EX ReadBlocksEx;
+	EFI_BLOCK_WRITE_EX WriteBlocksEx;
+	EFI_BLOCK_FLUSH_EX FlushBlocksEx;
+};
+#endif
+
+#endif	/* __EFI_BLOCK_IO2_PROTOCOL_H__ */
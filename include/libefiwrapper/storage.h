@@ -35,6 +35,36 @@
 #include <efi.h>
 #include <efiapi.h>
 
+/* Block cache flags of a storage */
+#define STORAGE_CACHE_DISABLED		(1 << 0)
+/* Written blocks are kept in the cache instead of being invalidated */
+#define STORAGE_CACHE_WRITE_THROUGH	(1 << 1)
+/* Small writes are kept in the cache and written to the storage later,
+ * coalesced, on FlushBlocks(), ExitBootServices(), storage removal or
+ * when half of the cache is dirty */
+#define STORAGE_CACHE_WRITE_BACK	(1 << 2)
+/* No prefetching of the sequential read streams */
+#define STORAGE_READAHEAD_DISABLED	(1 << 3)
+
+/* Asynchronous request of the optional storage submit() interface */
+typedef struct storage_request {
+	BOOLEAN write;
+	EFI_LBA start;
+	EFI_LBA count;
+	void *buf;
+	/* Called by the storage poll() function once the request is
+	 * completed.  REQ must not be used afterwards. */
+	void (*done)(struct storage_request *req, EFI_STATUS status);
+} storage_request_t;
+
+/* Segment of a vectored read or write: COUNT blocks from START to or
+ * from BUF */
+typedef struct storage_segment {
+	EFI_LBA start;
+	EFI_LBA count;
+	void *buf;
+} storage_segment_t;
+
 typedef struct storage {
 	EFI_STATUS (*init)(struct storage *s);
 	EFI_LBA (*read)(struct storage *s, EFI_LBA start, EFI_LBA count,
@@ -47,6 +77,26 @@ typedef struct storage {
 	EFI_LBA blk_cnt;
 	UINT32 blk_sz;
 	void *priv;
+	UINT32 cache_flags;
+	/* Block cache size in bytes, 0 for the default size: 256 KiB on
+	 * host, no cache on target */
+	UINT32 cache_size;
+	/* Largest prefetch window in bytes, 0 for the default: the block
+	 * cache size on host, no read-ahead on target.  Two windows are
+	 * allocated on the first sequential stream. */
+	UINT32 readahead_size;
+	/* Optional asynchronous interface.  submit() starts REQ and
+	 * returns immediately, poll() calls the done function of the
+	 * completed requests.  Both must be provided. */
+	EFI_STATUS (*submit)(struct storage *s, storage_request_t *req);
+	void (*poll)(struct storage *s);
+	/* Optional vectored interface.  The NB segments are transferred
+	 * in a single device round trip (scatter-gather list, PRDT,
+	 * descriptor chain ...) and the total number of blocks
+	 * transferred is returned. */
+	EFI_LBA (*readv)(struct storage *s, storage_segment_t *segs, UINTN nb);
+	EFI_LBA (*writev)(struct storage *s, const storage_segment_t *segs,
+			  UINTN nb);
 } storage_t;
 
 enum storage_type {
@@ -81,6 +131,14 @@ EFI_STATUS storage_init(EFI_SYSTEM_TABLE *st, storage_t *storage,
 			EFI_HANDLE *handle_p);
 EFI_STATUS storage_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle);
 
+/* Vectored I/O on STORAGE.  The readv()/writev() functions of the
+ * storage are used if provided, the segments are transferred one by
+ * one otherwise.  Return the total number of blocks transferred,
+ * stopping at the first incomplete segment. */
+EFI_LBA storage_readv(storage_t *storage, storage_segment_t *segs, UINTN nb);
+EFI_LBA storage_writev(storage_t *storage, const storage_segment_t *segs,
+		       UINTN nb);
+
 EFI_STATUS identify_boot_media();
 
 boot_dev_t* get_boot_media();
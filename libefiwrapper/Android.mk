@@ -2,27 +2,41 @@ LOCAL_PATH := $(call my-dir)
 
 LIBEFIWRAPPER_SRC_FILES := \
 	ewvar.c \
+	ewvar_log.c \
 	ewdrv.c \
 	protocol.c \
 	core.c \
 	lib.c \
+	crc32.c \
 	bs.c \
 	rs.c \
 	conin.c \
 	conout.c \
+	console.c \
 	serialio.c \
 	storage.c \
 	blockio.c \
+	blockio2.c \
 	diskio.c \
 	interface.c \
 	media.c \
+	blkcache.c \
+	iostats.c \
+	readahead.c \
 	conf_table.c \
 	smbios.c \
 	ewacpi.c \
 	ewarg.c \
 	sdio.c \
 	ewlib.c \
-	eraseblk.c
+	ewlog.c \
+	ewtrace.c \
+	ewprof.c \
+	eraseblk.c \
+	htable.c \
+	pool.c \
+	event.c \
+	timer_wheel.c
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := libefiwrapper-$(TARGET_BUILD_VARIANT)
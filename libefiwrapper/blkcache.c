@@ -0,0 +1,655 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "blkcache.h"
+#include "htable.h"
+#include "interface.h"
+#include "lib.h"
+#include "media.h"
+
+#include <ewevent.h>
+#include <ewlog.h>
+
+/* Reads of more blocks than this are not cached.  They are most likely
+ * image loads which would evict the small and frequently read blocks
+ * (GPT header, partition array, vbmeta) the cache is meant for. */
+#define MAX_CACHED_READ	64
+
+/* Maximum number of blocks written by a single storage write call
+ * when the dirty blocks are flushed. */
+#define MAX_FLUSH_RUN	128
+
+/* Maximum number of segments of a vectored storage call.  Cache misses
+ * and dirty runs are gathered up to this limit so that a burst of
+ * small requests costs a single device round trip. */
+#define MAX_SEGMENTS	32
+
+typedef struct entry {
+	hnode_t node;		/* Must be first */
+	struct entry *prev;	/* LRU list, most recently used first */
+	struct entry *next;
+	EFI_LBA lba;
+	UINT8 *data;
+	BOOLEAN dirty;
+} entry_t;
+
+struct blkcache {
+	storage_t *storage;
+	htable_t index;
+	entry_t *entries;
+	UINT8 *data;
+	entry_t *mru;
+	entry_t *lru;
+	entry_t *free_entries;
+	UINTN capacity;
+	UINTN count;
+	UINTN dirty;
+	UINT32 flags;		/* STORAGE_CACHE_* flags */
+	UINT8 *flush_buf;	/* Write-back only */
+	UINTN flush_blocks;
+	EFIWRAPPER_BLOCK_CACHE_STATS stats;
+};
+
+static UINT32 lba_hash(EFI_LBA lba)
+{
+	return hash_buf(&lba, sizeof(lba), HASH_INIT);
+}
+
+static BOOLEAN match_lba(hnode_t *node, const void *key)
+{
+	return ((entry_t *)node)->lba == *(const EFI_LBA *)key;
+}
+
+static EFI_LBA max_cached_read(blkcache_t *cache)
+{
+	return max(min(cache->capacity / 4, MAX_CACHED_READ), 1);
+}
+
+static entry_t *lookup(blkcache_t *cache, EFI_LBA lba)
+{
+	return (entry_t *)htable_find(&cache->index, lba_hash(lba),
+				      match_lba, &lba);
+}
+
+static void lru_unlink(blkcache_t *cache, entry_t *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->mru = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->lru = entry->prev;
+}
+
+static void lru_push(blkcache_t *cache, entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->mru;
+	if (cache->mru)
+		cache->mru->prev = entry;
+	else
+		cache->lru = entry;
+	cache->mru = entry;
+}
+
+static void drop(blkcache_t *cache, entry_t *entry)
+{
+	if (entry->dirty) {
+		entry->dirty = FALSE;
+		cache->dirty--;
+	}
+
+	htable_del(&cache->index, &entry->node);
+	lru_unlink(cache, entry);
+	entry->next = cache->free_entries;
+	cache->free_entries = entry;
+	cache->count--;
+}
+
+/* Copy the COUNT dirty blocks starting at START to BUF and mark them
+ * clean. */
+static void gather_run(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+		       UINT8 *buf)
+{
+	UINT32 blksz = cache->storage->blk_sz;
+	entry_t *entry;
+	EFI_LBA i;
+
+	for (i = 0; i < count; i++) {
+		entry = lookup(cache, start + i);
+		memcpy(buf + i * blksz, entry->data, blksz);
+		entry->dirty = FALSE;
+	}
+	cache->dirty -= count;
+}
+
+/* Write the NB gathered runs, BLOCKS blocks in total, with a single
+ * vectored storage write.  The blocks are marked dirty again on
+ * failure. */
+static EFI_STATUS flush_runs(blkcache_t *cache, storage_segment_t *segs,
+			     UINTN nb, EFI_LBA blocks)
+{
+	entry_t *entry;
+	EFI_LBA j;
+	UINTN i;
+
+	if (storage_writev(cache->storage, segs, nb) == blocks) {
+		cache->stats.WriteBackBlocks += blocks;
+		cache->stats.WriteBackRequests++;
+		return EFI_SUCCESS;
+	}
+
+	for (i = 0; i < nb; i++)
+		for (j = 0; j < segs[i].count; j++) {
+			entry = lookup(cache, segs[i].start + j);
+			entry->dirty = TRUE;
+			cache->dirty++;
+		}
+
+	return EFI_DEVICE_ERROR;
+}
+
+static BOOLEAN is_dirty(blkcache_t *cache, EFI_LBA lba)
+{
+	entry_t *entry = lookup(cache, lba);
+
+	return entry && entry->dirty;
+}
+
+EFI_STATUS blkcache_flush(blkcache_t *cache)
+{
+	EFI_STATUS ret = EFI_SUCCESS, tmp_ret;
+	storage_segment_t segs[MAX_SEGMENTS];
+	EFI_LBA start, count, used = 0;
+	entry_t *entry;
+	UINTN nb = 0;
+
+	for (entry = cache->mru; cache->dirty && entry; entry = entry->next) {
+		if (!entry->dirty)
+			continue;
+
+		/* Adjacent dirty blocks are written as one segment */
+		for (start = entry->lba; start && is_dirty(cache, start - 1);
+		     start--)
+			;
+		for (count = 1; count < cache->flush_blocks; count++)
+			if (!is_dirty(cache, start + count))
+				break;
+
+		if (nb == MAX_SEGMENTS || used + count > cache->flush_blocks) {
+			tmp_ret = flush_runs(cache, segs, nb, used);
+			if (EFI_ERROR(tmp_ret))
+				ret = tmp_ret;
+			nb = used = 0;
+		}
+
+		segs[nb].start = start;
+		segs[nb].count = count;
+		segs[nb].buf = cache->flush_buf + used * cache->storage->blk_sz;
+		gather_run(cache, start, count, segs[nb].buf);
+		used += count;
+		nb++;
+	}
+
+	if (nb) {
+		tmp_ret = flush_runs(cache, segs, nb, used);
+		if (EFI_ERROR(tmp_ret))
+			ret = tmp_ret;
+	}
+
+	return ret;
+}
+
+/* Return the entry of block LBA, allocating it if needed, or NULL if
+ * no entry can be evicted. */
+static entry_t *get_entry(blkcache_t *cache, EFI_LBA lba)
+{
+	entry_t *entry;
+
+	entry = lookup(cache, lba);
+	if (entry) {
+		lru_unlink(cache, entry);
+		lru_push(cache, entry);
+		return entry;
+	}
+
+	if (!cache->free_entries) {
+		if (cache->lru->dirty && EFI_ERROR(blkcache_flush(cache)))
+			return NULL;
+		drop(cache, cache->lru);
+		cache->stats.Evictions++;
+	}
+
+	entry = cache->free_entries;
+	cache->free_entries = entry->next;
+	entry->lba = lba;
+	htable_add(&cache->index, &entry->node, lba_hash(lba));
+	lru_push(cache, entry);
+	cache->count++;
+
+	return entry;
+}
+
+static entry_t *insert(blkcache_t *cache, EFI_LBA lba, const void *data)
+{
+	entry_t *entry;
+
+	entry = get_entry(cache, lba);
+	if (entry)
+		memcpy(entry->data, data, cache->storage->blk_sz);
+
+	return entry;
+}
+
+blkcache_t *blkcache_new(storage_t *storage, UINTN blocks, UINT32 flags)
+{
+	EFI_STATUS ret;
+	blkcache_t *cache;
+	size_t buckets;
+	UINTN i;
+
+	if (!storage || !storage->blk_sz || !blocks)
+		return NULL;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->entries = calloc(blocks, sizeof(*cache->entries));
+	if (!cache->entries)
+		goto err;
+
+	cache->data = malloc(blocks * storage->blk_sz);
+	if (!cache->data)
+		goto err;
+
+	for (buckets = 1; buckets < blocks; buckets <<= 1)
+		;
+	ret = htable_init(&cache->index, buckets);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	if (flags & STORAGE_CACHE_WRITE_BACK) {
+		cache->flush_blocks = min(blocks, MAX_FLUSH_RUN);
+		cache->flush_buf = malloc(cache->flush_blocks *
+					  storage->blk_sz);
+		if (!cache->flush_buf) {
+			htable_free(&cache->index);
+			goto err;
+		}
+	}
+
+	for (i = blocks; i > 0; i--) {
+		cache->entries[i - 1].data = cache->data +
+			(i - 1) * storage->blk_sz;
+		cache->entries[i - 1].next = cache->free_entries;
+		cache->free_entries = &cache->entries[i - 1];
+	}
+
+	cache->storage = storage;
+	cache->capacity = blocks;
+	cache->flags = flags;
+
+	return cache;
+
+err:
+	free(cache->data);
+	free(cache->entries);
+	free(cache);
+	return NULL;
+}
+
+void blkcache_free(blkcache_t *cache)
+{
+	if (!cache)
+		return;
+
+	if (cache->dirty)
+		ewerr("Dropping %u dirty blocks", (UINT32)cache->dirty);
+
+	htable_free(&cache->index);
+	free(cache->flush_buf);
+	free(cache->data);
+	free(cache->entries);
+	free(cache);
+}
+
+/* Read the NB gathered segments, BLOCKS blocks in total, with a single
+ * vectored storage read and cache them unless they are large reads. */
+static EFI_LBA read_misses(blkcache_t *cache, storage_segment_t *segs,
+			   UINTN nb, EFI_LBA blocks)
+{
+	UINT32 blksz = cache->storage->blk_sz;
+	EFI_LBA j, done;
+	UINTN i;
+
+	done = storage_readv(cache->storage, segs, nb);
+	if (done != blocks)
+		return done;
+
+	for (i = 0; i < nb; i++) {
+		if (segs[i].count > max_cached_read(cache)) {
+			cache->stats.Bypassed += segs[i].count;
+			continue;
+		}
+
+		for (j = 0; j < segs[i].count; j++)
+			insert(cache, segs[i].start + j,
+			       (UINT8 *)segs[i].buf + j * blksz);
+		cache->stats.Misses += segs[i].count;
+	}
+
+	return done;
+}
+
+EFI_LBA blkcache_readv(blkcache_t *cache, storage_segment_t *segs, UINTN nb)
+{
+	storage_segment_t misses[MAX_SEGMENTS];
+	UINT32 blksz = cache->storage->blk_sz;
+	EFI_LBA i, run, done, total = 0, queued = 0;
+	UINTN s, nb_misses = 0;
+	entry_t *entry;
+	UINT8 *p;
+
+	/* The storage must be up to date to be read directly */
+	for (s = 0; s < nb && cache->dirty; s++)
+		if (segs[s].count > max_cached_read(cache)) {
+			if (EFI_ERROR(blkcache_flush(cache)))
+				return 0;
+			break;
+		}
+
+	for (s = 0; s < nb; s++) {
+		p = segs[s].buf;
+		for (i = 0; i < segs[s].count; i += run) {
+			if (segs[s].count > max_cached_read(cache))
+				run = segs[s].count;
+			else {
+				entry = lookup(cache, segs[s].start + i);
+				if (entry) {
+					memcpy(p + i * blksz, entry->data, blksz);
+					lru_unlink(cache, entry);
+					lru_push(cache, entry);
+					cache->stats.Hits++;
+					total++;
+					run = 1;
+					continue;
+				}
+
+				/* Read the whole run of missing blocks at once */
+				for (run = 1; i + run < segs[s].count; run++)
+					if (lookup(cache, segs[s].start + i + run))
+						break;
+			}
+
+			if (nb_misses == MAX_SEGMENTS) {
+				done = read_misses(cache, misses, nb_misses,
+						   queued);
+				total += done;
+				if (done != queued)
+					return total;
+				nb_misses = queued = 0;
+			}
+
+			misses[nb_misses].start = segs[s].start + i;
+			misses[nb_misses].count = run;
+			misses[nb_misses].buf = p + i * blksz;
+			nb_misses++;
+			queued += run;
+		}
+	}
+
+	if (nb_misses)
+		total += read_misses(cache, misses, nb_misses, queued);
+
+	return total;
+}
+
+EFI_LBA blkcache_read(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+		      void *buf)
+{
+	storage_segment_t seg = {
+		.start = start,
+		.count = count,
+		.buf = buf
+	};
+
+	return blkcache_readv(cache, &seg, 1);
+}
+
+/* Keep the COUNT blocks of BUF in the cache as dirty blocks.  Return
+ * the number of blocks kept. */
+static EFI_LBA write_back(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+			  const UINT8 *buf)
+{
+	EFI_STATUS ret;
+	entry_t *entry;
+	EFI_LBA i;
+
+	for (i = 0; i < count; i++) {
+		entry = insert(cache, start + i,
+			       buf + i * cache->storage->blk_sz);
+		if (!entry)
+			break;
+		if (!entry->dirty) {
+			entry->dirty = TRUE;
+			cache->dirty++;
+		}
+	}
+
+	if (cache->dirty > cache->capacity / 2) {
+		ret = blkcache_flush(cache);
+		if (EFI_ERROR(ret))
+			ewerr("Block cache flush failed: %x", (UINT32)ret);
+	}
+
+	return i;
+}
+
+EFI_LBA blkcache_write(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+		       const void *buf)
+{
+	storage_t *storage = cache->storage;
+	const UINT8 *p = buf;
+	EFI_LBA i, done = 0;
+
+	if (count <= max_cached_read(cache)) {
+		if (cache->flags & STORAGE_CACHE_WRITE_BACK)
+			done = write_back(cache, start, count, p);
+
+		if (done == count)
+			return done;
+	}
+
+	/* Blocks which could not be kept dirty are written to the
+	 * storage and the previous content of the range is dropped */
+	blkcache_invalidate(cache, start + done, count - done);
+	p += done * storage->blk_sz;
+	count = storage->write(storage, start + done, count - done, p);
+
+	if (cache->flags & STORAGE_CACHE_WRITE_THROUGH &&
+	    count <= max_cached_read(cache))
+		for (i = 0; i < count; i++)
+			insert(cache, start + done + i,
+			       p + i * storage->blk_sz);
+
+	return done + count;
+}
+
+void blkcache_invalidate(blkcache_t *cache, EFI_LBA start, EFI_LBA count)
+{
+	entry_t *entry, *next;
+	EFI_LBA i;
+
+	if (count > cache->count) {
+		for (entry = cache->mru; entry; entry = next) {
+			next = entry->next;
+			if (entry->lba >= start && entry->lba - start < count) {
+				drop(cache, entry);
+				cache->stats.Invalidations++;
+			}
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		entry = lookup(cache, start + i);
+		if (entry) {
+			drop(cache, entry);
+			cache->stats.Invalidations++;
+		}
+	}
+}
+
+void blkcache_get_stats(blkcache_t *cache,
+			EFIWRAPPER_BLOCK_CACHE_STATS *stats)
+{
+	memcpy(stats, &cache->stats, sizeof(*stats));
+	stats->CachedBlocks = cache->count;
+	stats->CapacityBlocks = cache->capacity;
+	stats->DirtyBlocks = cache->dirty;
+	stats->WriteThrough = !!(cache->flags & STORAGE_CACHE_WRITE_THROUGH);
+	stats->WriteBack = !!(cache->flags & STORAGE_CACHE_WRITE_BACK);
+}
+
+void blkcache_reset_stats(blkcache_t *cache)
+{
+	memset(&cache->stats, 0, sizeof(cache->stats));
+}
+
+typedef struct blkcache_protocol {
+	EFIWRAPPER_BLOCK_CACHE_PROTOCOL interface;
+	blkcache_t *cache;
+	EFI_EVENT exit_bs_event;
+} blkcache_protocol_t;
+
+static EFIAPI VOID
+blkcache_exit_bs(__attribute__((__unused__)) EFI_EVENT Event, VOID *Context)
+{
+	EFI_STATUS ret;
+
+	ret = blkcache_flush(Context);
+	if (EFI_ERROR(ret))
+		ewerr("Block cache flush failed: %x", (UINT32)ret);
+}
+
+static EFIAPI EFI_STATUS
+blkcache_protocol_get_stats(EFIWRAPPER_BLOCK_CACHE_PROTOCOL *This,
+			    EFIWRAPPER_BLOCK_CACHE_STATS *Stats)
+{
+	if (!This || !Stats)
+		return EFI_INVALID_PARAMETER;
+
+	blkcache_get_stats(((blkcache_protocol_t *)This)->cache, Stats);
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+blkcache_protocol_reset_stats(EFIWRAPPER_BLOCK_CACHE_PROTOCOL *This)
+{
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	blkcache_reset_stats(((blkcache_protocol_t *)This)->cache);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_GUID blkcache_guid = EFIWRAPPER_BLOCK_CACHE_PROTOCOL_GUID;
+
+EFI_STATUS blkcache_register(EFI_SYSTEM_TABLE *st, struct media *media,
+			     EFI_HANDLE *handle)
+{
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+	static blkcache_protocol_t blkcache_protocol_default = {
+		.interface = {
+			.Revision = EFIWRAPPER_BLOCK_CACHE_PROTOCOL_REVISION,
+			.GetStats = blkcache_protocol_get_stats,
+			.ResetStats = blkcache_protocol_reset_stats
+		}
+	};
+	EFI_STATUS ret;
+	blkcache_protocol_t *protocol;
+
+	if (!media->cache)
+		return EFI_SUCCESS;
+
+	ret = interface_init(st, &blkcache_guid, handle,
+			     &blkcache_protocol_default,
+			     sizeof(blkcache_protocol_default),
+			     (void **)&protocol);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	protocol->cache = media->cache;
+
+	if (!(media->cache->flags & STORAGE_CACHE_WRITE_BACK))
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(st->BootServices->CreateEventEx, 6,
+				EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				blkcache_exit_bs, media->cache,
+				&exit_bs_group, &protocol->exit_bs_event);
+	if (EFI_ERROR(ret))
+		interface_free(st, &blkcache_guid, *handle);
+
+	return ret;
+}
+
+EFI_STATUS blkcache_unregister(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
+{
+	EFI_STATUS ret;
+	blkcache_protocol_t *protocol;
+
+	ret = uefi_call_wrapper(st->BootServices->HandleProtocol, 3,
+				handle, &blkcache_guid, (VOID **)&protocol);
+	/* The storage has no block cache */
+	if (ret == EFI_UNSUPPORTED)
+		return EFI_SUCCESS;
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = blkcache_flush(protocol->cache);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	if (protocol->exit_bs_event) {
+		ret = uefi_call_wrapper(st->BootServices->CloseEvent, 1,
+					protocol->exit_bs_event);
+		if (EFI_ERROR(ret))
+			return ret;
+		protocol->exit_bs_event = NULL;
+	}
+
+	return interface_free(st, &blkcache_guid, handle);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BLKCACHE_H_
+#define _BLKCACHE_H_
+
+#include <efi.h>
+#include <efiapi.h>
+#include <ewblkcache.h>
+#include <storage.h>
+
+typedef struct blkcache blkcache_t;
+struct media;
+
+/* FLAGS is a combination of STORAGE_CACHE_* flags */
+blkcache_t *blkcache_new(storage_t *storage, UINTN blocks, UINT32 flags);
+void blkcache_free(blkcache_t *cache);
+
+EFI_LBA blkcache_read(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+		      void *buf);
+/* Read the NB segments of SEGS, the cache misses of all the segments
+ * being read with a single vectored storage read. */
+EFI_LBA blkcache_readv(blkcache_t *cache, storage_segment_t *segs, UINTN nb);
+EFI_LBA blkcache_write(blkcache_t *cache, EFI_LBA start, EFI_LBA count,
+		       const void *buf);
+void blkcache_invalidate(blkcache_t *cache, EFI_LBA start, EFI_LBA count);
+EFI_STATUS blkcache_flush(blkcache_t *cache);
+
+void blkcache_get_stats(blkcache_t *cache,
+			EFIWRAPPER_BLOCK_CACHE_STATS *stats);
+void blkcache_reset_stats(blkcache_t *cache);
+
+EFI_STATUS blkcache_register(EFI_SYSTEM_TABLE *st, struct media *media,
+			     EFI_HANDLE *handle);
+EFI_STATUS blkcache_unregister(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle);
+
+#endif	/* _BLKCACHE_H_ */
@@ -34,6 +34,7 @@
 #include "interface.h"
 
 #include <efilib.h>
+#include <ewtrace.h>
 
 static EFIAPI EFI_STATUS
 blockio_reset(__attribute__((__unused__)) EFI_BLOCK_IO *This,
@@ -70,9 +71,9 @@ static EFI_STATUS blockio_access(BOOLEAN read, EFI_BLOCK_IO *This,
 
 	size = BufferSize / blksz;
 	if (read)
-		count = media->storage->read(media->storage, LBA, size, Buffer);
+		count = media_read(media, LBA, size, Buffer);
 	else
-		count = media->storage->write(media->storage, LBA, size, Buffer);
+		count = media_write(media, LBA, size, Buffer);
 
 	return count == size ? EFI_SUCCESS : EFI_DEVICE_ERROR;
 }
@@ -81,20 +82,44 @@ static EFIAPI EFI_STATUS
 blockio_write(EFI_BLOCK_IO *This, UINT32 MediaId, EFI_LBA LBA,
 	      UINTN BufferSize, VOID *Buffer)
 {
-	return blockio_access(FALSE, This, MediaId, LBA, BufferSize, Buffer);
+	EFI_STATUS ret;
+
+	ewtrace_begin("BlockIo.WriteBlocks", BufferSize);
+	ret = blockio_access(FALSE, This, MediaId, LBA, BufferSize, Buffer);
+	ewtrace_end("BlockIo.WriteBlocks");
+
+	return ret;
 }
 
 static EFIAPI EFI_STATUS
 blockio_read(EFI_BLOCK_IO *This, UINT32 MediaId, EFI_LBA LBA,
 	     UINTN BufferSize, VOID *Buffer)
 {
-	return blockio_access(TRUE, This, MediaId, LBA, BufferSize, Buffer);
+	EFI_STATUS ret;
+
+	ewtrace_begin("BlockIo.ReadBlocks", BufferSize);
+	ret = blockio_access(TRUE, This, MediaId, LBA, BufferSize, Buffer);
+	ewtrace_end("BlockIo.ReadBlocks");
+
+	return ret;
 }
 
 static EFIAPI EFI_STATUS
-blockio_flush(__attribute__((__unused__)) EFI_BLOCK_IO *This)
+blockio_flush(EFI_BLOCK_IO *This)
 {
-	return EFI_SUCCESS;
+	EFI_STATUS ret;
+
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	if (!This->Media)
+		return EFI_NO_MEDIA;
+
+	ewtrace_begin("BlockIo.FlushBlocks", 0);
+	ret = media_flush((media_t *)This->Media);
+	ewtrace_end("BlockIo.FlushBlocks");
+
+	return ret;
 }
 
 static EFI_GUID blockio_guid = BLOCK_IO_PROTOCOL;
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewlog.h>
+#include <ewtrace.h>
+#include <protocol/BlockIo2.h>
+
+#include "blockio2.h"
+#include "event.h"
+#include "external.h"
+#include "interface.h"
+#include "iostats.h"
+
+#define POLL_PERIOD	10000	/* 1 ms in 100 ns unit */
+
+typedef struct blockio2 {
+	EFI_BLOCK_IO2_PROTOCOL interface;
+	media_t *media;
+	EFI_BOOT_SERVICES *bs;
+	EFI_EVENT poll_event;
+	BOOLEAN poll_timer;	/* poll_event is an armed periodic timer */
+	UINTN inflight;
+} blockio2_t;
+
+typedef struct request {
+	storage_request_t req;	/* Must be first */
+	blockio2_t *blockio2;
+	EFI_BLOCK_IO2_TOKEN *token;
+	UINT64 time;		/* Submission time */
+} request_t;
+
+static void complete(blockio2_t *blockio2, EFI_BLOCK_IO2_TOKEN *token,
+		     EFI_STATUS status)
+{
+	token->TransactionStatus = status;
+	uefi_call_wrapper(blockio2->bs->SignalEvent, 1, token->Event);
+}
+
+static void blockio2_poll(blockio2_t *blockio2)
+{
+	storage_t *storage = blockio2->media->storage;
+
+	storage->poll(storage);
+
+	if (!blockio2->inflight && blockio2->poll_timer) {
+		uefi_call_wrapper(blockio2->bs->SetTimer, 3,
+				  blockio2->poll_event, TimerCancel, 0);
+		blockio2->poll_timer = FALSE;
+	}
+}
+
+static EFIAPI VOID poll_notify(__attribute__((__unused__)) EFI_EVENT Event,
+			       VOID *Context)
+{
+	blockio2_poll(Context);
+}
+
+/* Wait for the completion of all the in-flight requests */
+static void drain(blockio2_t *blockio2)
+{
+	for (;;) {
+		blockio2_poll(blockio2);
+		if (!blockio2->inflight)
+			return;
+		event_sleep(POLL_PERIOD);
+	}
+}
+
+static void request_done(storage_request_t *req, EFI_STATUS status)
+{
+	request_t *request = (request_t *)req;
+	blockio2_t *blockio2 = request->blockio2;
+
+	/* Drop what a synchronous read of the same blocks may have
+	 * cached while the write was in flight */
+	if (req->write)
+		media_sync(blockio2->media, TRUE, req->start, req->count);
+
+	blockio2->inflight--;
+	iostats_account(&blockio2->media->stats,
+			req->write ? EfiwrapperIoWrite : EfiwrapperIoRead,
+			req->count * blockio2->media->m.BlockSize,
+			request->time, status);
+	complete(blockio2, request->token, status);
+	free(request);
+}
+
+static EFI_STATUS submit(blockio2_t *blockio2, BOOLEAN write, EFI_LBA lba,
+			 EFI_LBA count, EFI_BLOCK_IO2_TOKEN *token,
+			 VOID *buffer)
+{
+	storage_t *storage = blockio2->media->storage;
+	request_t *request;
+	EFI_STATUS ret;
+
+	/* The storage is about to be accessed behind the block cache */
+	ret = media_sync(blockio2->media, write, lba, count);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	request = calloc(1, sizeof(*request));
+	if (!request)
+		return EFI_OUT_OF_RESOURCES;
+
+	request->req.write = write;
+	request->req.start = lba;
+	request->req.count = count;
+	request->req.buf = buffer;
+	request->req.done = request_done;
+	request->blockio2 = blockio2;
+	request->token = token;
+	request->time = iostats_start();
+
+	ret = storage->submit(storage, &request->req);
+	if (EFI_ERROR(ret)) {
+		free(request);
+		return ret;
+	}
+	blockio2->inflight++;
+
+	if (!blockio2->poll_timer) {
+		ret = uefi_call_wrapper(blockio2->bs->SetTimer, 3,
+					blockio2->poll_event, TimerPeriodic,
+					POLL_PERIOD);
+		blockio2->poll_timer = !EFI_ERROR(ret);
+	}
+
+	/* Without timer support the request completes synchronously */
+	if (!blockio2->poll_timer)
+		drain(blockio2);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS blockio2_access(BOOLEAN write, EFI_BLOCK_IO2_PROTOCOL *This,
+				  UINT32 MediaId, EFI_LBA LBA,
+				  EFI_BLOCK_IO2_TOKEN *Token,
+				  UINTN BufferSize, VOID *Buffer)
+{
+	blockio2_t *blockio2 = (blockio2_t *)This;
+	EFI_STATUS ret;
+	media_t *media;
+	UINT32 blksz;
+	EFI_LBA count;
+
+	if (!This || !Buffer)
+		return EFI_INVALID_PARAMETER;
+
+	media = blockio2->media;
+	if (MediaId != media->m.MediaId)
+		return EFI_MEDIA_CHANGED;
+
+	blksz = media->m.BlockSize;
+	if (!blksz)
+		return EFI_INVALID_PARAMETER;
+
+	if (BufferSize % blksz)
+		return EFI_BAD_BUFFER_SIZE;
+
+	count = BufferSize / blksz;
+	if (LBA > media->m.LastBlock || count > media->m.LastBlock - LBA + 1)
+		return EFI_INVALID_PARAMETER;
+
+	if (count && Token && Token->Event && media->storage->submit)
+		return submit(blockio2, write, LBA, count, Token, Buffer);
+
+	if (!count)
+		ret = EFI_SUCCESS;
+	else if (write)
+		ret = media_write(media, LBA, count, Buffer) == count ?
+			EFI_SUCCESS : EFI_DEVICE_ERROR;
+	else
+		ret = media_read(media, LBA, count, Buffer) == count ?
+			EFI_SUCCESS : EFI_DEVICE_ERROR;
+
+	if (!Token || !Token->Event)
+		return ret;
+
+	complete(blockio2, Token, ret);
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+blockio2_reset(__attribute__((__unused__)) EFI_BLOCK_IO2_PROTOCOL *This,
+	       __attribute__((__unused__)) BOOLEAN ExtendedVerification)
+{
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+blockio2_read(EFI_BLOCK_IO2_PROTOCOL *This, UINT32 MediaId, EFI_LBA LBA,
+	      EFI_BLOCK_IO2_TOKEN *Token, UINTN BufferSize, VOID *Buffer)
+{
+	EFI_STATUS ret;
+
+	ewtrace_begin("BlockIo2.ReadBlocksEx", BufferSize);
+	ret = blockio2_access(FALSE, This, MediaId, LBA, Token,
+			      BufferSize, Buffer);
+	ewtrace_end("BlockIo2.ReadBlocksEx");
+
+	return ret;
+}
+
+static EFIAPI EFI_STATUS
+blockio2_write(EFI_BLOCK_IO2_PROTOCOL *This, UINT32 MediaId, EFI_LBA LBA,
+	       EFI_BLOCK_IO2_TOKEN *Token, UINTN BufferSize, VOID *Buffer)
+{
+	EFI_STATUS ret;
+
+	ewtrace_begin("BlockIo2.WriteBlocksEx", BufferSize);
+	ret = blockio2_access(TRUE, This, MediaId, LBA, Token,
+			      BufferSize, Buffer);
+	ewtrace_end("BlockIo2.WriteBlocksEx");
+
+	return ret;
+}
+
+static EFIAPI EFI_STATUS
+blockio2_flush(EFI_BLOCK_IO2_PROTOCOL *This, EFI_BLOCK_IO2_TOKEN *Token)
+{
+	blockio2_t *blockio2 = (blockio2_t *)This;
+	EFI_STATUS ret;
+
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	ewtrace_begin("BlockIo2.FlushBlocksEx", 0);
+	drain(blockio2);
+	ret = media_flush(blockio2->media);
+	ewtrace_end("BlockIo2.FlushBlocksEx");
+
+	if (!Token || !Token->Event)
+		return ret;
+
+	complete(blockio2, Token, ret);
+	return EFI_SUCCESS;
+}
+
+static EFI_GUID blockio2_guid = EFI_BLOCK_IO2_PROTOCOL_GUID;
+
+EFI_STATUS blockio2_init(EFI_SYSTEM_TABLE *st, media_t *media,
+			 EFI_HANDLE *handle)
+{
+	static blockio2_t blockio2_default = {
+		.interface = {
+			.Reset = blockio2_reset,
+			.ReadBlocksEx = blockio2_read,
+			.WriteBlocksEx = blockio2_write,
+			.FlushBlocksEx = blockio2_flush
+		}
+	};
+	EFI_STATUS ret;
+	blockio2_t *blockio2;
+
+	ret = interface_init(st, &blockio2_guid, handle,
+			     &blockio2_default, sizeof(blockio2_default),
+			     (void **)&blockio2);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	blockio2->interface.Media = &media->m;
+	blockio2->media = media;
+	blockio2->bs = st->BootServices;
+
+	if (!media->storage->submit)
+		return EFI_SUCCESS;
+
+	if (!media->storage->poll) {
+		ewerr("Storage asynchronous interface without poll function");
+		ret = EFI_INVALID_PARAMETER;
+		goto err;
+	}
+
+	ret = uefi_call_wrapper(st->BootServices->CreateEvent, 5,
+				EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				poll_notify, blockio2,
+				&blockio2->poll_event);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	return EFI_SUCCESS;
+
+err:
+	interface_free(st, &blockio2_guid, *handle);
+	return ret;
+}
+
+EFI_STATUS blockio2_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
+{
+	EFI_STATUS ret;
+	blockio2_t *blockio2;
+
+	ret = uefi_call_wrapper(st->BootServices->HandleProtocol, 3,
+				handle, &blockio2_guid, (VOID **)&blockio2);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	if (blockio2->poll_event) {
+		drain(blockio2);
+		ret = uefi_call_wrapper(st->BootServices->CloseEvent, 1,
+					blockio2->poll_event);
+		if (EFI_ERROR(ret))
+			return ret;
+		blockio2->poll_event = NULL;
+	}
+
+	return interface_free(st, &blockio2_guid, handle);
+}
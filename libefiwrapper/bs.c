@@ -29,21 +29,14 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ewevent.h>
+
 #include "bs.h"
+#include "event.h"
 #include "lib.h"
+#include "pool.h"
 #include "protocol.h"
 
-static EFIAPI EFI_TPL
-bs_raise_TPL(__attribute__((__unused__)) EFI_TPL NewTpl)
-{
-	return 0;
-}
-
-static EFIAPI VOID
-bs_restore_TPL(__attribute__((__unused__)) EFI_TPL OldTpl)
-{
-}
-
 static EFIAPI EFI_STATUS
 bs_allocate_pages(__attribute__((__unused__)) EFI_ALLOCATE_TYPE Type,
 		  __attribute__((__unused__)) EFI_MEMORY_TYPE MemoryType,
@@ -71,104 +64,15 @@ bs_get_memory_map(__attribute__((__unused__)) UINTN *MemoryMapSize,
 }
 
 static EFIAPI EFI_STATUS
-bs_allocate_pool(__attribute__((__unused__)) EFI_MEMORY_TYPE PoolType,
-		 UINTN Size, VOID **Buffer)
+bs_allocate_pool(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer)
 {
-	void *buf;
-
-	buf = malloc(Size);
-	if (!buf)
-		return EFI_OUT_OF_RESOURCES;
-
-	*Buffer = buf;
-
-	return EFI_SUCCESS;
+	return pool_alloc(PoolType, Size, Buffer);
 }
 
 static EFIAPI EFI_STATUS
 bs_free_pool(VOID *Buffer)
 {
-	free(Buffer);
-	return EFI_SUCCESS;
-}
-
-typedef struct event {
-	UINT32 type;
-	EFI_TPL tpl;
-	EFI_EVENT_NOTIFY notify;
-	VOID *context;
-} event_t;
-
-static EFIAPI EFI_STATUS
-bs_create_event(UINT32 Type,
-		EFI_TPL NotifyTpl,
-		EFI_EVENT_NOTIFY NotifyFunction,
-		VOID *NotifyContext,
-		EFI_EVENT *Event)
-{
-	event_t *event;
-
-	if (!Event ||
-	    (Type & EVT_NOTIFY_SIGNAL && Type & EVT_NOTIFY_WAIT) ||
-	    (!NotifyFunction && (Type & EVT_NOTIFY_SIGNAL || Type & EVT_NOTIFY_WAIT)))
-		return EFI_INVALID_PARAMETER;
-
-	event = malloc(sizeof(*event));
-	if (!event)
-		return EFI_OUT_OF_RESOURCES;
-
-	event->type = Type;
-	event->tpl = NotifyTpl;
-	event->notify = NotifyFunction;
-	event->context = NotifyContext;
-	*Event = event;
-
-	return EFI_SUCCESS;
-}
-
-static EFIAPI EFI_STATUS
-bs_set_timer(__attribute__((__unused__)) EFI_EVENT Event,
-	     __attribute__((__unused__)) EFI_TIMER_DELAY Type,
-	     __attribute__((__unused__)) UINT64 TriggerTime)
-{
-	return EFI_UNSUPPORTED;
-}
-
-static EFIAPI EFI_STATUS
-bs_wait_for_event(__attribute__((__unused__)) UINTN NumberOfEvents,
-		  __attribute__((__unused__)) EFI_EVENT *Event,
-		  __attribute__((__unused__)) UINTN *Index)
-{
-	return EFI_UNSUPPORTED;
-}
-
-static EFIAPI EFI_STATUS
-bs_signal_event(EFI_EVENT Event)
-{
-	event_t *event = (event_t *)Event;
-
-	if (!Event)
-		return EFI_INVALID_PARAMETER;
-
-	if (event->type != EVT_NOTIFY_SIGNAL)
-		return EFI_SUCCESS;
-
-	event->notify(Event, event->context);
-
-	return EFI_SUCCESS;
-}
-
-static EFIAPI EFI_STATUS
-bs_close_event(EFI_EVENT Event)
-{
-	free(Event);
-	return EFI_SUCCESS;
-}
-
-static EFIAPI EFI_STATUS
-bs_check_event(__attribute__((__unused__)) EFI_EVENT Event)
-{
-	return EFI_UNSUPPORTED;
+	return pool_release(Buffer);
 }
 
 static EFIAPI EFI_STATUS
@@ -179,14 +83,6 @@ bs_PC_handle_protocol(__attribute__((__unused__)) EFI_HANDLE Handle,
 	return EFI_UNSUPPORTED;
 }
 
-static EFIAPI EFI_STATUS
-bs_register_protocol_notify(__attribute__((__unused__)) EFI_GUID *Protocol,
-			    __attribute__((__unused__)) EFI_EVENT Event,
-			    __attribute__((__unused__)) VOID **Registration)
-{
-	return EFI_UNSUPPORTED;
-}
-
 static EFIAPI EFI_STATUS
 bs_install_configuration_table(__attribute__((__unused__)) EFI_GUID *Guid,
 			       __attribute__((__unused__)) VOID *Table)
@@ -232,7 +128,9 @@ static EFIAPI EFI_STATUS
 bs_exit_boot_services(__attribute__((__unused__)) EFI_HANDLE ImageHandle,
 		      __attribute__((__unused__)) UINTN MapKey)
 {
-	return EFI_SUCCESS;
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+
+	return event_signal_group(&exit_bs_group);
 }
 
 static EFIAPI EFI_STATUS
@@ -320,17 +218,6 @@ bs_set_mem(VOID *Buffer,
 	memset(Buffer, Value, Size);
 }
 
-static EFIAPI EFI_STATUS
-bs_create_event_ex(__attribute__((__unused__)) UINT32 Type,
-		   __attribute__((__unused__)) EFI_TPL NotifyTpl,
-		   __attribute__((__unused__)) EFI_EVENT_NOTIFY NotifyFunction,
-		   __attribute__((__unused__)) const VOID *NotifyContext,
-		   __attribute__((__unused__)) const EFI_GUID *EventGroup,
-		   __attribute__((__unused__)) EFI_EVENT *Event)
-{
-	return EFI_UNSUPPORTED;
-}
-
 static EFI_BOOT_SERVICES boot_services_default = {
 	.Hdr = {
 		.Signature = EFI_BOOT_SERVICES_SIGNATURE,
@@ -338,21 +225,12 @@ static EFI_BOOT_SERVICES boot_services_default = {
 		.HeaderSize = sizeof(EFI_TABLE_HEADER)
 	},
 
-	.RaiseTPL = bs_raise_TPL,
-	.RestoreTPL = bs_restore_TPL,
 	.AllocatePages = bs_allocate_pages,
 	.FreePages = bs_free_pages,
 	.GetMemoryMap = bs_get_memory_map,
 	.AllocatePool = bs_allocate_pool,
 	.FreePool = bs_free_pool,
-	.CreateEvent = bs_create_event,
-	.SetTimer = bs_set_timer,
-	.WaitForEvent = bs_wait_for_event,
-	.SignalEvent = bs_signal_event,
-	.CloseEvent = bs_close_event,
-	.CheckEvent = bs_check_event,
 	.PCHandleProtocol = bs_PC_handle_protocol,
-	.RegisterProtocolNotify = bs_register_protocol_notify,
 	.InstallConfigurationTable = bs_install_configuration_table,
 	.LoadImage = bs_load_image,
 	.StartImage = bs_start_image,
@@ -369,8 +247,7 @@ static EFI_BOOT_SERVICES boot_services_default = {
 	.UninstallMultipleProtocolInterfaces = bs_uninstall_multiple_protocol_interfaces,
 	.CalculateCrc32 = bs_calculate_crc32,
 	.CopyMem = bs_copy_mem,
-	.SetMem = bs_set_mem,
-	.CreateEventEx = bs_create_event_ex
+	.SetMem = bs_set_mem
 };
 
 EFI_STATUS bs_init(EFI_SYSTEM_TABLE *st)
@@ -388,5 +265,9 @@ EFI_STATUS bs_init(EFI_SYSTEM_TABLE *st)
 	if (EFI_ERROR(ret))
 		return ret;
 
+	ret = event_init_bs(bs);
+	if (EFI_ERROR(ret))
+		return ret;
+
 	return crc32((void *)bs, sizeof(*bs), &bs->Hdr.CRC32);
 }
@@ -29,10 +29,65 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "console.h"
 #include "conout.h"
+#include "event.h"
 #include "interface.h"
 #include "lib.h"
 
+static const struct {
+	UINTN columns;
+	UINTN rows;
+} MODES[] = {
+	{ 80, 25 },
+	{ 80, 50 }
+};
+
+static SIMPLE_TEXT_OUTPUT_MODE mode = {
+	.MaxMode = ARRAY_SIZE(MODES),
+	.CursorVisible = TRUE
+};
+
+static void cursor_advance(UINT32 c)
+{
+	UINTN columns = MODES[mode.Mode].columns;
+	UINTN rows = MODES[mode.Mode].rows;
+
+	switch (c) {
+	case '\n':
+		if ((UINTN)mode.CursorRow < rows - 1)
+			mode.CursorRow++;
+		break;
+	case '\r':
+		mode.CursorColumn = 0;
+		break;
+	case '\b':
+		if (mode.CursorColumn)
+			mode.CursorColumn--;
+		break;
+	default:
+		if (c < ' ')
+			break;
+		if ((UINTN)++mode.CursorColumn == columns) {
+			mode.CursorColumn = 0;
+			if ((UINTN)mode.CursorRow < rows - 1)
+				mode.CursorRow++;
+		}
+	}
+}
+
+static void clear_screen(void)
+{
+	static const char CLEAR[] = "\033[2J\033[H";
+
+	event_lock();
+	console_write(CLEAR, sizeof(CLEAR) - 1);
+	console_flush();
+	mode.CursorColumn = 0;
+	mode.CursorRow = 0;
+	event_unlock();
+}
+
 static EFIAPI EFI_STATUS
 conout_reset(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
 	     __attribute__((__unused__)) BOOLEAN ExtendedVerification)
@@ -44,8 +99,27 @@ static EFIAPI EFI_STATUS
 conout_output_string(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
 		     CHAR16 *String)
 {
-	while (*String)
-		printf("%c", *String++);
+	UINT32 cp;
+
+	if (!String)
+		return EFI_INVALID_PARAMETER;
+
+	event_lock();
+	for (; *String; String++) {
+		cp = *String;
+		if (cp >= 0xd800 && cp <= 0xdbff &&
+		    String[1] >= 0xdc00 && String[1] <= 0xdfff) {
+			cp = 0x10000 + ((cp - 0xd800) << 10) +
+				(*++String - 0xdc00);
+		} else if (cp >= 0xd800 && cp <= 0xdfff)
+			cp = 0xfffd;
+
+		console_write_utf8(cp);
+		cursor_advance(cp);
+	}
+
+	console_flush();
+	event_unlock();
 
 	return EFI_SUCCESS;
 }
@@ -59,18 +133,31 @@ conout_test_string(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERF
 
 static EFIAPI EFI_STATUS
 conout_query_mode(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
-		  __attribute__((__unused__)) UINTN ModeNumber,
-		  __attribute__((__unused__)) UINTN *Columns,
-		  __attribute__((__unused__)) UINTN *Rows)
+		  UINTN ModeNumber, UINTN *Columns, UINTN *Rows)
 {
-	return EFI_UNSUPPORTED;
+	if (!Columns || !Rows)
+		return EFI_INVALID_PARAMETER;
+
+	if (ModeNumber >= ARRAY_SIZE(MODES))
+		return EFI_UNSUPPORTED;
+
+	*Columns = MODES[ModeNumber].columns;
+	*Rows = MODES[ModeNumber].rows;
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
 conout_set_mode(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
-		__attribute__((__unused__)) UINTN ModeNumber)
+		UINTN ModeNumber)
 {
-	return EFI_UNSUPPORTED;
+	if (ModeNumber >= ARRAY_SIZE(MODES))
+		return EFI_UNSUPPORTED;
+
+	mode.Mode = ModeNumber;
+	clear_screen();
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -83,15 +170,31 @@ conout_set_attribute(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTE
 static EFIAPI EFI_STATUS
 conout_clear_screen(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This)
 {
-	return EFI_UNSUPPORTED;
+	clear_screen();
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
 conout_set_cursor_position(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
-			   __attribute__((__unused__)) UINTN Column,
-			   __attribute__((__unused__)) UINTN Row)
+			   UINTN Column, UINTN Row)
 {
-	return EFI_UNSUPPORTED;
+	char seq[32];
+	int len;
+
+	if (Column >= MODES[mode.Mode].columns ||
+	    Row >= MODES[mode.Mode].rows)
+		return EFI_UNSUPPORTED;
+
+	len = snprintf(seq, sizeof(seq), "\033[%d;%dH",
+		       (int)Row + 1, (int)Column + 1);
+	event_lock();
+	console_write(seq, len);
+	console_flush();
+	mode.CursorColumn = Column;
+	mode.CursorRow = Row;
+	event_unlock();
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -101,8 +204,6 @@ conout_enable_cursor(__attribute__((__unused__)) struct _SIMPLE_TEXT_OUTPUT_INTE
 	return EFI_UNSUPPORTED;
 }
 
-static SIMPLE_TEXT_OUTPUT_MODE mode;
-
 static EFI_GUID conout_guid = SIMPLE_TEXT_OUTPUT_PROTOCOL;
 
 EFI_STATUS conout_init(EFI_SYSTEM_TABLE *st)
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "console.h"
+#include "external.h"
+
+#define BUFFER_SIZE	512
+
+static char buffer[BUFFER_SIZE];
+static UINTN used;
+
+void console_flush(void)
+{
+	UINTN i, len;
+
+	/* printf() stops on the NUL characters */
+	for (i = 0; i < used; i += len + 1) {
+		for (len = 0; i + len < used && buffer[i + len]; len++)
+			;
+		if (len)
+			printf("%.*s", (int)len, &buffer[i]);
+		if (i + len < used)
+			printf("%c", '\0');
+	}
+
+	used = 0;
+}
+
+void console_write(const void *buf, UINTN len)
+{
+	const char *p = (const char *)buf;
+	UINTN i;
+
+	for (i = 0; i < len; i++) {
+		buffer[used++] = p[i];
+		if (p[i] == '\n' || used == sizeof(buffer))
+			console_flush();
+	}
+}
+
+void console_write_utf8(UINT32 cp)
+{
+	char seq[4];
+	UINTN len;
+
+	if (cp < 0x80) {
+		seq[0] = cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		seq[0] = 0xc0 | (cp >> 6);
+		seq[1] = 0x80 | (cp & 0x3f);
+		len = 2;
+	} else if (cp < 0x10000) {
+		seq[0] = 0xe0 | (cp >> 12);
+		seq[1] = 0x80 | ((cp >> 6) & 0x3f);
+		seq[2] = 0x80 | (cp & 0x3f);
+		len = 3;
+	} else {
+		seq[0] = 0xf0 | (cp >> 18);
+		seq[1] = 0x80 | ((cp >> 12) & 0x3f);
+		seq[2] = 0x80 | ((cp >> 6) & 0x3f);
+		seq[3] = 0x80 | (cp & 0x3f);
+		len = 4;
+	}
+
+	console_write(seq, len);
+}
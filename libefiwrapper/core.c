@@ -34,14 +34,18 @@
 #include "conout.h"
 #include "ewarg.h"
 #include "ewlog.h"
+#include "ewtrace.h"
 #include "ewvar.h"
 #include "lib.h"
+#include "pool.h"
 #include "rs.h"
 #include "serialio.h"
 #include "smbios.h"
 #include "storage.h"
 #include "version.h"
 
+#define LOG_LEVEL_ARG "efiwrapper.loglevel"
+
 static EFI_GUID image_guid = LOADED_IMAGE_PROTOCOL;
 static EFI_BOOT_SERVICES bs;
 static EFI_RUNTIME_SERVICES rs;
@@ -86,7 +90,10 @@ static struct component {
 	EFI_STATUS (*free)(EFI_SYSTEM_TABLE *st);
 } COMPONENTS[] = {
 	{ "boot services", bs_init, NULL },
-	{ "runtime services", rs_init, NULL },
+	{ "log", ewlog_init, ewlog_free },
+	{ "pool statistics", pool_init, pool_free },
+	{ "runtime services", rs_init, rs_free },
+	{ "trace", ewtrace_init, ewtrace_free },
 	{ "console in", conin_init, conin_free },
 	{ "console out", conout_init, conout_free },
 	{ "serial", serialio_init, serialio_free },
@@ -129,6 +136,7 @@ EFI_STATUS efiwrapper_init(int argc, char **argv, EFI_SYSTEM_TABLE **st_p,
 			   EFI_HANDLE *img_handle)
 {
 	EFI_STATUS ret;
+	const char *log_config;
 	size_t i, j;
 
 	if ((argc && !argv) || !st_p || !img_handle)
@@ -166,6 +174,10 @@ EFI_STATUS efiwrapper_init(int argc, char **argv, EFI_SYSTEM_TABLE **st_p,
 	if (EFI_ERROR(ret))
 		goto err_load_options;
 
+	log_config = ewarg_getval(LOG_LEVEL_ARG);
+	if (log_config && EFI_ERROR(ewlog_configure(log_config)))
+		ewerr("Invalid '%s' log configuration", log_config);
+
 	ret = identify_boot_media();
 	if (EFI_ERROR(ret))
 		goto err_load_options;
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewcrc.h>
+
+#include "lib.h"
+
+#define CRC32C_POLY	0x82F63B78
+
+typedef UINT32 crc_table_t[8][256];
+typedef UINT32 (*crc_update_t)(UINT32 crc, const UINT8 *p, size_t size);
+
+/* Slice 0 of the CRC32 table is the classic byte-wise table, all the
+ * other tables are generated by crc_select(). */
+static crc_table_t crc32_tab = { {
+	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
+	0xe963a535, 0x9e6495a3,	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
+	0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
+	0xf3b97148, 0x84be41de,	0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
+	0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec,	0x14015c4f, 0x63066cd9,
+	0xfa0f3d63, 0x8d080df5,	0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
+	0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,	0x35b5a8fa, 0x42b2986c,
+	0xdbbbc9d6, 0xacbcf940,	0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
+	0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
+	0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
+	0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,	0x76dc4190, 0x01db7106,
+	0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
+	0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
+	0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
+	0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
+	0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
+	0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
+	0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
+	0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
+	0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
+	0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
+	0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
+	0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
+	0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
+	0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
+	0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
+	0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
+	0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
+	0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
+	0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
+	0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
+	0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
+	0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
+	0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
+	0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
+	0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
+	0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
+	0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
+	0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
+	0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
+	0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
+	0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
+	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+} };
+
+static crc_table_t crc32c_tab;
+
+static UINT32 crc_bytes(crc_table_t tab, UINT32 crc, const UINT8 *p,
+			size_t size)
+{
+	while (size--)
+		crc = tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+static UINT32 crc_slice8(crc_table_t tab, UINT32 crc, const UINT8 *p,
+			 size_t size)
+{
+	UINT32 lo, hi;
+
+	for (; size >= 8; size -= 8, p += 8) {
+		lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (UINT32)p[3] << 24);
+		hi = p[4] | p[5] << 8 | p[6] << 16 | (UINT32)p[7] << 24;
+		crc = tab[7][lo & 0xFF] ^ tab[6][(lo >> 8) & 0xFF] ^
+			tab[5][(lo >> 16) & 0xFF] ^ tab[4][lo >> 24] ^
+			tab[3][hi & 0xFF] ^ tab[2][(hi >> 8) & 0xFF] ^
+			tab[1][(hi >> 16) & 0xFF] ^ tab[0][hi >> 24];
+	}
+
+	return crc_bytes(tab, crc, p, size);
+}
+
+static void crc_slices_init(crc_table_t tab)
+{
+	size_t i, j;
+
+	for (i = 1; i < 8; i++)
+		for (j = 0; j < 256; j++)
+			tab[i][j] = (tab[i - 1][j] >> 8) ^
+				tab[0][tab[i - 1][j] & 0xFF];
+}
+
+static UINT32 crc32_slice8(UINT32 crc, const UINT8 *p, size_t size)
+{
+	return crc_slice8(crc32_tab, crc, p, size);
+}
+
+static UINT32 crc32c_slice8(UINT32 crc, const UINT8 *p, size_t size)
+{
+	return crc_slice8(crc32c_tab, crc, p, size);
+}
+
+#ifdef __x86_64__
+/* Folding with carry-less multiplications as described in "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+ * from Intel.  The constants are the bit-reflected ones of the
+ * 0x04C11DB7 polynomial. */
+typedef long long v2di __attribute__((__vector_size__(16)));
+typedef int v4si __attribute__((__vector_size__(16)));
+
+#define CLMUL(a, b, imm)	__builtin_ia32_pclmulqdq128(a, b, imm)
+
+static __attribute__((__target__("pclmul"))) v2di load(const UINT8 *p)
+{
+	v2di x;
+
+	memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+/* Fold the 128 bits of X into the next 128 bits NEXT using the K
+ * constants */
+static __attribute__((__target__("pclmul"))) v2di
+fold(v2di x, v2di k, v2di next)
+{
+	return CLMUL(x, k, 0x00) ^ CLMUL(x, k, 0x11) ^ next;
+}
+
+/* SIZE must be a multiple of 16 and at least 64 */
+static __attribute__((__target__("pclmul"))) UINT32
+crc32_clmul_blocks(UINT32 crc, const UINT8 *p, size_t size)
+{
+	const v2di k1k2 = { 0x0154442bd4, 0x01c6e41596 };
+	const v2di k3k4 = { 0x01751997d0, 0x00ccaa009e };
+	const v2di k5k0 = { 0x0163cd6124, 0x0000000000 };
+	const v2di poly = { 0x01db710641, 0x01f7011641 };
+	const v2di mask32 = { 0xffffffff, 0xffffffff };
+	v2di x1, x2, x3, x4, t;
+
+	x1 = load(p) ^ (v2di){ crc, 0 };
+	x2 = load(p + 16);
+	x3 = load(p + 32);
+	x4 = load(p + 48);
+
+	for (p += 64, size -= 64; size >= 64; p += 64, size -= 64) {
+		x1 = fold(x1, k1k2, load(p));
+		x2 = fold(x2, k1k2, load(p + 16));
+		x3 = fold(x3, k1k2, load(p + 32));
+		x4 = fold(x4, k1k2, load(p + 48));
+	}
+
+	x1 = fold(x1, k3k4, x2);
+	x1 = fold(x1, k3k4, x3);
+	x1 = fold(x1, k3k4, x4);
+
+	for (; size; p += 16, size -= 16)
+		x1 = fold(x1, k3k4, load(p));
+
+	/* Fold 128 bits to 64 bits */
+	x1 = CLMUL(x1, k3k4, 0x10) ^ (v2di){ x1[1], 0 };
+	t = (v2di)(v4si){ ((v4si)x1)[1], ((v4si)x1)[2], ((v4si)x1)[3], 0 };
+	x1 = CLMUL(x1 & mask32, k5k0, 0x00) ^ t;
+
+	/* Barrett reduction to 32 bits */
+	t = CLMUL(x1 & mask32, poly, 0x10);
+	t = CLMUL(t & mask32, poly, 0x00);
+	x1 ^= t;
+
+	return ((v4si)x1)[1];
+}
+
+static UINT32 crc32_clmul(UINT32 crc, const UINT8 *p, size_t size)
+{
+	size_t blocks;
+
+	if (size >= 64) {
+		blocks = size & ~(size_t)15;
+		crc = crc32_clmul_blocks(crc, p, blocks);
+		p += blocks;
+		size -= blocks;
+	}
+
+	return crc32_slice8(crc, p, size);
+}
+
+/* The SSE4.2 crc32 instruction has a 3 cycles latency and a 1 cycle
+ * throughput: large buffers are processed as three interleaved
+ * streams whose CRCs are combined by the shift operators below, as in
+ * Mark Adler's crc32c.c. */
+#define CRC32C_LONG	8192
+#define CRC32C_SHORT	256
+
+static UINT32 crc32c_long[4][256];
+static UINT32 crc32c_short[4][256];
+
+static UINT32 gf2_matrix_times(const UINT32 *mat, UINT32 vec)
+{
+	UINT32 sum = 0;
+
+	for (; vec; vec >>= 1, mat++)
+		if (vec & 1)
+			sum ^= *mat;
+
+	return sum;
+}
+
+static void gf2_matrix_square(UINT32 *square, const UINT32 *mat)
+{
+	size_t n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/* Build the tables applying SIZE zero bytes to a CRC.  SIZE must be a
+ * power of two. */
+static void crc32c_zeros_init(UINT32 zeros[4][256], size_t size)
+{
+	UINT32 even[32], odd[32], *op;
+	size_t n;
+
+	odd[0] = CRC32C_POLY;
+	for (n = 1; n < 32; n++)
+		odd[n] = 1U << (n - 1);
+
+	gf2_matrix_square(even, odd);	/* 2 zero bits */
+	gf2_matrix_square(odd, even);	/* 4 zero bits */
+	for (;;) {
+		gf2_matrix_square(even, odd);
+		op = even;
+		size >>= 1;
+		if (!size)
+			break;
+		gf2_matrix_square(odd, even);
+		op = odd;
+		size >>= 1;
+		if (!size)
+			break;
+	}
+
+	for (n = 0; n < 256; n++) {
+		zeros[0][n] = gf2_matrix_times(op, n);
+		zeros[1][n] = gf2_matrix_times(op, n << 8);
+		zeros[2][n] = gf2_matrix_times(op, n << 16);
+		zeros[3][n] = gf2_matrix_times(op, (UINT32)n << 24);
+	}
+}
+
+static UINT32 crc32c_shift(UINT32 zeros[4][256], UINT32 crc)
+{
+	return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+		zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+static __attribute__((__target__("sse4.2"))) UINT64 load64(const UINT8 *p)
+{
+	UINT64 v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static __attribute__((__target__("sse4.2"))) UINT32
+crc32c_3way(UINT32 zeros[4][256], size_t block, UINT32 crc,
+	    const UINT8 **p_p, size_t *size_p)
+{
+	const UINT8 *p = *p_p, *end;
+	UINT64 crc0 = crc, crc1, crc2;
+
+	for (; *size_p >= block * 3; *size_p -= block * 3) {
+		crc1 = crc2 = 0;
+		for (end = p + block; p < end; p += 8) {
+			crc0 = __builtin_ia32_crc32di(crc0, load64(p));
+			crc1 = __builtin_ia32_crc32di(crc1,
+						      load64(p + block));
+			crc2 = __builtin_ia32_crc32di(crc2,
+						      load64(p + block * 2));
+		}
+		crc0 = crc32c_shift(zeros, crc0) ^ crc1;
+		crc0 = crc32c_shift(zeros, crc0) ^ crc2;
+		p += block * 2;
+	}
+
+	*p_p = p;
+	return crc0;
+}
+
+static __attribute__((__target__("sse4.2"))) UINT32
+crc32c_sse42(UINT32 crc, const UINT8 *p, size_t size)
+{
+	for (; size && (UINTN)p & 7; size--)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+
+	crc = crc32c_3way(crc32c_long, CRC32C_LONG, crc, &p, &size);
+	crc = crc32c_3way(crc32c_short, CRC32C_SHORT, crc, &p, &size);
+
+	for (; size >= 8; size -= 8, p += 8)
+		crc = __builtin_ia32_crc32di(crc, load64(p));
+
+	for (; size; size--)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+
+	return crc;
+}
+
+static void cpuid_features(UINT32 *ecx_p)
+{
+	UINT32 eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile("cpuid"
+		     : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+
+	*ecx_p = ecx;
+}
+
+#define CPUID_ECX_PCLMULQDQ	(1 << 1)
+#define CPUID_ECX_SSE42		(1 << 20)
+#endif
+
+static UINT32 crc32_select(UINT32 crc, const UINT8 *p, size_t size);
+static UINT32 crc32c_select(UINT32 crc, const UINT8 *p, size_t size);
+
+static crc_update_t crc32_update = crc32_select;
+static crc_update_t crc32c_update = crc32c_select;
+
+static void crc_select(void)
+{
+	crc_update_t update32 = crc32_slice8, update32c = crc32c_slice8;
+	size_t n, bit;
+	UINT32 crc;
+#ifdef __x86_64__
+	UINT32 features;
+#endif
+
+	crc_slices_init(crc32_tab);
+
+	for (n = 0; n < ARRAY_SIZE(crc32c_tab[0]); n++) {
+		crc = n;
+		for (bit = 0; bit < 8; bit++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc32c_tab[0][n] = crc;
+	}
+	crc_slices_init(crc32c_tab);
+
+#ifdef __x86_64__
+	cpuid_features(&features);
+	if (features & CPUID_ECX_PCLMULQDQ)
+		update32 = crc32_clmul;
+	if (features & CPUID_ECX_SSE42) {
+		crc32c_zeros_init(crc32c_long, CRC32C_LONG);
+		crc32c_zeros_init(crc32c_short, CRC32C_SHORT);
+		update32c = crc32c_sse42;
+	}
+#endif
+
+	crc32_update = update32;
+	crc32c_update = update32c;
+}
+
+static UINT32 crc32_select(UINT32 crc, const UINT8 *p, size_t size)
+{
+	crc_select();
+	return crc32_update(crc, p, size);
+}
+
+static UINT32 crc32c_select(UINT32 crc, const UINT8 *p, size_t size)
+{
+	crc_select();
+	return crc32c_update(crc, p, size);
+}
+
+UINT32 ewcrc32_update(UINT32 crc, const void *buf, size_t size)
+{
+	return crc32_update(crc, buf, size);
+}
+
+UINT32 ewcrc32c_update(UINT32 crc, const void *buf, size_t size)
+{
+	return crc32c_update(crc, buf, size);
+}
+
+EFI_STATUS crc32(const void *buf, size_t size, UINT32 *crc_p)
+{
+	if (!buf || !crc_p)
+		return EFI_INVALID_PARAMETER;
+
+	*crc_p = crc32_update(~0U, buf, size) ^ ~0U;
+
+	return EFI_SUCCESS;
+}
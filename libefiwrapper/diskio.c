@@ -33,6 +33,8 @@
 #include "interface.h"
 #include "lib.h"
 
+#include <ewtrace.h>
+
 typedef struct diskio {
 	EFI_DISK_IO interface;
 	media_t *media;
@@ -47,7 +49,7 @@ static EFI_STATUS read_block(media_t *media, EFI_LBA lba,
 	if (!*block)
 		return EFI_OUT_OF_RESOURCES;
 
-	count = media->storage->read(media->storage, lba, 1, *block);
+	count = media_read(media, lba, 1, *block);
 	if (count != 1) {
 		free(*block);
 		return EFI_DEVICE_ERROR;
@@ -56,18 +58,20 @@ static EFI_STATUS read_block(media_t *media, EFI_LBA lba,
 	return EFI_SUCCESS;
 }
 
-static EFIAPI EFI_STATUS
-diskio_read(struct _EFI_DISK_IO *This,
-	    UINT32 MediaId,
-	    UINT64 Offset,
-	    UINTN BufferSize,
-	    VOID *Buffer)
+static EFI_STATUS
+read_disk(struct _EFI_DISK_IO *This,
+	  UINT32 MediaId,
+	  UINT64 Offset,
+	  UINTN BufferSize,
+	  VOID *Buffer)
 {
-	EFI_STATUS ret;
+	EFI_STATUS ret = EFI_SUCCESS;
 	diskio_t *diskio = (diskio_t *)This;
-	UINT32 count, size;
+	storage_segment_t segs[3];
+	UINTN head, head_size, tail_size, nb = 0;
+	EFI_LBA lba, count, blocks;
 	UINT32 blksz;
- 	unsigned char *buf = Buffer, *block;
+	unsigned char *buf = Buffer, *bounce = NULL;
 	media_t *media;
 
 	if (!This || !Buffer)
@@ -84,47 +88,65 @@ diskio_read(struct _EFI_DISK_IO *This,
 	if (!blksz)
 		return EFI_INVALID_PARAMETER;
 
-	if (Offset % blksz) {
-		ret = read_block(media, Offset / blksz, &block);
-		if (EFI_ERROR(ret))
-			return ret;
+	head = Offset % blksz;
+	head_size = head ? min(blksz - head, BufferSize) : 0;
+	count = (BufferSize - head_size) / blksz;
+	tail_size = (BufferSize - head_size) % blksz;
 
-		size = min(blksz - (Offset % blksz), BufferSize);
-		memcpy(buf, block + (Offset % blksz), size);
-		free(block);
+	if (head_size)
+		media->stats.UnalignedHeads++;
+	if (tail_size)
+		media->stats.UnalignedTails++;
 
-		buf += size;
-		Offset += size;
-		BufferSize -= size;
+	if (head_size || tail_size) {
+		bounce = malloc(2 * blksz);
+		if (!bounce)
+			return EFI_OUT_OF_RESOURCES;
 	}
 
-	size = BufferSize / blksz;
-	if (size > 0) {
-		count = media->storage->read(media->storage, Offset / blksz, size, buf);
-		if (count != size)
-			return EFI_DEVICE_ERROR;
-		size *= blksz;
-		BufferSize -= size;
-		Offset += size;
-		buf += size;
+	/* The partial head and tail blocks and the blocks in between
+	 * are read at once */
+	lba = Offset / blksz;
+	if (head_size) {
+		segs[nb].start = lba++;
+		segs[nb].count = 1;
+		segs[nb++].buf = bounce;
 	}
-	if (BufferSize) {
-		ret = read_block(media, Offset / blksz, &block);
-		if (EFI_ERROR(ret))
-			return ret;
-		memcpy(buf, block, BufferSize);
-		free(block);
+	if (count) {
+		segs[nb].start = lba;
+		segs[nb].count = count;
+		segs[nb++].buf = buf + head_size;
+		lba += count;
+	}
+	if (tail_size) {
+		segs[nb].start = lba;
+		segs[nb].count = 1;
+		segs[nb++].buf = bounce + blksz;
 	}
 
-	return EFI_SUCCESS;
+	blocks = (head_size ? 1 : 0) + count + (tail_size ? 1 : 0);
+	if (media_readv(media, segs, nb) != blocks) {
+		ret = EFI_DEVICE_ERROR;
+		goto out;
+	}
+
+	if (head_size)
+		memcpy(buf, bounce + head, head_size);
+	if (tail_size)
+		memcpy(buf + head_size + count * blksz, bounce + blksz,
+		       tail_size);
+
+out:
+	free(bounce);
+	return ret;
 }
 
-static EFIAPI EFI_STATUS
-diskio_write(struct _EFI_DISK_IO *This,
-	     UINT32 MediaId,
-	     UINT64 Offset,
-	     UINTN BufferSize,
-	     VOID *Buffer)
+static EFI_STATUS
+write_disk(struct _EFI_DISK_IO *This,
+	   UINT32 MediaId,
+	   UINT64 Offset,
+	   UINTN BufferSize,
+	   VOID *Buffer)
 {
 	EFI_STATUS ret;
 	diskio_t *diskio = (diskio_t *)This;
@@ -148,6 +170,7 @@ diskio_write(struct _EFI_DISK_IO *This,
 		return EFI_INVALID_PARAMETER;
 
 	if (Offset % blksz) {
+		media->stats.UnalignedHeads++;
 		ret = read_block(media, Offset / blksz, &block);
 		if (EFI_ERROR(ret))
 			return ret;
@@ -155,7 +178,7 @@ diskio_write(struct _EFI_DISK_IO *This,
 		size = min(blksz - (Offset % blksz), BufferSize);
 		memcpy(block + (Offset % blksz), buf, size);
 
-		count = media->storage->write(media->storage, Offset / blksz, 1, block);
+		count = media_write(media, Offset / blksz, 1, block);
 		free(block);
 		if (count != 1)
 			return EFI_DEVICE_ERROR;
@@ -167,7 +190,7 @@ diskio_write(struct _EFI_DISK_IO *This,
 
 	size = BufferSize / blksz;
 	if (size > 0) {
-		count = media->storage->write(media->storage, Offset / blksz, size, buf);
+		count = media_write(media, Offset / blksz, size, buf);
 		if (count != size)
 			return EFI_DEVICE_ERROR;
 
@@ -177,12 +200,13 @@ diskio_write(struct _EFI_DISK_IO *This,
 		buf += size;
 	}
 	if (BufferSize) {
+		media->stats.UnalignedTails++;
 		ret = read_block(media, Offset / blksz, &block);
 		if (EFI_ERROR(ret))
 			return ret;
 
 		memcpy(block, buf, BufferSize);
-		count = media->storage->write(media->storage, Offset / blksz, 1, block);
+		count = media_write(media, Offset / blksz, 1, block);
 		free(block);
 		if (count != 1)
 			return EFI_DEVICE_ERROR;
@@ -191,6 +215,38 @@ diskio_write(struct _EFI_DISK_IO *This,
 	return EFI_SUCCESS;
 }
 
+static EFIAPI EFI_STATUS
+diskio_read(struct _EFI_DISK_IO *This,
+	    UINT32 MediaId,
+	    UINT64 Offset,
+	    UINTN BufferSize,
+	    VOID *Buffer)
+{
+	EFI_STATUS ret;
+
+	ewtrace_begin("DiskIo.ReadDisk", BufferSize);
+	ret = read_disk(This, MediaId, Offset, BufferSize, Buffer);
+	ewtrace_end("DiskIo.ReadDisk");
+
+	return ret;
+}
+
+static EFIAPI EFI_STATUS
+diskio_write(struct _EFI_DISK_IO *This,
+	     UINT32 MediaId,
+	     UINT64 Offset,
+	     UINTN BufferSize,
+	     VOID *Buffer)
+{
+	EFI_STATUS ret;
+
+	ewtrace_begin("DiskIo.WriteDisk", BufferSize);
+	ret = write_disk(This, MediaId, Offset, BufferSize, Buffer);
+	ewtrace_end("DiskIo.WriteDisk");
+
+	return ret;
+}
+
 static EFI_GUID diskio_guid = DISK_IO_PROTOCOL;
 
 EFI_STATUS diskio_init(EFI_SYSTEM_TABLE *st, media_t *media,
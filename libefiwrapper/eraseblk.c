@@ -34,6 +34,7 @@
 #include "interface.h"
 
 #include <efilib.h>
+#include <ewtrace.h>
 
 
 typedef struct eraseblock {
@@ -44,7 +45,6 @@ typedef struct eraseblock {
 static EFI_STATUS storage_erase_block(EFI_ERASE_BLOCK_PROTOCOL *This,
 				 UINT32 MediaId, EFI_LBA LBA, UINTN Size)
 {
-	EFI_STATUS ret;
 	eraseblk_t *eraseblk = (eraseblk_t *)This;
 	media_t *media;
 
@@ -58,12 +58,7 @@ static EFI_STATUS storage_erase_block(EFI_ERASE_BLOCK_PROTOCOL *This,
 	if (media->m.MediaId != MediaId)
 		return EFI_MEDIA_CHANGED;
 
-	if (media->storage->erase)
-		ret = media->storage->erase(media->storage, LBA, Size);
-	else
-		return EFI_UNSUPPORTED;
-
-	return ret;
+	return media_erase(media, LBA, Size);
 }
 
 EFI_STATUS
@@ -76,7 +71,13 @@ erase_block (
   IN     UINTN                         Size
   )
 {
-	return storage_erase_block(This, MediaId, Lba, Size);
+	EFI_STATUS ret;
+
+	ewtrace_begin("EraseBlock.EraseBlocks", Size);
+	ret = storage_erase_block(This, MediaId, Lba, Size);
+	ewtrace_end("EraseBlock.EraseBlocks");
+
+	return ret;
 }
 
 static EFI_GUID erase_block_guid = EFI_ERASE_BLOCK_PROTOCOL_GUID;
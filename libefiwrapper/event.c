@@ -0,0 +1,655 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewevent.h>
+#include <ewlog.h>
+
+#include "event.h"
+#include "lib.h"
+#include "protocol.h"
+#include "timer_wheel.h"
+
+#define TICK		10000	/* 1 ms in 100 ns unit */
+#define TPL_LEVELS	(TPL_HIGH_LEVEL + 1)
+
+typedef struct event {
+	wtimer_t timer;		/* Must be first */
+	UINT32 type;
+	EFI_TPL tpl;
+	EFI_EVENT_NOTIFY notify;
+	VOID *context;
+	UINT64 period;		/* In ticks, zero for a one-shot timer */
+	BOOLEAN signaled;
+	BOOLEAN notify_pending;	/* Deferred EVT_NOTIFY_WAIT notify */
+	BOOLEAN closed;
+	BOOLEAN queued;		/* EVT_NOTIFY_SIGNAL notify to dispatch */
+	struct event *queue_next;
+	BOOLEAN grouped;
+	EFI_GUID group;
+	struct event *group_next;
+} event_t;
+
+typedef struct notify_queue {
+	event_t *head;
+	event_t *tail;
+} notify_queue_t;
+
+static ewevent_backend_t *backend;
+static wheel_t wheel;
+static BOOLEAN wheel_ready;
+
+/* There is only one logical processor: the notify functions are only
+ * dispatched by the thread running the EFI application, at its TPL.
+ * The other threads behave like interrupt handlers, they only queue
+ * the notify functions, and have their own TPL. */
+static EFI_TPL app_tpl = TPL_APPLICATION;
+static notify_queue_t queues[TPL_LEVELS];
+static UINT32 pending;		/* Bit N is set if queues[N] is not empty */
+static event_t *groups;		/* Events belonging to an event group */
+
+static void lock(void)
+{
+	if (backend && backend->lock)
+		backend->lock();
+}
+
+static void unlock(void)
+{
+	if (backend && backend->unlock)
+		backend->unlock();
+}
+
+static void wake(void)
+{
+	if (backend && backend->wake)
+		backend->wake();
+}
+
+static BOOLEAN has_clock(void)
+{
+	return backend && backend->now;
+}
+
+static UINT64 now_tick(void)
+{
+	return backend->now() / TICK;
+}
+
+EFI_STATUS event_now(UINT64 *now)
+{
+	if (!has_clock())
+		return EFI_UNSUPPORTED;
+
+	*now = backend->now();
+	return EFI_SUCCESS;
+}
+
+/* TPL of the calling thread */
+static EFI_TPL *current_tpl(void)
+{
+	EFI_TPL *tpl = NULL;
+
+	if (backend && backend->thread_tpl)
+		tpl = backend->thread_tpl();
+
+	return tpl ? tpl : &app_tpl;
+}
+
+static BOOLEAN is_app_thread(void)
+{
+	return current_tpl() == &app_tpl;
+}
+
+void event_lock(void)
+{
+	lock();
+}
+
+void event_unlock(void)
+{
+	unlock();
+}
+
+void event_sleep(UINT64 duration)
+{
+	lock();
+	if (has_clock() && backend->sleep)
+		backend->sleep(backend->now() + duration);
+	unlock();
+}
+
+static void queue_notify(event_t *event)
+{
+	notify_queue_t *queue = &queues[event->tpl];
+
+	if (event->queued)
+		return;
+
+	event->queued = TRUE;
+	event->queue_next = NULL;
+	if (queue->tail)
+		queue->tail->queue_next = event;
+	else
+		queue->head = event;
+	queue->tail = event;
+	pending |= 1U << event->tpl;
+}
+
+static void unqueue_notify(event_t *event)
+{
+	notify_queue_t *queue = &queues[event->tpl];
+	event_t **p, *prev = NULL;
+
+	if (!event->queued)
+		return;
+
+	for (p = &queue->head; *p != event; p = &(*p)->queue_next)
+		prev = *p;
+
+	*p = event->queue_next;
+	if (queue->tail == event)
+		queue->tail = prev;
+	if (!queue->head)
+		pending &= ~(1U << event->tpl);
+	event->queued = FALSE;
+}
+
+static event_t *dequeue_notify(EFI_TPL tpl)
+{
+	event_t *event = queues[tpl].head;
+
+	unqueue_notify(event);
+	return event;
+}
+
+static EFI_TPL highest_pending(EFI_TPL level)
+{
+	EFI_TPL tpl;
+
+	for (tpl = TPL_HIGH_LEVEL; tpl > level; tpl--)
+		if (pending & (1U << tpl))
+			return tpl;
+
+	return level;
+}
+
+/* Called locked.  Set the TPL of the calling thread to LEVEL.  On
+ * the application thread, first run the queued notify functions of
+ * TPL higher than LEVEL, highest TPL first, each one at its own TPL. */
+static void dispatch_locked(EFI_TPL level)
+{
+	event_t *event;
+	EFI_TPL tpl;
+
+	if (!is_app_thread()) {
+		*current_tpl() = level;
+		return;
+	}
+
+	while ((tpl = highest_pending(level)) > level) {
+		event = dequeue_notify(tpl);
+		app_tpl = tpl;
+		unlock();
+		event->notify(event, event->context);
+		lock();
+	}
+
+	app_tpl = level;
+}
+
+/* Called locked.  The notify function of an EVT_NOTIFY_SIGNAL event
+ * is queued until the application thread calls dispatch_locked(). */
+static void signal_locked(event_t *event)
+{
+	if (event->type & EVT_NOTIFY_SIGNAL) {
+		queue_notify(event);
+		/* Have a sleeping WaitForEvent() dispatch it */
+		if (!is_app_thread())
+			wake();
+		return;
+	}
+
+	event->signaled = TRUE;
+	wake();
+}
+
+static void call_notify(event_t *event)
+{
+	unlock();
+	event->notify(event, event->context);
+	lock();
+}
+
+static void run_timers(void)
+{
+	wtimer_t *timer;
+	event_t *event;
+	UINT64 tick;
+
+	if (has_clock() && wheel_ready) {
+		tick = now_tick();
+		while ((timer = wheel_expire(&wheel, tick))) {
+			event = (event_t *)timer;
+			if (event->period) {
+				timer->expires = max(timer->expires +
+						     event->period, tick + 1);
+				wheel_add(&wheel, timer);
+			}
+
+			signal_locked(event);
+		}
+	}
+
+	dispatch_locked(*current_tpl());
+}
+
+static void run_wait_notify(void *arg)
+{
+	event_t *event = arg;
+
+	event->notify(event, event->context);
+
+	lock();
+	event->notify_pending = FALSE;
+	if (event->closed)
+		free(event);
+	else
+		wake();
+	unlock();
+}
+
+/* Called locked.  The notify function of an EVT_NOTIFY_WAIT event is
+ * expected to signal the event once its condition is met. */
+static void queue_wait_notify(event_t *event)
+{
+	if (event->notify_pending)
+		return;
+
+	if (backend && backend->defer) {
+		event->notify_pending = TRUE;
+		if (!EFI_ERROR(backend->defer(run_wait_notify, event,
+					      event->tpl)))
+			return;
+		event->notify_pending = FALSE;
+	}
+
+	call_notify(event);
+}
+
+static EFI_STATUS check_locked(event_t *event)
+{
+	if (!event->signaled && event->type & EVT_NOTIFY_WAIT)
+		queue_wait_notify(event);
+
+	if (!event->signaled)
+		return EFI_NOT_READY;
+
+	event->signaled = FALSE;
+	return EFI_SUCCESS;
+}
+
+static void sleep_locked(void)
+{
+	UINT64 next = WHEEL_NEVER;
+
+	if (!backend || !backend->sleep)
+		return;
+
+	if (has_clock() && wheel_ready)
+		next = wheel_next(&wheel);
+
+	backend->sleep(next == WHEEL_NEVER ? EWEVENT_NO_DEADLINE :
+		       next * TICK);
+}
+
+/* Called locked */
+static void signal_group_locked(EFI_GUID *group)
+{
+	event_t *event;
+
+	for (event = groups; event; event = event->group_next)
+		if (!guidcmp(&event->group, group))
+			signal_locked(event);
+}
+
+static void remove_from_group_locked(event_t *event)
+{
+	event_t **p;
+
+	if (!event->grouped)
+		return;
+
+	for (p = &groups; *p != event; p = &(*p)->group_next)
+		;
+	*p = event->group_next;
+	event->grouped = FALSE;
+}
+
+static EFIAPI EFI_STATUS
+create_event_ex(UINT32 Type,
+		EFI_TPL NotifyTpl,
+		EFI_EVENT_NOTIFY NotifyFunction,
+		const VOID *NotifyContext,
+		const EFI_GUID *EventGroup,
+		EFI_EVENT *Event)
+{
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+	event_t *event;
+
+	/* The legacy event types are expressed as event groups */
+	if (Type == EVT_SIGNAL_EXIT_BOOT_SERVICES) {
+		if (EventGroup)
+			return EFI_INVALID_PARAMETER;
+		Type = EVT_NOTIFY_SIGNAL;
+		EventGroup = &exit_bs_group;
+	}
+
+	if (!Event ||
+	    (Type & EVT_NOTIFY_SIGNAL && Type & EVT_NOTIFY_WAIT) ||
+	    (!NotifyFunction && (Type & EVT_NOTIFY_SIGNAL || Type & EVT_NOTIFY_WAIT)))
+		return EFI_INVALID_PARAMETER;
+
+	if ((Type & EVT_NOTIFY_SIGNAL || Type & EVT_NOTIFY_WAIT) &&
+	    (NotifyTpl <= TPL_APPLICATION || NotifyTpl > TPL_HIGH_LEVEL))
+		return EFI_INVALID_PARAMETER;
+
+	event = calloc(1, sizeof(*event));
+	if (!event)
+		return EFI_OUT_OF_RESOURCES;
+
+	event->type = Type;
+	event->tpl = NotifyTpl;
+	event->notify = NotifyFunction;
+	event->context = (VOID *)NotifyContext;
+
+	if (EventGroup) {
+		memcpy(&event->group, EventGroup, sizeof(event->group));
+		event->grouped = TRUE;
+		lock();
+		event->group_next = groups;
+		groups = event;
+		unlock();
+	}
+
+	*Event = event;
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+create_event(UINT32 Type,
+	     EFI_TPL NotifyTpl,
+	     EFI_EVENT_NOTIFY NotifyFunction,
+	     VOID *NotifyContext,
+	     EFI_EVENT *Event)
+{
+	return create_event_ex(Type, NotifyTpl, NotifyFunction,
+			       NotifyContext, NULL, Event);
+}
+
+static EFIAPI EFI_STATUS
+set_timer(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime)
+{
+	event_t *event = (event_t *)Event;
+	UINT64 now, ticks;
+
+	if (!Event || !(event->type & EVT_TIMER) || Type > TimerRelative)
+		return EFI_INVALID_PARAMETER;
+
+	if (Type != TimerCancel && !has_clock())
+		return EFI_UNSUPPORTED;
+
+	lock();
+
+	if (wheel_ready)
+		wheel_del(&wheel, &event->timer);
+
+	if (Type != TimerCancel) {
+		/* Round up so that the event is never signaled early */
+		now = backend->now();
+		ticks = (TriggerTime + TICK - 1) / TICK;
+		event->period = Type == TimerPeriodic ? max(ticks, 1) : 0;
+		event->timer.expires = (now + TriggerTime + TICK - 1) / TICK;
+		event->timer.expires = max(event->timer.expires,
+					   now / TICK + 1);
+		wheel_add(&wheel, &event->timer);
+		wake();
+	}
+
+	unlock();
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+wait_for_event(UINTN NumberOfEvents,
+	       EFI_EVENT *Event,
+	       UINTN *Index)
+{
+	EFI_STATUS ret;
+	UINTN i;
+
+	if (!NumberOfEvents || !Event || !Index)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < NumberOfEvents; i++)
+		if (!Event[i] ||
+		    ((event_t *)Event[i])->type & EVT_NOTIFY_SIGNAL) {
+			*Index = i;
+			return EFI_INVALID_PARAMETER;
+		}
+
+	lock();
+	if (*current_tpl() != TPL_APPLICATION) {
+		unlock();
+		return EFI_UNSUPPORTED;
+	}
+
+	for (;;) {
+		run_timers();
+
+		for (i = 0; i < NumberOfEvents; i++) {
+			ret = check_locked((event_t *)Event[i]);
+			if (!EFI_ERROR(ret)) {
+				*Index = i;
+				unlock();
+				return EFI_SUCCESS;
+			}
+		}
+
+		/* Idle, the log ring can be drained */
+		if (ewlog_pending()) {
+			unlock();
+			ewlog_flush();
+			lock();
+			continue;
+		}
+
+		sleep_locked();
+	}
+}
+
+static EFIAPI EFI_STATUS
+signal_event(EFI_EVENT Event)
+{
+	event_t *event = (event_t *)Event;
+
+	if (!Event)
+		return EFI_INVALID_PARAMETER;
+
+	lock();
+	if (event->grouped)
+		signal_group_locked(&event->group);
+	else
+		signal_locked(event);
+	dispatch_locked(*current_tpl());
+	unlock();
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+close_event(EFI_EVENT Event)
+{
+	event_t *event = (event_t *)Event;
+
+	if (!Event)
+		return EFI_INVALID_PARAMETER;
+
+	protocol_unregister_notify(Event);
+
+	lock();
+	if (wheel_ready)
+		wheel_del(&wheel, &event->timer);
+	unqueue_notify(event);
+	remove_from_group_locked(event);
+	if (event->notify_pending) {
+		/* Released once the notify function returns */
+		event->closed = TRUE;
+		unlock();
+		return EFI_SUCCESS;
+	}
+	unlock();
+
+	free(event);
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+check_event(EFI_EVENT Event)
+{
+	event_t *event = (event_t *)Event;
+	EFI_STATUS ret;
+
+	if (!Event)
+		return EFI_INVALID_PARAMETER;
+
+	if (event->type & EVT_NOTIFY_SIGNAL)
+		return EFI_INVALID_PARAMETER;
+
+	lock();
+	run_timers();
+	ret = check_locked(event);
+	unlock();
+
+	return ret;
+}
+
+static EFIAPI EFI_TPL
+raise_tpl(EFI_TPL NewTpl)
+{
+	EFI_TPL old;
+
+	lock();
+	old = *current_tpl();
+	if (NewTpl < old || NewTpl > TPL_HIGH_LEVEL)
+		ewerr("Invalid RaiseTPL() from %u to %u", (UINT32)old,
+		      (UINT32)NewTpl);
+	else
+		*current_tpl() = NewTpl;
+	unlock();
+
+	return old;
+}
+
+static EFIAPI VOID
+restore_tpl(EFI_TPL OldTpl)
+{
+	lock();
+	if (OldTpl > *current_tpl()) {
+		ewerr("Invalid RestoreTPL() from %u to %u",
+		      (UINT32)*current_tpl(), (UINT32)OldTpl);
+		unlock();
+		return;
+	}
+
+	dispatch_locked(OldTpl);
+	unlock();
+}
+
+EFI_STATUS ewevent_register_backend(ewevent_backend_t *b)
+{
+	if (!b)
+		return EFI_INVALID_PARAMETER;
+
+	if (backend)
+		return EFI_ALREADY_STARTED;
+
+	backend = b;
+
+	lock();
+	if (has_clock() && !wheel_ready) {
+		wheel_init(&wheel, now_tick());
+		wheel_ready = TRUE;
+	}
+	unlock();
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS ewevent_unregister_backend(void)
+{
+	if (!backend)
+		return EFI_NOT_STARTED;
+
+	backend = NULL;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS event_signal_group(EFI_GUID *group)
+{
+	if (!group)
+		return EFI_INVALID_PARAMETER;
+
+	lock();
+	signal_group_locked(group);
+	dispatch_locked(*current_tpl());
+	unlock();
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS event_init_bs(EFI_BOOT_SERVICES *bs)
+{
+	if (!bs)
+		return EFI_INVALID_PARAMETER;
+
+	bs->RaiseTPL = raise_tpl;
+	bs->RestoreTPL = restore_tpl;
+	bs->CreateEvent = create_event;
+	bs->SetTimer = set_timer;
+	bs->WaitForEvent = wait_for_event;
+	bs->SignalEvent = signal_event;
+	bs->CloseEvent = close_event;
+	bs->CheckEvent = check_event;
+	bs->CreateEventEx = create_event_ex;
+
+	return EFI_SUCCESS;
+}
@@ -33,50 +33,285 @@
 
 #include "ewdrv.h"
 #include "ewlog.h"
+#include "ewtrace.h"
+
+typedef enum {
+	DRV_PENDING,
+	DRV_POLLING,
+	DRV_READY
+} drv_state_t;
+
+typedef struct drv {
+	ewdrv_t *ewdrv;
+	EFI_SYSTEM_TABLE *st;
+	drv_state_t state;
+	BOOLEAN started;	/* start() succeeded, exit() is due */
+	UINT64 polling_since;
+	/* In trace clock ticks */
+	UINT64 start_time;
+	UINT64 wait_time;
+	UINT64 init_time;
+	UINT64 ready_at;	/* Since the beginning of the bring-up */
+} drv_t;
+
+static drv_t *drvs;
+static size_t nb_drvs;
+static UINT64 bringup_begin;
+
+static drv_t *find_drv(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < nb_drvs; i++)
+		if (!strcmp(drvs[i].ewdrv->name, name))
+			return &drvs[i];
+
+	return NULL;
+}
+
+static BOOLEAN dependencies_ready(size_t index)
+{
+	const char **dep;
+	drv_t *drv;
+	size_t i;
+
+	if (!drvs[index].ewdrv->depends) {
+		for (i = 0; i < index; i++)
+			if (drvs[i].state != DRV_READY)
+				return FALSE;
+		return TRUE;
+	}
+
+	for (dep = drvs[index].ewdrv->depends; *dep; dep++) {
+		drv = find_drv(*dep);
+		if (drv && drv->state != DRV_READY)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* First pending driver whose dependencies are initialized, with a
+ * poll() function if POLLED and without otherwise */
+static drv_t *next_launchable(BOOLEAN polled)
+{
+	size_t i;
+
+	for (i = 0; i < nb_drvs; i++) {
+		if (drvs[i].state != DRV_PENDING ||
+		    !drvs[i].ewdrv->poll != !polled ||
+		    !dependencies_ready(i))
+			continue;
+		return &drvs[i];
+	}
+
+	return NULL;
+}
+
+static EFI_STATUS complete(drv_t *drv)
+{
+	EFI_STATUS ret;
+	UINT64 begin;
+
+	begin = ewtrace_now();
+	ewtrace_begin(drv->ewdrv->name, 0);
+	ret = drv->ewdrv->init(drv->st);
+	ewtrace_end(drv->ewdrv->name);
+	drv->init_time = ewtrace_now() - begin;
+	if (EFI_ERROR(ret))
+		return ret;
+
+	drv->state = DRV_READY;
+	drv->ready_at = ewtrace_now() - bringup_begin;
+	ewdbg("'%s' driver succesfully initialized", drv->ewdrv->name);
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS launch(drv_t *drv)
+{
+	EFI_STATUS ret;
+	UINT64 begin;
+
+	if (drv->ewdrv->start) {
+		begin = ewtrace_now();
+		ewtrace_begin(drv->ewdrv->name, 0);
+		ret = drv->ewdrv->start(drv->st);
+		ewtrace_end(drv->ewdrv->name);
+		drv->start_time = ewtrace_now() - begin;
+		if (EFI_ERROR(ret))
+			return ret;
+		drv->started = TRUE;
+	}
+
+	if (!drv->ewdrv->poll)
+		return complete(drv);
+
+	drv->polling_since = ewtrace_now();
+	drv->state = DRV_POLLING;
+	return EFI_SUCCESS;
+}
+
+/* Complete the bring-up of DRV if its hardware is ready */
+static EFI_STATUS poll(drv_t *drv, BOOLEAN *progress)
+{
+	EFI_STATUS ret;
+
+	ret = drv->ewdrv->poll(drv->st);
+	if (ret == EFI_NOT_READY)
+		return EFI_SUCCESS;
+
+	drv->wait_time = ewtrace_now() - drv->polling_since;
+	ewtrace_instant(drv->ewdrv->name, (UINT32)ret);
+	*progress = TRUE;
+	if (EFI_ERROR(ret))
+		return ret;
+
+	return complete(drv);
+}
+
+static void report(void)
+{
+	UINT64 total = 0, serial = 0;
+	const char *unit;
+	drv_t *drv;
+	size_t i;
+
+	if (!ewlog_wanted(EWLOG_INFO))
+		return;
+
+	unit = ewtrace_frequency() ? "us" : "ticks";
+	for (i = 0; i < nb_drvs; i++) {
+		drv = &drvs[i];
+		ewlog(EWLOG_INFO, "'%s' driver ready at %llu %s: start %llu, "
+		      "wait %llu, init %llu", drv->ewdrv->name,
+		      (unsigned long long)ewtrace_to_us(drv->ready_at), unit,
+		      (unsigned long long)ewtrace_to_us(drv->start_time),
+		      (unsigned long long)ewtrace_to_us(drv->wait_time),
+		      (unsigned long long)ewtrace_to_us(drv->init_time));
+		serial += drv->start_time + drv->wait_time + drv->init_time;
+		if (drv->ready_at > total)
+			total = drv->ready_at;
+	}
+
+	ewlog(EWLOG_INFO, "Drivers ready in %llu %s, %llu %s of serial "
+	      "bring-up", (unsigned long long)ewtrace_to_us(total), unit,
+	      (unsigned long long)ewtrace_to_us(serial), unit);
+}
+
+static void release(void)
+{
+	free(drvs);
+	drvs = NULL;
+	nb_drvs = 0;
+}
 
 EFI_STATUS ewdrv_init(EFI_SYSTEM_TABLE *st)
 {
 	EFI_STATUS ret = EFI_SUCCESS;
-	size_t i, j;
+	BOOLEAN progress;
+	size_t i, nb_ready = 0, nb_polling = 0;
+	drv_t *drv = NULL;
 
 	if (!ew_drivers)
 		return EFI_UNSUPPORTED;
 
-	for (i = 0; ew_drivers[i]; i++) {
-		ret = ew_drivers[i]->init(st);
-		if (EFI_ERROR(ret))
-			break;
-		ewdbg("'%s' driver succesfully initialized",
-		      ew_drivers[i]->name);
+	for (nb_drvs = 0; ew_drivers[nb_drvs]; nb_drvs++)
+		;
+
+	drvs = calloc(nb_drvs, sizeof(*drvs));
+	if (!drvs && nb_drvs)
+		return EFI_OUT_OF_RESOURCES;
+
+	for (i = 0; i < nb_drvs; i++) {
+		drvs[i].ewdrv = ew_drivers[i];
+		drvs[i].st = st;
 	}
 
-	if (EFI_ERROR(ret)) {
-		ewerr("Failed to initialize '%s' driver", ew_drivers[i]->name);
-		for (j = 0; j < i; j++) {
-			if (!ew_drivers[j]->exit)
+	bringup_begin = ewtrace_now();
+	while (nb_ready < nb_drvs) {
+		progress = FALSE;
+
+		/* One driver at a time so that the drivers it unblocks
+		 * are considered before the next one */
+		drv = next_launchable(TRUE);
+		if (!drv)
+			drv = next_launchable(FALSE);
+		if (drv) {
+			ret = launch(drv);
+			if (EFI_ERROR(ret))
+				goto err;
+			progress = TRUE;
+			if (drv->state == DRV_READY)
+				nb_ready++;
+			else
+				nb_polling++;
+		}
+
+		for (i = 0; i < nb_drvs; i++) {
+			drv = &drvs[i];
+			if (drv->state != DRV_POLLING)
 				continue;
-			ew_drivers[j]->exit(st);
+
+			ret = poll(drv, &progress);
+			if (EFI_ERROR(ret))
+				goto err;
+			if (drv->state == DRV_READY) {
+				nb_polling--;
+				nb_ready++;
+			}
+		}
+
+		if (!progress && !nb_polling) {
+			drv = NULL;
+			ret = EFI_LOAD_ERROR;
+			ewerr("Unresolved driver dependencies");
+			goto err;
 		}
 	}
 
+	report();
+	return EFI_SUCCESS;
+
+err:
+	if (drv)
+		ewerr("Failed to initialize '%s' driver", drv->ewdrv->name);
+	for (i = 0; i < nb_drvs; i++) {
+		if (drvs[i].state != DRV_READY && !drvs[i].started)
+			continue;
+		if (drvs[i].ewdrv->exit)
+			drvs[i].ewdrv->exit(st);
+	}
+	release();
 	return ret;
 }
 
 EFI_STATUS ewdrv_exit(EFI_SYSTEM_TABLE *st)
 {
 	EFI_STATUS ret;
+	BOOLEAN timed;
+	UINT64 begin;
 	size_t i;
 
 	if (!ew_drivers)
 		return EFI_UNSUPPORTED;
 
+	timed = ewlog_wanted(EWLOG_INFO);
 	for (i = 0; ew_drivers[i]; i++) {
 		if (!ew_drivers[i]->exit)
 			continue;
+		begin = timed ? ewtrace_now() : 0;
 		ret = ew_drivers[i]->exit(st);
 		if (EFI_ERROR(ret))
 			return ret;
+		if (timed)
+			ewlog(EWLOG_INFO, "'%s' driver exited in %llu %s",
+			      ew_drivers[i]->name,
+			      (unsigned long long)ewtrace_to_us(ewtrace_now() -
+								begin),
+			      ewtrace_frequency() ? "us" : "ticks");
 	}
 
+	release();
 	return EFI_SUCCESS;
 }
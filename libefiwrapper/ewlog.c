@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewevent.h>
+#include <ewlog.h>
+#include <ewtrace.h>
+
+#include "lib.h"
+
+#if EWLOG_RING_SIZE & (EWLOG_RING_SIZE - 1)
+#error "EWLOG_RING_SIZE must be a power of two"
+#endif
+
+#define MAX_MODULES		16
+#define MODULE_NAME_SIZE	24
+#define FLUSH_THRESHOLD		(EWLOG_RING_SIZE * 3 / 4)
+
+typedef struct entry {
+	UINT64 timestamp;
+	ewlog_site_t *site;
+	UINT32 level;
+	UINT32 lap;		/* Ring lap of the entry, 0 while written */
+	char msg[EWLOG_MSG_SIZE];
+} entry_t;
+
+static struct module {
+	char name[MODULE_NAME_SIZE];
+	UINT32 level;
+} modules[MAX_MODULES];
+static UINTN nb_modules;
+static UINT32 default_level = DEBUG_MESSAGES ? EWLOG_DEBUG : EWLOG_ERROR;
+UINT32 ewlog_generation = 1;
+
+static entry_t ring[EWLOG_RING_SIZE];
+static UINTN head;		/* Number of entries ever added */
+static UINTN tail;		/* Number of entries drained or lost */
+static BOOLEAN started;
+static char draining;
+static EFI_EVENT exit_bs_event;
+
+static const char *LEVEL_NAMES[] = {
+	"error", "warning", "info", "debug", "verbose"
+};
+
+static UINT32 lap_of(UINTN index)
+{
+	return (UINT32)(index / EWLOG_RING_SIZE + 1);
+}
+
+/* Base name of FILE without its extension */
+static const char *module_name(const char *file, size_t *len)
+{
+	const char *p, *name = file, *dot = NULL;
+
+	for (p = file; *p; p++) {
+		if (*p == '/' || *p == '\\') {
+			name = p + 1;
+			dot = NULL;
+		} else if (*p == '.')
+			dot = p;
+	}
+
+	*len = (dot ? dot : p) - name;
+	return name;
+}
+
+void ewlog_resolve(ewlog_site_t *site)
+{
+	UINT32 generation, level;
+	const char *name;
+	size_t len;
+	UINTN i;
+
+	generation = __atomic_load_n(&ewlog_generation, __ATOMIC_ACQUIRE);
+	level = default_level;
+	name = module_name(site->module, &len);
+	for (i = 0; i < nb_modules; i++)
+		if (!strncmp(modules[i].name, name, len) &&
+		    modules[i].name[len] == '\0')
+			level = modules[i].level;
+
+	site->level = level;
+	site->generation = generation;
+}
+
+EFI_STATUS ewlog_set_level(const char *module, ewlog_level_t level)
+{
+	UINTN i;
+
+	if (level > EWLOG_VERBOSE)
+		return EFI_INVALID_PARAMETER;
+
+	if (!module) {
+		default_level = level;
+		goto out;
+	}
+
+	if (strlen(module) >= MODULE_NAME_SIZE)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < nb_modules; i++)
+		if (!strcmp(modules[i].name, module))
+			break;
+
+	if (i == nb_modules) {
+		if (nb_modules == MAX_MODULES)
+			return EFI_OUT_OF_RESOURCES;
+		memcpy(modules[i].name, module, strlen(module) + 1);
+		nb_modules++;
+	}
+	modules[i].level = level;
+
+out:
+	__atomic_add_fetch(&ewlog_generation, 1, __ATOMIC_RELEASE);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS parse_level(const char *str, size_t len,
+			      ewlog_level_t *level)
+{
+	UINTN i;
+
+	if (len == 1 && *str >= '0' && *str <= '0' + EWLOG_VERBOSE) {
+		*level = *str - '0';
+		return EFI_SUCCESS;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(LEVEL_NAMES); i++)
+		if (strlen(LEVEL_NAMES[i]) == len &&
+		    !strncmp(LEVEL_NAMES[i], str, len)) {
+			*level = i;
+			return EFI_SUCCESS;
+		}
+
+	return EFI_INVALID_PARAMETER;
+}
+
+EFI_STATUS ewlog_configure(const char *config)
+{
+	char module[MODULE_NAME_SIZE];
+	const char *cur, *end, *sep;
+	ewlog_level_t level;
+	EFI_STATUS ret;
+
+	if (!config)
+		return EFI_INVALID_PARAMETER;
+
+	for (cur = config; *cur; cur = *end ? end + 1 : end) {
+		for (end = cur, sep = NULL; *end && *end != ','; end++)
+			if (*end == ':')
+				sep = end;
+
+		if (!sep) {
+			ret = parse_level(cur, end - cur, &level);
+			if (EFI_ERROR(ret))
+				return ret;
+			ret = ewlog_set_level(NULL, level);
+			if (EFI_ERROR(ret))
+				return ret;
+			continue;
+		}
+
+		if (sep == cur || (size_t)(sep - cur) >= sizeof(module))
+			return EFI_INVALID_PARAMETER;
+		memcpy(module, cur, sep - cur);
+		module[sep - cur] = '\0';
+
+		ret = parse_level(sep + 1, end - sep - 1, &level);
+		if (EFI_ERROR(ret))
+			return ret;
+		ret = ewlog_set_level(module, level);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static void print(ewlog_site_t *site, UINT64 timestamp, const char *msg)
+{
+	const char *name;
+	size_t len;
+
+	name = module_name(site->module, &len);
+	printf(EWLOG_PREFIX "[%llu] %.*s: %s\n",
+	       (unsigned long long)ewtrace_to_us(timestamp), (int)len, name,
+	       msg);
+}
+
+BOOLEAN ewlog_pending(void)
+{
+	return __atomic_load_n(&head, __ATOMIC_ACQUIRE) != tail;
+}
+
+void ewlog_flush(void)
+{
+	UINTN last, lost = 0;
+	entry_t *entry, copy;
+	UINT32 lap;
+
+	/* A single drainer at a time, the others leave it the work */
+	if (__atomic_test_and_set(&draining, __ATOMIC_ACQUIRE))
+		return;
+
+	last = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	if (last - tail > EWLOG_RING_SIZE) {
+		lost += last - EWLOG_RING_SIZE - tail;
+		tail = last - EWLOG_RING_SIZE;
+	}
+
+	for (; tail < last; tail++) {
+		entry = &ring[tail & (EWLOG_RING_SIZE - 1)];
+		lap = __atomic_load_n(&entry->lap, __ATOMIC_ACQUIRE);
+		/* Still being written, drained next time */
+		if (lap == 0 || lap < lap_of(tail))
+			break;
+		if (lap != lap_of(tail)) {
+			lost++;
+			continue;
+		}
+
+		memcpy(&copy, entry, sizeof(copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&entry->lap, __ATOMIC_RELAXED) != lap) {
+			lost++;
+			continue;
+		}
+
+		print(copy.site, copy.timestamp, copy.msg);
+	}
+
+	if (lost)
+		printf(EWLOG_PREFIX "%llu log messages lost\n",
+		       (unsigned long long)lost);
+
+	__atomic_clear(&draining, __ATOMIC_RELEASE);
+}
+
+void ewlog_add(ewlog_site_t *site, ewlog_level_t level, const char *fmt, ...)
+{
+	char msg[EWLOG_MSG_SIZE];
+	entry_t *entry;
+	UINTN index;
+	va_list args;
+
+	if (!__atomic_load_n(&started, __ATOMIC_ACQUIRE)) {
+		va_start(args, fmt);
+		vsnprintf(msg, sizeof(msg), fmt, args);
+		va_end(args);
+		print(site, ewtrace_now(), msg);
+		return;
+	}
+
+	index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+	entry = &ring[index & (EWLOG_RING_SIZE - 1)];
+
+	__atomic_store_n(&entry->lap, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	entry->timestamp = ewtrace_now();
+	entry->site = site;
+	entry->level = level;
+	va_start(args, fmt);
+	vsnprintf(entry->msg, sizeof(entry->msg), fmt, args);
+	va_end(args);
+	__atomic_store_n(&entry->lap, lap_of(index), __ATOMIC_RELEASE);
+
+	/* Errors may precede a crash */
+	if (level == EWLOG_ERROR ||
+	    index - __atomic_load_n(&tail, __ATOMIC_RELAXED) >= FLUSH_THRESHOLD)
+		ewlog_flush();
+}
+
+static EFIAPI VOID
+flush_on_exit(__attribute__((__unused__)) EFI_EVENT Event,
+	      __attribute__((__unused__)) VOID *Context)
+{
+	/* No more idle time to drain the ring */
+	__atomic_store_n(&started, FALSE, __ATOMIC_RELEASE);
+	ewlog_flush();
+}
+
+EFI_STATUS ewlog_init(EFI_SYSTEM_TABLE *st)
+{
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices)
+		return EFI_INVALID_PARAMETER;
+
+	ret = uefi_call_wrapper(st->BootServices->CreateEventEx, 6,
+				EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				flush_on_exit, NULL, &exit_bs_group,
+				&exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	__atomic_store_n(&started, TRUE, __ATOMIC_RELEASE);
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS ewlog_free(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices)
+		return EFI_INVALID_PARAMETER;
+
+	__atomic_store_n(&started, FALSE, __ATOMIC_RELEASE);
+	ewlog_flush();
+
+	if (!exit_bs_event)
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(st->BootServices->CloseEvent, 1,
+				exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	exit_bs_event = NULL;
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewevent.h>
+#include <ewlog.h>
+#include <ewprof.h>
+#include <ewtrace.h>
+
+#include "lib.h"
+
+#define MAX_SITES	512	/* Power of two */
+#define REPORT_SITES	20
+
+typedef struct stats {
+	UINT64 calls;
+	UINT64 total;		/* In trace clock ticks */
+	UINT64 max;
+} stats_t;
+
+typedef struct service {
+	const char *name;
+	stats_t stats;
+} service_t;
+
+/* Calls of a service from a given return address */
+typedef struct site {
+	service_t *service;
+	VOID *caller;
+	stats_t stats;
+} site_t;
+
+static EFI_BOOT_SERVICES saved_bs;
+static EFI_RUNTIME_SERVICES saved_rs;
+static site_t sites[MAX_SITES];
+static UINT64 lost_calls;	/* Calls from sites which did not fit */
+static char busy;
+static EFI_EVENT exit_bs_event;
+static BOOLEAN started, reported;
+
+/* The services may be called from the host timer thread.  The lock is
+ * only held to update the counters. */
+static void lock(void)
+{
+	while (__atomic_test_and_set(&busy, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void unlock(void)
+{
+	__atomic_clear(&busy, __ATOMIC_RELEASE);
+}
+
+static void stats_add(stats_t *stats, UINT64 elapsed)
+{
+	stats->calls++;
+	stats->total += elapsed;
+	if (elapsed > stats->max)
+		stats->max = elapsed;
+}
+
+static site_t *get_site(service_t *service, VOID *caller)
+{
+	UINTN i, hash;
+	site_t *site;
+
+	hash = ((UINTN)caller ^ ((UINTN)service >> 4)) * 2654435761U;
+	for (i = 0; i < MAX_SITES; i++) {
+		site = &sites[(hash + i) & (MAX_SITES - 1)];
+		if (!site->service) {
+			site->service = service;
+			site->caller = caller;
+			return site;
+		}
+		if (site->service == service && site->caller == caller)
+			return site;
+	}
+
+	return NULL;
+}
+
+static void account(service_t *service, VOID *caller, UINT64 start)
+{
+	UINT64 elapsed = ewtrace_now() - start;
+	site_t *site;
+
+	lock();
+	stats_add(&service->stats, elapsed);
+	site = get_site(service, caller);
+	if (site)
+		stats_add(&site->stats, elapsed);
+	else
+		lost_calls++;
+	unlock();
+}
+
+#define PROFILE(table, type, field, nb, params, ...)			\
+	static service_t field##_service = { .name = #field };		\
+	static EFIAPI type prof_##field params				\
+	{								\
+		UINT64 start = ewtrace_now();				\
+		type ret;						\
+									\
+		ret = uefi_call_wrapper(saved_##table.field, nb,	\
+					__VA_ARGS__);			\
+		account(&field##_service, __builtin_return_address(0),	\
+			start);						\
+		return ret;						\
+	}
+
+#define PROFILE_VOID(table, field, nb, params, ...)			\
+	static service_t field##_service = { .name = #field };		\
+	static EFIAPI VOID prof_##field params				\
+	{								\
+		UINT64 start = ewtrace_now();				\
+									\
+		uefi_call_wrapper(saved_##table.field, nb, __VA_ARGS__); \
+		account(&field##_service, __builtin_return_address(0),	\
+			start);						\
+	}
+
+PROFILE(bs, EFI_TPL, RaiseTPL, 1, (EFI_TPL NewTpl), NewTpl)
+PROFILE_VOID(bs, RestoreTPL, 1, (EFI_TPL OldTpl), OldTpl)
+PROFILE(bs, EFI_STATUS, AllocatePages, 4,
+	(EFI_ALLOCATE_TYPE Type, EFI_MEMORY_TYPE MemoryType, UINTN NoPages,
+	 EFI_PHYSICAL_ADDRESS *Memory),
+	Type, MemoryType, NoPages, Memory)
+PROFILE(bs, EFI_STATUS, FreePages, 2,
+	(EFI_PHYSICAL_ADDRESS Memory, UINTN NoPages), Memory, NoPages)
+PROFILE(bs, EFI_STATUS, GetMemoryMap, 5,
+	(UINTN *MemoryMapSize, EFI_MEMORY_DESCRIPTOR *MemoryMap,
+	 UINTN *MapKey, UINTN *DescriptorSize, UINT32 *DescriptorVersion),
+	MemoryMapSize, MemoryMap, MapKey, DescriptorSize, DescriptorVersion)
+PROFILE(bs, EFI_STATUS, AllocatePool, 3,
+	(EFI_MEMORY_TYPE PoolType, UINTN Size, VOID **Buffer),
+	PoolType, Size, Buffer)
+PROFILE(bs, EFI_STATUS, FreePool, 1, (VOID *Buffer), Buffer)
+PROFILE(bs, EFI_STATUS, CreateEvent, 5,
+	(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+	 VOID *NotifyContext, EFI_EVENT *Event),
+	Type, NotifyTpl, NotifyFunction, NotifyContext, Event)
+PROFILE(bs, EFI_STATUS, SetTimer, 3,
+	(EFI_EVENT Event, EFI_TIMER_DELAY Type, UINT64 TriggerTime),
+	Event, Type, TriggerTime)
+PROFILE(bs, EFI_STATUS, WaitForEvent, 3,
+	(UINTN NumberOfEvents, EFI_EVENT *Event, UINTN *Index),
+	NumberOfEvents, Event, Index)
+PROFILE(bs, EFI_STATUS, SignalEvent, 1, (EFI_EVENT Event), Event)
+PROFILE(bs, EFI_STATUS, CloseEvent, 1, (EFI_EVENT Event), Event)
+PROFILE(bs, EFI_STATUS, CheckEvent, 1, (EFI_EVENT Event), Event)
+PROFILE(bs, EFI_STATUS, InstallProtocolInterface, 4,
+	(EFI_HANDLE *Handle, EFI_GUID *Protocol,
+	 EFI_INTERFACE_TYPE InterfaceType, VOID *Interface),
+	Handle, Protocol, InterfaceType, Interface)
+PROFILE(bs, EFI_STATUS, ReinstallProtocolInterface, 4,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *OldInterface,
+	 VOID *NewInterface),
+	Handle, Protocol, OldInterface, NewInterface)
+PROFILE(bs, EFI_STATUS, UninstallProtocolInterface, 3,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *Interface),
+	Handle, Protocol, Interface)
+PROFILE(bs, EFI_STATUS, HandleProtocol, 3,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface),
+	Handle, Protocol, Interface)
+PROFILE(bs, EFI_STATUS, PCHandleProtocol, 3,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface),
+	Handle, Protocol, Interface)
+PROFILE(bs, EFI_STATUS, RegisterProtocolNotify, 3,
+	(EFI_GUID *Protocol, EFI_EVENT Event, VOID **Registration),
+	Protocol, Event, Registration)
+PROFILE(bs, EFI_STATUS, LocateHandle, 5,
+	(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol,
+	 VOID *SearchKey, UINTN *BufferSize, EFI_HANDLE *Buffer),
+	SearchType, Protocol, SearchKey, BufferSize, Buffer)
+PROFILE(bs, EFI_STATUS, LocateDevicePath, 3,
+	(EFI_GUID *Protocol, EFI_DEVICE_PATH **DevicePath,
+	 EFI_HANDLE *Device),
+	Protocol, DevicePath, Device)
+PROFILE(bs, EFI_STATUS, InstallConfigurationTable, 2,
+	(EFI_GUID *Guid, VOID *Table), Guid, Table)
+PROFILE(bs, EFI_STATUS, LoadImage, 6,
+	(BOOLEAN BootPolicy, EFI_HANDLE ParentImageHandle,
+	 EFI_DEVICE_PATH *FilePath, VOID *SourceBuffer, UINTN SourceSize,
+	 EFI_HANDLE *ImageHandle),
+	BootPolicy, ParentImageHandle, FilePath, SourceBuffer, SourceSize,
+	ImageHandle)
+PROFILE(bs, EFI_STATUS, StartImage, 3,
+	(EFI_HANDLE ImageHandle, UINTN *ExitDataSize, CHAR16 **ExitData),
+	ImageHandle, ExitDataSize, ExitData)
+PROFILE(bs, EFI_STATUS, Exit, 4,
+	(EFI_HANDLE ImageHandle, EFI_STATUS ExitStatus, UINTN ExitDataSize,
+	 CHAR16 *ExitData),
+	ImageHandle, ExitStatus, ExitDataSize, ExitData)
+PROFILE(bs, EFI_STATUS, UnloadImage, 1, (EFI_HANDLE ImageHandle),
+	ImageHandle)
+PROFILE(bs, EFI_STATUS, ExitBootServices, 2,
+	(EFI_HANDLE ImageHandle, UINTN MapKey), ImageHandle, MapKey)
+PROFILE(bs, EFI_STATUS, GetNextMonotonicCount, 1, (UINT64 *Count), Count)
+PROFILE(bs, EFI_STATUS, Stall, 1, (UINTN Microseconds), Microseconds)
+PROFILE(bs, EFI_STATUS, SetWatchdogTimer, 4,
+	(UINTN Timeout, UINT64 WatchdogCode, UINTN DataSize,
+	 CHAR16 *WatchdogData),
+	Timeout, WatchdogCode, DataSize, WatchdogData)
+PROFILE(bs, EFI_STATUS, ConnectController, 4,
+	(EFI_HANDLE ControllerHandle, EFI_HANDLE *DriverImageHandle,
+	 EFI_DEVICE_PATH *RemainingDevicePath, BOOLEAN Recursive),
+	ControllerHandle, DriverImageHandle, RemainingDevicePath, Recursive)
+PROFILE(bs, EFI_STATUS, DisconnectController, 3,
+	(EFI_HANDLE ControllerHandle, EFI_HANDLE DriverImageHandle,
+	 EFI_HANDLE ChildHandle),
+	ControllerHandle, DriverImageHandle, ChildHandle)
+PROFILE(bs, EFI_STATUS, OpenProtocol, 6,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface,
+	 EFI_HANDLE AgentHandle, EFI_HANDLE ControllerHandle,
+	 UINT32 Attributes),
+	Handle, Protocol, Interface, AgentHandle, ControllerHandle, Attributes)
+PROFILE(bs, EFI_STATUS, CloseProtocol, 4,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol, EFI_HANDLE AgentHandle,
+	 EFI_HANDLE ControllerHandle),
+	Handle, Protocol, AgentHandle, ControllerHandle)
+PROFILE(bs, EFI_STATUS, OpenProtocolInformation, 4,
+	(EFI_HANDLE Handle, EFI_GUID *Protocol,
+	 EFI_OPEN_PROTOCOL_INFORMATION_ENTRY **EntryBuffer,
+	 UINTN *EntryCount),
+	Handle, Protocol, EntryBuffer, EntryCount)
+PROFILE(bs, EFI_STATUS, ProtocolsPerHandle, 3,
+	(EFI_HANDLE Handle, EFI_GUID ***ProtocolBuffer,
+	 UINTN *ProtocolBufferCount),
+	Handle, ProtocolBuffer, ProtocolBufferCount)
+PROFILE(bs, EFI_STATUS, LocateHandleBuffer, 5,
+	(EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol,
+	 VOID *SearchKey, UINTN *NoHandles, EFI_HANDLE **Buffer),
+	SearchType, Protocol, SearchKey, NoHandles, Buffer)
+PROFILE(bs, EFI_STATUS, LocateProtocol, 3,
+	(EFI_GUID *Protocol, VOID *Registration, VOID **Interface),
+	Protocol, Registration, Interface)
+PROFILE(bs, EFI_STATUS, CalculateCrc32, 3,
+	(VOID *Data, UINTN DataSize, UINT32 *Crc32), Data, DataSize, Crc32)
+PROFILE_VOID(bs, CopyMem, 3, (VOID *Destination, VOID *Source, UINTN Length),
+	     Destination, Source, Length)
+PROFILE_VOID(bs, SetMem, 3, (VOID *Buffer, UINTN Size, UINT8 Value),
+	     Buffer, Size, Value)
+PROFILE(bs, EFI_STATUS, CreateEventEx, 6,
+	(UINT32 Type, EFI_TPL NotifyTpl, EFI_EVENT_NOTIFY NotifyFunction,
+	 const VOID *NotifyContext, const EFI_GUID *EventGroup,
+	 EFI_EVENT *Event),
+	Type, NotifyTpl, NotifyFunction, NotifyContext, EventGroup, Event)
+
+PROFILE(rs, EFI_STATUS, GetTime, 2,
+	(EFI_TIME *Time, EFI_TIME_CAPABILITIES *Capabilities),
+	Time, Capabilities)
+PROFILE(rs, EFI_STATUS, SetTime, 1, (EFI_TIME *Time), Time)
+PROFILE(rs, EFI_STATUS, GetWakeupTime, 3,
+	(BOOLEAN *Enabled, BOOLEAN *Pending, EFI_TIME *Time),
+	Enabled, Pending, Time)
+PROFILE(rs, EFI_STATUS, SetWakeupTime, 2, (BOOLEAN Enable, EFI_TIME *Time),
+	Enable, Time)
+PROFILE(rs, EFI_STATUS, SetVirtualAddressMap, 4,
+	(UINTN MemoryMapSize, UINTN DescriptorSize, UINT32 DescriptorVersion,
+	 EFI_MEMORY_DESCRIPTOR *VirtualMap),
+	MemoryMapSize, DescriptorSize, DescriptorVersion, VirtualMap)
+PROFILE(rs, EFI_STATUS, ConvertPointer, 2,
+	(UINTN DebugDisposition, VOID **Address), DebugDisposition, Address)
+PROFILE(rs, EFI_STATUS, GetVariable, 5,
+	(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 *Attributes,
+	 UINTN *DataSize, VOID *Data),
+	VariableName, VendorGuid, Attributes, DataSize, Data)
+PROFILE(rs, EFI_STATUS, GetNextVariableName, 3,
+	(UINTN *VariableNameSize, CHAR16 *VariableName, EFI_GUID *VendorGuid),
+	VariableNameSize, VariableName, VendorGuid)
+PROFILE(rs, EFI_STATUS, SetVariable, 5,
+	(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
+	 UINTN DataSize, VOID *Data),
+	VariableName, VendorGuid, Attributes, DataSize, Data)
+PROFILE(rs, EFI_STATUS, GetNextHighMonotonicCount, 1, (UINT32 *HighCount),
+	HighCount)
+PROFILE(rs, EFI_STATUS, ResetSystem, 4,
+	(EFI_RESET_TYPE ResetType, EFI_STATUS ResetStatus, UINTN DataSize,
+	 CHAR16 *ResetData),
+	ResetType, ResetStatus, DataSize, ResetData)
+PROFILE(rs, EFI_STATUS, UpdateCapsule, 3,
+	(EFI_CAPSULE_HEADER **CapsuleHeaderArray, UINTN CapsuleCount,
+	 EFI_PHYSICAL_ADDRESS ScatterGatherList),
+	CapsuleHeaderArray, CapsuleCount, ScatterGatherList)
+PROFILE(rs, EFI_STATUS, QueryCapsuleCapabilities, 4,
+	(EFI_CAPSULE_HEADER **CapsuleHeaderArray, UINTN CapsuleCount,
+	 UINT64 *MaximumCapsuleSize, EFI_RESET_TYPE *ResetType),
+	CapsuleHeaderArray, CapsuleCount, MaximumCapsuleSize, ResetType)
+PROFILE(rs, EFI_STATUS, QueryVariableInfo, 4,
+	(UINT32 Attributes, UINT64 *MaximumVariableStorageSize,
+	 UINT64 *RemainingVariableStorageSize, UINT64 *MaximumVariableSize),
+	Attributes, MaximumVariableStorageSize, RemainingVariableStorageSize,
+	MaximumVariableSize)
+
+/* The variadic InstallMultipleProtocolInterfaces() and
+ * UninstallMultipleProtocolInterfaces() cannot be forwarded */
+#define BOOT_SERVICES(S)						\
+	S(RaiseTPL) S(RestoreTPL) S(AllocatePages) S(FreePages)		\
+	S(GetMemoryMap) S(AllocatePool) S(FreePool) S(CreateEvent)	\
+	S(SetTimer) S(WaitForEvent) S(SignalEvent) S(CloseEvent)	\
+	S(CheckEvent) S(InstallProtocolInterface)			\
+	S(ReinstallProtocolInterface) S(UninstallProtocolInterface)	\
+	S(HandleProtocol) S(PCHandleProtocol) S(RegisterProtocolNotify) \
+	S(LocateHandle) S(LocateDevicePath) S(InstallConfigurationTable) \
+	S(LoadImage) S(StartImage) S(Exit) S(UnloadImage)		\
+	S(ExitBootServices) S(GetNextMonotonicCount) S(Stall)		\
+	S(SetWatchdogTimer) S(ConnectController) S(DisconnectController) \
+	S(OpenProtocol) S(CloseProtocol) S(OpenProtocolInformation)	\
+	S(ProtocolsPerHandle) S(LocateHandleBuffer) S(LocateProtocol)	\
+	S(CalculateCrc32) S(CopyMem) S(SetMem) S(CreateEventEx)
+
+#define RUNTIME_SERVICES(S)						\
+	S(GetTime) S(SetTime) S(GetWakeupTime) S(SetWakeupTime)		\
+	S(SetVirtualAddressMap) S(ConvertPointer) S(GetVariable)	\
+	S(GetNextVariableName) S(SetVariable)				\
+	S(GetNextHighMonotonicCount) S(ResetSystem) S(UpdateCapsule)	\
+	S(QueryCapsuleCapabilities) S(QueryVariableInfo)
+
+#define SERVICE(field) &field##_service,
+static service_t *services[] = {
+	BOOT_SERVICES(SERVICE)
+	RUNTIME_SERVICES(SERVICE)
+};
+
+static BOOLEAN heavier(stats_t *a, stats_t *b)
+{
+	if (a->total != b->total)
+		return a->total > b->total;
+	return a->calls > b->calls;
+}
+
+void ewprof_report(void)
+{
+	static site_t *sorted[MAX_SITES];
+	static site_t snapshot[MAX_SITES];
+	service_t *service, *tmp_service;
+	const char *unit;
+	UINTN i, j, nb;
+	site_t *tmp;
+
+	unit = ewtrace_frequency() ? "us" : "ticks";
+
+	lock();
+	memcpy(snapshot, sites, sizeof(snapshot));
+	unlock();
+
+	/* Services by decreasing cumulative time */
+	for (i = 1; i < ARRAY_SIZE(services); i++)
+		for (j = i; j > 0 && heavier(&services[j]->stats,
+					    &services[j - 1]->stats); j--) {
+			tmp_service = services[j];
+			services[j] = services[j - 1];
+			services[j - 1] = tmp_service;
+		}
+
+	/* The report was explicitly asked for: print it whatever the log
+	 * level, after the pending messages */
+	ewlog_flush();
+
+	printf(EWLOG_PREFIX "Services profile (%s):\n", unit);
+	for (i = 0; i < ARRAY_SIZE(services); i++) {
+		service = services[i];
+		if (!service->stats.calls)
+			continue;
+		printf(EWLOG_PREFIX "  %-28s %8llu calls, total %10llu, "
+		       "avg %8llu, max %8llu\n",
+		       service->name, (unsigned long long)service->stats.calls,
+		       (unsigned long long)ewtrace_to_us(service->stats.total),
+		       (unsigned long long)ewtrace_to_us(service->stats.total /
+							 service->stats.calls),
+		       (unsigned long long)ewtrace_to_us(service->stats.max));
+	}
+
+	for (i = 0, nb = 0; i < MAX_SITES; i++) {
+		if (!snapshot[i].service)
+			continue;
+		sorted[nb] = &snapshot[i];
+		for (j = nb++; j > 0 && heavier(&sorted[j]->stats,
+					       &sorted[j - 1]->stats); j--) {
+			tmp = sorted[j];
+			sorted[j] = sorted[j - 1];
+			sorted[j - 1] = tmp;
+		}
+	}
+
+	printf(EWLOG_PREFIX "Top callers (%s):\n", unit);
+	for (i = 0; i < nb && i < REPORT_SITES; i++)
+		printf(EWLOG_PREFIX "  %p %-28s %8llu calls, total %10llu, "
+		       "max %8llu\n",
+		       sorted[i]->caller, sorted[i]->service->name,
+		       (unsigned long long)sorted[i]->stats.calls,
+		       (unsigned long long)ewtrace_to_us(sorted[i]->stats.total),
+		       (unsigned long long)ewtrace_to_us(sorted[i]->stats.max));
+	if (lost_calls)
+		printf(EWLOG_PREFIX "  %llu calls from untracked callers\n",
+		       (unsigned long long)lost_calls);
+}
+
+static EFIAPI VOID
+report_on_exit(__attribute__((__unused__)) EFI_EVENT Event,
+	       __attribute__((__unused__)) VOID *Context)
+{
+	ewprof_report();
+	reported = TRUE;
+}
+
+static EFI_STATUS update_crc(EFI_TABLE_HEADER *hdr, size_t size)
+{
+	hdr->CRC32 = 0;
+	return crc32((void *)hdr, size, &hdr->CRC32);
+}
+
+EFI_STATUS ewprof_start(EFI_SYSTEM_TABLE *st)
+{
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+	EFI_BOOT_SERVICES *bs;
+	EFI_RUNTIME_SERVICES *rs;
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices || !st->RuntimeServices)
+		return EFI_INVALID_PARAMETER;
+
+	if (started)
+		return EFI_ALREADY_STARTED;
+
+	bs = st->BootServices;
+	rs = st->RuntimeServices;
+
+	ret = uefi_call_wrapper(bs->CreateEventEx, 6,
+				EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				report_on_exit, NULL, &exit_bs_group,
+				&exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	memcpy(&saved_bs, bs, sizeof(saved_bs));
+	memcpy(&saved_rs, rs, sizeof(saved_rs));
+
+#define INTERPOSE_BS(field)			\
+	if (saved_bs.field)			\
+		bs->field = prof_##field;
+#define INTERPOSE_RS(field)			\
+	if (saved_rs.field)			\
+		rs->field = prof_##field;
+	BOOT_SERVICES(INTERPOSE_BS)
+	RUNTIME_SERVICES(INTERPOSE_RS)
+
+	started = TRUE;
+	reported = FALSE;
+
+	ret = update_crc(&bs->Hdr, sizeof(*bs));
+	if (EFI_ERROR(ret))
+		return ret;
+
+	return update_crc(&rs->Hdr, sizeof(*rs));
+}
+
+EFI_STATUS ewprof_stop(EFI_SYSTEM_TABLE *st)
+{
+	EFI_BOOT_SERVICES *bs;
+	EFI_RUNTIME_SERVICES *rs;
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices || !st->RuntimeServices)
+		return EFI_INVALID_PARAMETER;
+
+	if (!started)
+		return EFI_NOT_STARTED;
+
+	bs = st->BootServices;
+	rs = st->RuntimeServices;
+
+	/* Entries swapped again by somebody else are left as is */
+#define RESTORE_BS(field)			\
+	if (bs->field == prof_##field)		\
+		bs->field = saved_bs.field;
+#define RESTORE_RS(field)			\
+	if (rs->field == prof_##field)		\
+		rs->field = saved_rs.field;
+	BOOT_SERVICES(RESTORE_BS)
+	RUNTIME_SERVICES(RESTORE_RS)
+
+	started = FALSE;
+
+	ret = update_crc(&bs->Hdr, sizeof(*bs));
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = update_crc(&rs->Hdr, sizeof(*rs));
+	if (EFI_ERROR(ret))
+		return ret;
+
+	if (!reported)
+		ewprof_report();
+
+	ret = uefi_call_wrapper(bs->CloseEvent, 1, exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	exit_bs_event = NULL;
+	return EFI_SUCCESS;
+}
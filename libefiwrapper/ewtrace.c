@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewevent.h>
+#include <ewlog.h>
+#include <ewtrace.h>
+
+#include "lib.h"
+
+#if EWTRACE_RING_SIZE & (EWTRACE_RING_SIZE - 1)
+#error "EWTRACE_RING_SIZE must be a power of two"
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+static UINT64 tsc(void)
+{
+	return __builtin_ia32_rdtsc();
+}
+#define DEFAULT_CLOCK	tsc
+#else
+#define DEFAULT_CLOCK	NULL
+#endif
+
+#ifdef TRACE_EVENTS
+#define TRACING		TRUE
+#else
+#define TRACING		FALSE
+#endif
+
+static ewtrace_record_t ring[EWTRACE_RING_SIZE];
+static UINTN head;		/* Number of records ever added */
+static UINT64 (*trace_clock)(void) = DEFAULT_CLOCK;
+static UINT64 frequency;
+static UINT32 (*trace_thread_id)(void);
+
+static UINT16 lap_of(UINTN index)
+{
+	return (UINT16)(index / EWTRACE_RING_SIZE + 1);
+}
+
+void ewtrace_add(ewtrace_type_t type, const char *name, UINT32 arg)
+{
+	ewtrace_record_t *record;
+	UINTN index;
+
+	index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+	record = &ring[index & (EWTRACE_RING_SIZE - 1)];
+
+	/* The lap is cleared while the record is being written so that
+	 * a concurrent snapshot skips it */
+	__atomic_store_n(&record->lap, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	record->timestamp = ewtrace_now();
+	record->name = name;
+	record->arg = arg;
+	record->tid = trace_thread_id ? trace_thread_id() : 0;
+	record->type = type;
+	__atomic_store_n(&record->lap, lap_of(index), __ATOMIC_RELEASE);
+}
+
+void ewtrace_set_clock(UINT64 (*now)(void), UINT64 freq)
+{
+	trace_clock = now;
+	frequency = freq;
+}
+
+void ewtrace_set_thread_id(UINT32 (*thread_id)(void))
+{
+	trace_thread_id = thread_id;
+}
+
+UINT64 ewtrace_now(void)
+{
+	return trace_clock ? trace_clock() : 0;
+}
+
+UINT64 ewtrace_frequency(void)
+{
+	return frequency;
+}
+
+UINT64 ewtrace_to_us(UINT64 ticks)
+{
+	if (!frequency)
+		return ticks;
+	/* Split to neither truncate the frequency nor overflow */
+	return ticks / frequency * 1000000 +
+		ticks % frequency * 1000000 / frequency;
+}
+
+UINTN ewtrace_snapshot(ewtrace_record_t *records, UINTN max)
+{
+	UINTN index, last, nb = 0;
+	ewtrace_record_t *record;
+	UINT16 lap;
+
+	last = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	index = last > EWTRACE_RING_SIZE ? last - EWTRACE_RING_SIZE : 0;
+
+	for (; index < last && nb < max; index++) {
+		record = &ring[index & (EWTRACE_RING_SIZE - 1)];
+		lap = __atomic_load_n(&record->lap, __ATOMIC_ACQUIRE);
+		if (lap != lap_of(index))
+			continue;
+
+		records[nb] = *record;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		/* Overwritten while being copied */
+		if (__atomic_load_n(&record->lap, __ATOMIC_RELAXED) != lap)
+			continue;
+		nb++;
+	}
+
+	return nb;
+}
+
+/* Return the offset of NAME in the string table STRINGS of SIZE bytes,
+ * adding it if needed, or -1 if the table is full */
+static INTN string_offset(const char **names, UINTN *nb_names,
+			  UINT16 *offsets, char *strings, UINTN *size,
+			  const char *name)
+{
+	UINTN i, len;
+
+	for (i = 0; i < *nb_names; i++)
+		if (names[i] == name)
+			return offsets[i];
+
+	len = strlen(name) + 1;
+	if (*size + len > 0x10000)
+		return -1;
+
+	names[*nb_names] = name;
+	offsets[*nb_names] = *size;
+	(*nb_names)++;
+	memcpy(strings + *size, name, len);
+	*size += len;
+
+	return offsets[*nb_names - 1];
+}
+
+EFI_STATUS ewtrace_save(EFI_SYSTEM_TABLE *st)
+{
+	static EFI_GUID guid = EWTRACE_VARIABLE_GUID;
+	EFI_STATUS ret = EFI_OUT_OF_RESOURCES;
+	ewtrace_record_t *records = NULL;
+	EWTRACE_DUMP_HEADER *header;
+	EWTRACE_DUMP_RECORD *dump;
+	UINTN i, nb, nb_names = 0, strings_size = 0;
+	const char **names = NULL;
+	UINT16 *offsets = NULL;
+	char *strings = NULL;
+	UINT8 *buf = NULL;
+	INTN offset;
+
+	if (!st)
+		return EFI_INVALID_PARAMETER;
+
+	records = malloc(EWTRACE_RING_SIZE * sizeof(*records));
+	names = malloc(EWTRACE_RING_SIZE * sizeof(*names));
+	offsets = malloc(EWTRACE_RING_SIZE * sizeof(*offsets));
+	strings = malloc(0x10000);
+	if (!records || !names || !offsets || !strings)
+		goto out;
+
+	nb = ewtrace_snapshot(records, EWTRACE_RING_SIZE);
+
+	buf = malloc(sizeof(*header) + nb * sizeof(*dump) + 0x10000);
+	if (!buf)
+		goto out;
+
+	header = (EWTRACE_DUMP_HEADER *)buf;
+	dump = (EWTRACE_DUMP_RECORD *)(header + 1);
+	for (i = 0; i < nb; i++) {
+		offset = string_offset(names, &nb_names, offsets, strings,
+				       &strings_size, records[i].name);
+		if (offset < 0)
+			break;
+
+		dump[i].Timestamp = records[i].timestamp;
+		dump[i].Arg = records[i].arg;
+		dump[i].Tid = records[i].tid;
+		dump[i].Name = offset;
+		dump[i].Type = records[i].type;
+	}
+	nb = i;
+
+	header->Magic = EWTRACE_DUMP_MAGIC;
+	header->Version = EWTRACE_DUMP_VERSION;
+	header->RecordSize = sizeof(*dump);
+	header->Frequency = frequency;
+	header->NbRecords = nb;
+	header->StringsOffset = sizeof(*header) + nb * sizeof(*dump);
+	memcpy(buf + header->StringsOffset, strings, strings_size);
+
+	ret = uefi_call_wrapper(st->RuntimeServices->SetVariable, 5,
+				EWTRACE_VARIABLE_NAME, &guid,
+				EFI_VARIABLE_BOOTSERVICE_ACCESS |
+				EFI_VARIABLE_RUNTIME_ACCESS,
+				header->StringsOffset + strings_size, buf);
+
+out:
+	free(buf);
+	free(strings);
+	free(offsets);
+	free(names);
+	free(records);
+	return ret;
+}
+
+static EFI_EVENT exit_bs_event;
+
+static EFIAPI VOID
+save_trace(__attribute__((__unused__)) EFI_EVENT Event, VOID *Context)
+{
+	EFI_STATUS ret;
+
+	ret = ewtrace_save(Context);
+	if (EFI_ERROR(ret))
+		ewerr("Failed to save the trace: %x", (UINT32)ret);
+}
+
+EFI_STATUS ewtrace_init(EFI_SYSTEM_TABLE *st)
+{
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
+
+	if (!st || !st->BootServices)
+		return EFI_INVALID_PARAMETER;
+
+	if (!TRACING)
+		return EFI_SUCCESS;
+
+	return uefi_call_wrapper(st->BootServices->CreateEventEx, 6,
+				 EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				 save_trace, st, &exit_bs_group,
+				 &exit_bs_event);
+}
+
+EFI_STATUS ewtrace_free(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices)
+		return EFI_INVALID_PARAMETER;
+
+	if (!exit_bs_event)
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(st->BootServices->CloseEvent, 1,
+				exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	exit_bs_event = NULL;
+	return EFI_SUCCESS;
+}
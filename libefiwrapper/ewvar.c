@@ -32,31 +32,64 @@
 #include "ewvar.h"
 #include "lib.h"
 
-static ewvar_t *EFI_VARS;
+#define EWVAR_HTABLE_SIZE 64
+
+static htable_t EFI_VARS;
+static ewvar_t *first_var, *last_var;
 static ewvar_storage_t *storage;
 
+typedef struct ewvar_key {
+	const CHAR16 *name;
+	EFI_GUID *guid;
+} ewvar_key_t;
+
+static UINT32 ewvar_hash(const CHAR16 *name, EFI_GUID *guid)
+{
+	return hash_buf(name, str16len(name) * sizeof(*name),
+			hash_buf(guid, sizeof(*guid), HASH_INIT));
+}
+
+static BOOLEAN ewvar_match(hnode_t *node, const void *key)
+{
+	const ewvar_key_t *k = key;
+	ewvar_t *var = (ewvar_t *)node;
+
+	return !guidcmp(&var->guid, k->guid) && !str16cmp(k->name, var->name);
+}
+
+/* The name is padded so that the inline data is suitably aligned. */
+static size_t ewvar_name_size(const CHAR16 *name)
+{
+	size_t size = (str16len(name) + 1) * sizeof(*name);
+
+	return (size + sizeof(UINT64) - 1) & ~(sizeof(UINT64) - 1);
+}
+
+static BOOLEAN ewvar_data_is_inline(ewvar_t *var)
+{
+	return var->data == (UINT8 *)var->name + ewvar_name_size(var->name);
+}
+
 ewvar_t *ewvar_new(CHAR16 *name, EFI_GUID *guid, UINT32 attr,
 		   UINTN size, VOID *data)
 {
 	EFI_STATUS ret;
 	ewvar_t *var;
+	size_t name_size;
 
-	var = calloc(1, sizeof(*var));
+	name_size = ewvar_name_size(name);
+	var = calloc(1, sizeof(*var) + name_size + size);
 	if (!var)
 		return NULL;
 
-	var->name = str16dup(name);
-	if (!var->name)
-		goto err;
+	var->name = (CHAR16 *)(var + 1);
+	memcpy(var->name, name, (str16len(name) + 1) * sizeof(*name));
+	var->data = (UINT8 *)var->name + name_size;
 
 	memcpy(&var->guid, guid, sizeof(var->guid));
 	var->attributes = attr;
 	var->size = size;
-
-	var->data = malloc(size);
-	if (!var->data)
-		goto err;
-
+	var->capacity = size;
 	memcpy(var->data, data, size);
 
 	if (attr & EFI_VARIABLE_NON_VOLATILE &&
@@ -75,10 +108,8 @@ err:
 
 void ewvar_free(ewvar_t *var)
 {
-	if (var->data)
+	if (!ewvar_data_is_inline(var))
 		free(var->data);
-	if (var->name)
-		free(var->name);
 	free(var);
 }
 
@@ -86,41 +117,54 @@ void ewvar_free_all(void)
 {
 	ewvar_t *var, *next;
 
-	for (var = EFI_VARS; var; var = next) {
+	for (var = first_var; var; var = next) {
 		next = var->next;
 		ewvar_free(var);
 	}
-	EFI_VARS = NULL;
+	first_var = last_var = NULL;
+	htable_free(&EFI_VARS);
 }
 
-void ewvar_add(ewvar_t *var)
+EFI_STATUS ewvar_add(ewvar_t *var)
 {
-	var->next = EFI_VARS;
-	EFI_VARS = var;
+	EFI_STATUS ret;
+
+	if (!EFI_VARS.buckets) {
+		ret = htable_init(&EFI_VARS, EWVAR_HTABLE_SIZE);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	htable_add(&EFI_VARS, &var->node, ewvar_hash(var->name, &var->guid));
+
+	var->next = NULL;
+	var->prev = last_var;
+	if (last_var)
+		last_var->next = var;
+	else
+		first_var = var;
+	last_var = var;
+
+	return EFI_SUCCESS;
 }
 
-ewvar_t *ewvar_get(const CHAR16 *name, EFI_GUID *guid, ewvar_t **prev_p)
+ewvar_t *ewvar_get(const CHAR16 *name, EFI_GUID *guid)
 {
-	ewvar_t *var, *prev = NULL;
+	ewvar_key_t key = { name, guid };
 
-	for (var = EFI_VARS; var; var = var->next) {
-		if (!str16cmp(name, var->name) && !guidcmp(&var->guid, guid))
-			break;
-		prev = var;
-	}
-
-	if (var && prev_p)
-		*prev_p = prev;
+	if (!EFI_VARS.buckets)
+		return NULL;
 
-	return var;
+	return (ewvar_t *)htable_find(&EFI_VARS, ewvar_hash(name, guid),
+				      ewvar_match, &key);
 }
 
 ewvar_t *ewvar_get_first(void)
 {
-	return EFI_VARS;
+	return first_var;
 }
 
-EFI_STATUS ewvar_del(ewvar_t *var, ewvar_t *prev)
+EFI_STATUS ewvar_del(ewvar_t *var)
 {
 	EFI_STATUS ret;
 	if (!var)
@@ -133,10 +177,17 @@ EFI_STATUS ewvar_del(ewvar_t *var, ewvar_t *prev)
 			return ret;
 	}
 
-	if (prev)
-		prev->next = var->next;
+	htable_del(&EFI_VARS, &var->node);
+
+	if (var->prev)
+		var->prev->next = var->next;
+	else
+		first_var = var->next;
+	if (var->next)
+		var->next->prev = var->prev;
 	else
-		EFI_VARS = var->next;
+		last_var = var->prev;
+
 	ewvar_free(var);
 
 	return EFI_SUCCESS;
@@ -144,24 +195,34 @@ EFI_STATUS ewvar_del(ewvar_t *var, ewvar_t *prev)
 
 EFI_STATUS ewvar_update(ewvar_t *var, UINTN size, VOID *data)
 {
-	if (var->attributes & EFI_VARIABLE_APPEND_WRITE) {
-		var->data = realloc(var->data, var->size + size);
-		if (!var->data)
-			return EFI_OUT_OF_RESOURCES;
-
-		memcpy((char *)var->data + var->size, data, size);
-		var->size += size;
-	} else {
-		var->data = realloc(var->data, size);
-		if (!var->data)
+	UINTN offset = 0, capacity;
+	void *buf;
+
+	if (var->attributes & EFI_VARIABLE_APPEND_WRITE)
+		offset = var->size;
+
+	/* Data which no longer fits in the inline area moves to a
+	 * separate buffer.  Appended variables grow geometrically to
+	 * avoid a copy on each write. */
+	if (offset + size > var->capacity) {
+		capacity = offset + size;
+		if (offset)
+			capacity = max(capacity, var->capacity * 2);
+
+		buf = malloc(capacity);
+		if (!buf)
 			return EFI_OUT_OF_RESOURCES;
 
-		var->size = size;
-		if (!var->data)
-			return EFI_OUT_OF_RESOURCES;
-		memcpy(var->data, data, size);
+		memcpy(buf, var->data, offset);
+		if (!ewvar_data_is_inline(var))
+			free(var->data);
+		var->data = buf;
+		var->capacity = capacity;
 	}
 
+	memcpy((char *)var->data + offset, data, size);
+	var->size = offset + size;
+
 	if (var->attributes & EFI_VARIABLE_NON_VOLATILE &&
 	    storage && storage->save)
 		return storage->save(var);
@@ -183,7 +244,18 @@ EFI_STATUS ewvar_register_storage(ewvar_storage_t *s)
 
 EFI_STATUS ewvar_unregister_storage(void)
 {
+	EFI_STATUS ret;
+
+	ret = ewvar_flush();
 	storage = NULL;
 
+	return ret;
+}
+
+EFI_STATUS ewvar_flush(void)
+{
+	if (storage && storage->flush)
+		return storage->flush();
+
 	return EFI_SUCCESS;
 }
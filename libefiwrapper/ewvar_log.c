@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ewlog.h"
+#include "ewvar.h"
+#include "ewvar_log.h"
+#include "lib.h"
+
+#define LOG_HEADER_MAGIC	0x474c5745 /* "EWLG" */
+#define LOG_RECORD_MAGIC	0x52565745 /* "EWVR" */
+#define LOG_BATCH_SIZE		4096
+#define LOG_ALIGN		8
+
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) / (a) * (a))
+
+/* First block of each half */
+typedef struct log_header {
+	UINT32 magic;
+	UINT32 crc;
+	UINT32 generation;
+	UINT32 reserved;
+} log_header_t;
+
+/* A record is followed by the variable name and data.  Records of a
+ * previous use of the same half are told apart by their generation
+ * number.  A record with no attributes is a deletion. */
+typedef struct log_record {
+	UINT32 magic;
+	UINT32 crc;
+	UINT32 generation;
+	UINT32 size;		/* Including name, data and padding */
+	UINT32 attributes;
+	UINT32 name_size;
+	UINT32 data_size;
+	UINT32 reserved;
+	EFI_GUID guid;
+} log_record_t;
+
+typedef struct log_buf {
+	UINT8 *data;
+	UINTN len;
+	UINTN size;
+} log_buf_t;
+
+static struct {
+	storage_t *storage;
+	EFI_LBA start;
+	EFI_LBA half;		/* Number of blocks of each half */
+	UINTN cur;		/* Active half */
+	UINT32 generation;
+	UINTN tail;		/* Bytes of the blocks used after the header */
+	log_buf_t wbuf;		/* Pending records */
+	BOOLEAN loading;
+} log;
+
+static UINTN log_capacity(void)
+{
+	return (log.half - 1) * log.storage->blk_sz;
+}
+
+static EFI_LBA log_lba(UINTN half)
+{
+	return log.start + half * log.half;
+}
+
+static UINTN log_pending(void)
+{
+	return log.wbuf.len;
+}
+
+static UINTN record_size(CHAR16 *name, UINTN data_size)
+{
+	return ALIGN_UP(sizeof(log_record_t) + (str16len(name) + 1) *
+			sizeof(*name) + data_size, LOG_ALIGN);
+}
+
+static EFI_STATUS log_buf_reserve(log_buf_t *b, UINTN size)
+{
+	UINTN new_size;
+	UINT8 *data;
+
+	/* Keep room to pad the buffer up to a block boundary */
+	size = ALIGN_UP(b->len + size, log.storage->blk_sz);
+	if (size <= b->size)
+		return EFI_SUCCESS;
+
+	new_size = max(size, b->size * 2);
+	data = realloc(b->data, new_size);
+	if (!data)
+		return EFI_OUT_OF_RESOURCES;
+
+	b->data = data;
+	b->size = new_size;
+
+	return EFI_SUCCESS;
+}
+
+static void record_seal(log_record_t *rec, UINT32 generation)
+{
+	rec->generation = generation;
+	rec->crc = 0;
+	crc32(rec, rec->size, &rec->crc);
+}
+
+static EFI_STATUS log_buf_append(log_buf_t *b, UINT32 generation,
+				 CHAR16 *name, EFI_GUID *guid,
+				 UINT32 attributes, void *data,
+				 UINTN data_size)
+{
+	EFI_STATUS ret;
+	log_record_t *rec;
+	UINTN size;
+
+	size = record_size(name, data_size);
+	ret = log_buf_reserve(b, size);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	rec = (log_record_t *)(b->data + b->len);
+	memset(rec, 0, size);
+	rec->magic = LOG_RECORD_MAGIC;
+	rec->size = size;
+	rec->attributes = attributes;
+	rec->name_size = (str16len(name) + 1) * sizeof(*name);
+	rec->data_size = data_size;
+	memcpy(&rec->guid, guid, sizeof(rec->guid));
+	memcpy(rec + 1, name, rec->name_size);
+	memcpy((UINT8 *)(rec + 1) + rec->name_size, data, data_size);
+	record_seal(rec, generation);
+
+	b->len += size;
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS log_write(EFI_LBA lba, log_buf_t *b)
+{
+	UINTN size;
+	EFI_LBA count;
+
+	size = ALIGN_UP(b->len, log.storage->blk_sz);
+	if (!size)
+		return EFI_SUCCESS;
+
+	memset(b->data + b->len, 0, size - b->len);
+
+	count = size / log.storage->blk_sz;
+	if (log.storage->write(log.storage, lba, count, b->data) != count)
+		return EFI_DEVICE_ERROR;
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS log_write_header(UINTN half, UINT32 generation)
+{
+	EFI_STATUS ret;
+	log_header_t *hdr;
+	log_buf_t b;
+
+	b.size = log.storage->blk_sz;
+	b.len = sizeof(*hdr);
+	b.data = calloc(1, b.size);
+	if (!b.data)
+		return EFI_OUT_OF_RESOURCES;
+
+	hdr = (log_header_t *)b.data;
+	hdr->magic = LOG_HEADER_MAGIC;
+	hdr->generation = generation;
+	crc32(hdr, sizeof(*hdr), &hdr->crc);
+
+	ret = log_write(log_lba(half), &b);
+	free(b.data);
+
+	return ret;
+}
+
+static UINTN log_live_size(void)
+{
+	ewvar_t *var;
+	UINTN size = 0;
+
+	for (var = ewvar_get_first(); var; var = var->next)
+		if (var->attributes & EFI_VARIABLE_NON_VOLATILE)
+			size += record_size(var->name, var->size);
+
+	return size;
+}
+
+/* Write a snapshot of the live variables followed by the pending
+ * records in the inactive half and make it the active one.  The
+ * pending records may describe a variable which is not yet in the
+ * variable list. */
+static EFI_STATUS log_compact(void)
+{
+	EFI_STATUS ret;
+	ewvar_t *var;
+	log_buf_t img = { NULL, 0, 0 };
+	UINTN pending, off, next = !log.cur;
+	UINT32 generation = log.generation + 1;
+	log_record_t *rec;
+
+	pending = log_pending();
+	ret = log_buf_reserve(&img, log_live_size() + pending);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	for (var = ewvar_get_first(); var; var = var->next) {
+		if (!(var->attributes & EFI_VARIABLE_NON_VOLATILE))
+			continue;
+		ret = log_buf_append(&img, generation, var->name, &var->guid,
+				     var->attributes, var->data, var->size);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+
+	off = img.len;
+	memcpy(img.data + off, log.wbuf.data, pending);
+	img.len += pending;
+	for (; off < img.len; off += rec->size) {
+		rec = (log_record_t *)(img.data + off);
+		record_seal(rec, generation);
+	}
+
+	if (img.len > log_capacity()) {
+		ewerr("Variable log is full");
+		ret = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
+
+	ret = log_write(log_lba(next) + 1, &img);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	ret = log_write_header(next, generation);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	ewdbg("Variable log compacted from %zu to %zu bytes",
+	      (size_t)(log.tail + pending), (size_t)img.len);
+
+	log.cur = next;
+	log.generation = generation;
+	log.tail = ALIGN_UP(img.len, log.storage->blk_sz);
+	free(log.wbuf.data);
+	log.wbuf = img;
+	log.wbuf.len = 0;
+
+	return EFI_SUCCESS;
+
+out:
+	free(img.data);
+	return ret;
+}
+
+/* The batch is written after the padding of the previous one, the
+ * committed blocks are never rewritten.  On error, none of the pending
+ * records has been committed. */
+static EFI_STATUS log_flush(void)
+{
+	EFI_STATUS ret;
+	UINTN size, blk_sz;
+
+	if (!log.storage)
+		return EFI_SUCCESS;
+
+	if (!log_pending())
+		return EFI_SUCCESS;
+
+	blk_sz = log.storage->blk_sz;
+	size = ALIGN_UP(log_pending(), blk_sz);
+	if (log.tail + size > log_capacity())
+		return log_compact();
+
+	ret = log_write(log_lba(log.cur) + 1 + log.tail / blk_sz, &log.wbuf);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	log.tail += size;
+	log.wbuf.len = 0;
+
+	/* Compact early rather than when the next write does not fit.
+	 * The batch is committed already, a failure is not fatal. */
+	if (log.tail > log_capacity() / 4 * 3 &&
+	    log_live_size() < log.tail / 2) {
+		ret = log_compact();
+		if (EFI_ERROR(ret))
+			ewerr("Failed to compact the variable log");
+	}
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS log_add(ewvar_t *var, UINT32 attributes)
+{
+	EFI_STATUS ret;
+	UINTN len;
+
+	if (log.loading)
+		return EFI_SUCCESS;
+
+	len = log.wbuf.len;
+	ret = log_buf_append(&log.wbuf, log.generation, var->name,
+			     &var->guid, attributes, var->data,
+			     attributes ? var->size : 0);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	if (log_pending() < LOG_BATCH_SIZE)
+		return EFI_SUCCESS;
+
+	/* Drop the rejected record so that it is neither persisted by
+	 * a later flush nor carried by the next compactions */
+	ret = log_flush();
+	if (EFI_ERROR(ret))
+		log.wbuf.len = len;
+
+	return ret;
+}
+
+static EFI_STATUS log_save(ewvar_t *var)
+{
+	return log_add(var, var->attributes);
+}
+
+static EFI_STATUS log_delete(ewvar_t *var)
+{
+	return log_add(var, 0);
+}
+
+static BOOLEAN record_is_valid(log_record_t *rec, UINTN room)
+{
+	UINT32 crc, expected;
+	CHAR16 *name;
+
+	if (room < sizeof(*rec) || rec->magic != LOG_RECORD_MAGIC ||
+	    rec->generation != log.generation ||
+	    rec->size < sizeof(*rec) || rec->size > room ||
+	    rec->size % LOG_ALIGN ||
+	    rec->name_size < sizeof(*name) || rec->name_size % sizeof(*name) ||
+	    rec->size - sizeof(*rec) < (UINTN)rec->name_size + rec->data_size)
+		return FALSE;
+
+	expected = rec->crc;
+	rec->crc = 0;
+	crc32(rec, rec->size, &crc);
+	rec->crc = expected;
+	if (crc != expected)
+		return FALSE;
+
+	name = (CHAR16 *)(rec + 1);
+	return name[rec->name_size / sizeof(*name) - 1] == '\0';
+}
+
+static EFI_STATUS log_replay(log_record_t *rec)
+{
+	EFI_STATUS ret;
+	CHAR16 *name = (CHAR16 *)(rec + 1);
+	ewvar_t *var;
+
+	var = ewvar_get(name, &rec->guid);
+	if (var) {
+		ret = ewvar_del(var);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	if (!rec->attributes)
+		return EFI_SUCCESS;
+
+	var = ewvar_new(name, &rec->guid, rec->attributes, rec->data_size,
+			(UINT8 *)name + rec->name_size);
+	if (!var)
+		return EFI_OUT_OF_RESOURCES;
+
+	ret = ewvar_add(var);
+	if (EFI_ERROR(ret))
+		ewvar_free(var);
+
+	return ret;
+}
+
+static BOOLEAN log_read_header(UINTN half, void *buf, UINT32 *generation)
+{
+	log_header_t *hdr = buf;
+	UINT32 crc, expected;
+
+	if (log.storage->read(log.storage, log_lba(half), 1, buf) != 1)
+		return FALSE;
+
+	if (hdr->magic != LOG_HEADER_MAGIC)
+		return FALSE;
+
+	expected = hdr->crc;
+	hdr->crc = 0;
+	crc32(hdr, sizeof(*hdr), &crc);
+	if (crc != expected)
+		return FALSE;
+
+	*generation = hdr->generation;
+	return TRUE;
+}
+
+/* Rebuild the variable list with a single sequential read of the
+ * active half. */
+static EFI_STATUS log_load(void)
+{
+	EFI_STATUS ret;
+	UINT8 *buf;
+	UINT32 gen[2];
+	BOOLEAN valid[2];
+	UINTN i, off, capacity = log_capacity();
+	UINTN blk_sz = log.storage->blk_sz;
+	log_record_t *rec;
+
+	buf = malloc(ALIGN_UP(capacity, LOG_ALIGN));
+	if (!buf)
+		return EFI_OUT_OF_RESOURCES;
+
+	for (i = 0; i < ARRAY_SIZE(valid); i++)
+		valid[i] = log_read_header(i, buf, &gen[i]);
+
+	if (!valid[0] && !valid[1]) {
+		ewdbg("Formatting variable log");
+		log.cur = 0;
+		log.generation = 1;
+		ret = log_write_header(log.cur, log.generation);
+		goto out;
+	}
+
+	log.cur = valid[1] && (!valid[0] || gen[1] > gen[0]);
+	log.generation = gen[log.cur];
+
+	if (log.storage->read(log.storage, log_lba(log.cur) + 1,
+			      log.half - 1, buf) != log.half - 1) {
+		ret = EFI_DEVICE_ERROR;
+		goto out;
+	}
+
+	/* A batch ends with padding up to the end of its last block */
+	log.loading = TRUE;
+	for (off = 0; off < capacity; off += rec->size) {
+		rec = (log_record_t *)(buf + off);
+		if (!record_is_valid(rec, capacity - off)) {
+			if (off % blk_sz == 0)
+				break;
+			off = ALIGN_UP(off, blk_sz);
+			rec = (log_record_t *)(buf + off);
+			if (off == capacity ||
+			    !record_is_valid(rec, capacity - off))
+				break;
+		}
+
+		ret = log_replay(rec);
+		if (EFI_ERROR(ret)) {
+			log.loading = FALSE;
+			goto out;
+		}
+	}
+	log.loading = FALSE;
+
+	log.tail = ALIGN_UP(off, blk_sz);
+	log.wbuf.len = 0;
+	ret = EFI_SUCCESS;
+
+out:
+	free(buf);
+	return ret;
+}
+
+static ewvar_storage_t log_storage = {
+	.load = log_load,
+	.save = log_save,
+	.delete = log_delete,
+	.flush = log_flush
+};
+
+EFI_STATUS ewvar_log_register(storage_t *storage, EFI_LBA start,
+			      EFI_LBA count)
+{
+	EFI_STATUS ret;
+
+	if (!storage || !storage->read || !storage->write ||
+	    storage->blk_sz < sizeof(log_header_t) ||
+	    storage->blk_sz % LOG_ALIGN || count < 4 ||
+	    start + count > storage->blk_cnt)
+		return EFI_INVALID_PARAMETER;
+
+	if (log.storage)
+		return EFI_ALREADY_STARTED;
+
+	log.storage = storage;
+	log.start = start;
+	log.half = count / 2;
+
+	ret = ewvar_register_storage(&log_storage);
+	if (EFI_ERROR(ret)) {
+		ewerr("Failed to load the variable log");
+		ewvar_log_unregister();
+	}
+
+	return ret;
+}
+
+EFI_STATUS ewvar_log_unregister(void)
+{
+	EFI_STATUS ret;
+
+	if (!log.storage)
+		return EFI_NOT_STARTED;
+
+	ret = ewvar_unregister_storage();
+	free(log.wbuf.data);
+	memset(&log, 0, sizeof(log));
+
+	return ret;
+}
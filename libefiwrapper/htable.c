@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "htable.h"
+
+EFI_STATUS htable_init(htable_t *t, size_t size)
+{
+	if (!t || !size || size & (size - 1))
+		return EFI_INVALID_PARAMETER;
+
+	t->buckets = calloc(size, sizeof(*t->buckets));
+	if (!t->buckets)
+		return EFI_OUT_OF_RESOURCES;
+
+	t->size = size;
+	t->count = 0;
+
+	return EFI_SUCCESS;
+}
+
+void htable_free(htable_t *t)
+{
+	free(t->buckets);
+	t->buckets = NULL;
+	t->size = 0;
+	t->count = 0;
+}
+
+static void htable_grow(htable_t *t)
+{
+	hnode_t **buckets, *node, *next;
+	size_t i, size = t->size * 2;
+
+	/* Growing is an optimization: on allocation failure we keep
+	 * running with longer chains. */
+	buckets = calloc(size, sizeof(*buckets));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < t->size; i++)
+		for (node = t->buckets[i]; node; node = next) {
+			next = node->next;
+			node->next = buckets[node->hash & (size - 1)];
+			buckets[node->hash & (size - 1)] = node;
+		}
+
+	free(t->buckets);
+	t->buckets = buckets;
+	t->size = size;
+}
+
+void htable_add(htable_t *t, hnode_t *node, UINT32 hash)
+{
+	hnode_t **bucket;
+
+	if (t->count >= t->size)
+		htable_grow(t);
+
+	node->hash = hash;
+	bucket = &t->buckets[hash & (t->size - 1)];
+	node->next = *bucket;
+	*bucket = node;
+	t->count++;
+}
+
+hnode_t *htable_find(htable_t *t, UINT32 hash, hmatch_t match,
+		     const void *key)
+{
+	hnode_t *node;
+
+	if (!t->buckets)
+		return NULL;
+
+	for (node = t->buckets[hash & (t->size - 1)]; node; node = node->next)
+		if (node->hash == hash && match(node, key))
+			return node;
+
+	return NULL;
+}
+
+void htable_del(htable_t *t, hnode_t *node)
+{
+	hnode_t **cur;
+
+	if (!t->buckets)
+		return;
+
+	for (cur = &t->buckets[node->hash & (t->size - 1)]; *cur;
+	     cur = &(*cur)->next)
+		if (*cur == node) {
+			*cur = node->next;
+			t->count--;
+			return;
+		}
+}
+
+/* FNV-1a */
+UINT32 hash_buf(const void *buf, size_t size, UINT32 hash)
+{
+	const UINT8 *p = buf;
+
+	while (size--) {
+		hash ^= *p++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+UINT32 hash_ptr(const void *ptr)
+{
+	UINT64 v = (UINTN)ptr;
+
+	v ^= v >> 33;
+	v *= 0xff51afd7ed558ccdULL;
+	v ^= v >> 33;
+
+	return (UINT32)v;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "event.h"
+#include "interface.h"
+#include "iostats.h"
+#include "lib.h"
+#include "media.h"
+
+typedef struct iostats_protocol {
+	EFIWRAPPER_IO_STATS_PROTOCOL interface;
+	media_t *media;
+} iostats_protocol_t;
+
+static UINTN log2_bucket(UINT64 value)
+{
+	UINTN bucket = 0;
+
+	while (value >>= 1)
+		bucket++;
+
+	return min(bucket, EFIWRAPPER_IO_HISTOGRAM_SIZE - 1);
+}
+
+UINT64 iostats_start(void)
+{
+	UINT64 now;
+
+	if (EFI_ERROR(event_now(&now)))
+		return 0;
+
+	return now;
+}
+
+void iostats_account(EFIWRAPPER_IO_STATS *stats, EFIWRAPPER_IO_TYPE type,
+		     UINT64 bytes, UINT64 start, EFI_STATUS status)
+{
+	EFIWRAPPER_IO_OP_STATS *op = &stats->Op[type];
+	UINT64 now, elapsed;
+
+	op->Operations++;
+	if (EFI_ERROR(status))
+		op->Errors++;
+	op->Bytes += bytes;
+	if (bytes)
+		op->SizeHistogram[log2_bucket(bytes)]++;
+
+	if (EFI_ERROR(event_now(&now)))
+		return;
+
+	elapsed = now - start;
+	op->TotalTime += elapsed;
+	op->MaxTime = max(op->MaxTime, elapsed);
+	op->LatencyHistogram[log2_bucket(elapsed / 10)]++;
+}
+
+static EFIAPI EFI_STATUS
+iostats_protocol_get_stats(EFIWRAPPER_IO_STATS_PROTOCOL *This,
+			   EFIWRAPPER_IO_STATS *Stats)
+{
+	media_t *media;
+	UINT64 now;
+
+	if (!This || !Stats)
+		return EFI_INVALID_PARAMETER;
+
+	media = ((iostats_protocol_t *)This)->media;
+	memcpy(Stats, &media->stats, sizeof(*Stats));
+	Stats->BlockSize = media->m.BlockSize;
+	Stats->Timed = !EFI_ERROR(event_now(&now));
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+iostats_protocol_reset_stats(EFIWRAPPER_IO_STATS_PROTOCOL *This)
+{
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	memset(&((iostats_protocol_t *)This)->media->stats, 0,
+	       sizeof(EFIWRAPPER_IO_STATS));
+
+	return EFI_SUCCESS;
+}
+
+static EFI_GUID iostats_guid = EFIWRAPPER_IO_STATS_PROTOCOL_GUID;
+
+EFI_STATUS iostats_register(EFI_SYSTEM_TABLE *st, media_t *media,
+			    EFI_HANDLE *handle)
+{
+	static iostats_protocol_t iostats_protocol_default = {
+		.interface = {
+			.Revision = EFIWRAPPER_IO_STATS_PROTOCOL_REVISION,
+			.GetStats = iostats_protocol_get_stats,
+			.ResetStats = iostats_protocol_reset_stats
+		}
+	};
+	EFI_STATUS ret;
+	iostats_protocol_t *protocol;
+
+	ret = interface_init(st, &iostats_guid, handle,
+			     &iostats_protocol_default,
+			     sizeof(iostats_protocol_default),
+			     (void **)&protocol);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	protocol->media = media;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS iostats_unregister(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
+{
+	return interface_free(st, &iostats_guid, handle);
+}
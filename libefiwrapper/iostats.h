@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _IOSTATS_H_
+#define _IOSTATS_H_
+
+#include <efi.h>
+#include <efiapi.h>
+#include <ewiostats.h>
+
+struct media;
+
+/* Return the start time of an operation to give to
+ * iostats_account() */
+UINT64 iostats_start(void);
+/* Account an operation of TYPE on BYTES bytes started at START */
+void iostats_account(EFIWRAPPER_IO_STATS *stats, EFIWRAPPER_IO_TYPE type,
+		     UINT64 bytes, UINT64 start, EFI_STATUS status);
+
+EFI_STATUS iostats_register(EFI_SYSTEM_TABLE *st, struct media *media,
+			    EFI_HANDLE *handle);
+EFI_STATUS iostats_unregister(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle);
+
+#endif	/* _IOSTATS_H_ */
@@ -31,12 +31,36 @@
 
 #include "external.h"
 #include "interface.h"
+#include "iostats.h"
 #include "media.h"
 
+#include <ewtrace.h>
+
+/* Block cache size of the storages which do not set cache_size.  The
+ * cache is only enabled by default on host: the target drivers opt in
+ * by setting cache_size as the heap may be small. */
+#ifndef STORAGE_CACHE_DEFAULT_SIZE
+#ifdef HOST
+#define STORAGE_CACHE_DEFAULT_SIZE	(256 * 1024)
+#else
+#define STORAGE_CACHE_DEFAULT_SIZE	0
+#endif
+#endif
+
+/* Read-ahead is only enabled by default on host as well, with windows
+ * of the block cache size.  The target drivers opt in by setting
+ * readahead_size. */
+#ifdef HOST
+#define STORAGE_READAHEAD_DEFAULT	TRUE
+#else
+#define STORAGE_READAHEAD_DEFAULT	FALSE
+#endif
+
 media_t *media_new(storage_t *storage)
 {
 	static UINT32 id;
 	media_t *media;
+	UINT32 size;
 
 	media = calloc(1, sizeof(*media));
 	if (!media)
@@ -49,9 +73,227 @@ media_t *media_new(storage_t *storage)
 
 	media->storage = storage;
 
+	size = storage->cache_size ? storage->cache_size :
+		STORAGE_CACHE_DEFAULT_SIZE;
+	if (!(storage->cache_flags & STORAGE_CACHE_DISABLED) && size &&
+	    storage->blk_sz) {
+		/* Caching is an optimization, go on without it */
+		media->cache = blkcache_new(storage, size / storage->blk_sz,
+					    storage->cache_flags);
+	}
+
+	if (storage->readahead_size)
+		size = storage->readahead_size;
+	else if (!STORAGE_READAHEAD_DEFAULT)
+		size = 0;
+	if (!(storage->cache_flags & STORAGE_READAHEAD_DISABLED) && size)
+		media->ra = readahead_new(storage, media->cache, size);
+
 	return media;
 }
 
+void media_delete(media_t *media)
+{
+	if (!media)
+		return;
+
+	readahead_free(media->ra);
+	blkcache_free(media->cache);
+	free(media);
+}
+
+static EFI_LBA do_read(media_t *media, EFI_LBA start, EFI_LBA count,
+		       void *buf)
+{
+	if (media->ra)
+		return readahead_read(media->ra, start, count, buf);
+
+	if (media->cache)
+		return blkcache_read(media->cache, start, count, buf);
+
+	return media->storage->read(media->storage, start, count, buf);
+}
+
+static EFI_LBA do_write(media_t *media, EFI_LBA start, EFI_LBA count,
+			const void *buf)
+{
+	if (media->ra)
+		readahead_invalidate(media->ra, start, count);
+
+	if (media->cache)
+		return blkcache_write(media->cache, start, count, buf);
+
+	return media->storage->write(media->storage, start, count, buf);
+}
+
+static EFI_LBA do_readv(media_t *media, storage_segment_t *segs, UINTN nb)
+{
+	if (media->ra)
+		return readahead_readv(media->ra, segs, nb);
+
+	if (media->cache)
+		return blkcache_readv(media->cache, segs, nb);
+
+	return storage_readv(media->storage, segs, nb);
+}
+
+static EFI_LBA do_writev(media_t *media, const storage_segment_t *segs,
+			 UINTN nb)
+{
+	EFI_LBA done, total = 0;
+	UINTN i;
+
+	if (media->ra)
+		for (i = 0; i < nb; i++)
+			readahead_invalidate(media->ra, segs[i].start,
+					     segs[i].count);
+
+	if (!media->cache)
+		return storage_writev(media->storage, segs, nb);
+
+	/* Written back blocks are coalesced on flush */
+	for (i = 0; i < nb; i++) {
+		done = blkcache_write(media->cache, segs[i].start,
+				      segs[i].count, segs[i].buf);
+		total += done;
+		if (done != segs[i].count)
+			break;
+	}
+
+	return total;
+}
+
+/* Account an operation on BLOCKS blocks out of EXPECTED */
+static void account(media_t *media, EFIWRAPPER_IO_TYPE type, EFI_LBA blocks,
+		    EFI_LBA expected, UINT64 start)
+{
+	iostats_account(&media->stats, type, blocks * media->m.BlockSize,
+			start, blocks == expected ? EFI_SUCCESS :
+			EFI_DEVICE_ERROR);
+}
+
+static EFI_LBA segments_blocks(const storage_segment_t *segs, UINTN nb)
+{
+	EFI_LBA blocks = 0;
+	UINTN i;
+
+	for (i = 0; i < nb; i++)
+		blocks += segs[i].count;
+
+	return blocks;
+}
+
+EFI_LBA media_read(media_t *media, EFI_LBA start, EFI_LBA count, void *buf)
+{
+	UINT64 time = iostats_start();
+	EFI_LBA done;
+
+	ewtrace_begin("media_read", count);
+	done = do_read(media, start, count, buf);
+	ewtrace_end("media_read");
+	account(media, EfiwrapperIoRead, done, count, time);
+
+	return done;
+}
+
+EFI_LBA media_write(media_t *media, EFI_LBA start, EFI_LBA count,
+		    const void *buf)
+{
+	UINT64 time = iostats_start();
+	EFI_LBA done;
+
+	ewtrace_begin("media_write", count);
+	done = do_write(media, start, count, buf);
+	ewtrace_end("media_write");
+	account(media, EfiwrapperIoWrite, done, count, time);
+
+	return done;
+}
+
+EFI_LBA media_readv(media_t *media, storage_segment_t *segs, UINTN nb)
+{
+	UINT64 time = iostats_start();
+	EFI_LBA done;
+
+	ewtrace_begin("media_readv", nb);
+	done = do_readv(media, segs, nb);
+	ewtrace_end("media_readv");
+	account(media, EfiwrapperIoRead, done, segments_blocks(segs, nb),
+		time);
+
+	return done;
+}
+
+EFI_LBA media_writev(media_t *media, const storage_segment_t *segs, UINTN nb)
+{
+	UINT64 time = iostats_start();
+	EFI_LBA done;
+
+	ewtrace_begin("media_writev", nb);
+	done = do_writev(media, segs, nb);
+	ewtrace_end("media_writev");
+	account(media, EfiwrapperIoWrite, done, segments_blocks(segs, nb),
+		time);
+
+	return done;
+}
+
+EFI_STATUS media_sync(media_t *media, BOOLEAN write, EFI_LBA start,
+		      EFI_LBA count)
+{
+	if (media->ra && write)
+		readahead_invalidate(media->ra, start, count);
+
+	if (!media->cache)
+		return EFI_SUCCESS;
+
+	if (write) {
+		blkcache_invalidate(media->cache, start, count);
+		return EFI_SUCCESS;
+	}
+
+	return blkcache_flush(media->cache);
+}
+
+EFI_STATUS media_flush(media_t *media)
+{
+	UINT64 time = iostats_start();
+	EFI_STATUS ret = EFI_SUCCESS;
+
+	ewtrace_begin("media_flush", 0);
+	if (media->cache)
+		ret = blkcache_flush(media->cache);
+	ewtrace_end("media_flush");
+
+	iostats_account(&media->stats, EfiwrapperIoFlush, 0, time, ret);
+	return ret;
+}
+
+EFI_STATUS media_erase(media_t *media, EFI_LBA start, UINTN size)
+{
+	UINT32 blksz = media->storage->blk_sz;
+	UINT64 time = iostats_start();
+	EFI_STATUS ret;
+
+	if (!media->storage->erase)
+		return EFI_UNSUPPORTED;
+
+	if (media->ra)
+		readahead_invalidate(media->ra, start,
+				     (size + blksz - 1) / blksz);
+
+	if (media->cache)
+		blkcache_invalidate(media->cache, start,
+				    (size + blksz - 1) / blksz);
+
+	ewtrace_begin("media_erase", size);
+	ret = media->storage->erase(media->storage, start, size);
+	ewtrace_end("media_erase");
+	iostats_account(&media->stats, EfiwrapperIoErase, size, time, ret);
+
+	return ret;
+}
+
 /* Randomly generated GUID */
 static EFI_GUID media_guid = { 0xd4b39595, 0xe31b, 0x48d5,
 			       { 0xac, 0xa3, 0x03, 0x1c, 0x61, 0x42, 0xc7, 0xab } };
@@ -66,5 +308,23 @@ EFI_STATUS media_register(EFI_SYSTEM_TABLE *st, media_t *media,
 
 EFI_STATUS media_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
 {
-	return interface_free(st, &media_guid, handle);
+	EFI_STATUS ret;
+	media_t *media;
+	blkcache_t *cache;
+	readahead_t *ra;
+
+	ret = uefi_call_wrapper(st->BootServices->HandleProtocol, 3,
+				handle, &media_guid, (VOID **)&media);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	cache = media->cache;
+	ra = media->ra;
+	ret = interface_free(st, &media_guid, handle);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	readahead_free(ra);
+	blkcache_free(cache);
+	return EFI_SUCCESS;
 }
@@ -34,14 +34,38 @@
 
 #include <efi.h>
 #include <efiapi.h>
+#include <ewiostats.h>
 #include <storage.h>
 
+#include "blkcache.h"
+#include "readahead.h"
+
 typedef struct media {
 	EFI_BLOCK_IO_MEDIA m;
 	storage_t *storage;
+	blkcache_t *cache;
+	readahead_t *ra;
+	EFIWRAPPER_IO_STATS stats;
 } media_t;
 
 media_t *media_new(storage_t *storage);
+void media_delete(media_t *media);
+
+/* Storage accesses going through the block cache and accounted in
+ * the media statistics */
+EFI_LBA media_read(media_t *media, EFI_LBA start, EFI_LBA count,
+		   void *buf);
+EFI_LBA media_write(media_t *media, EFI_LBA start, EFI_LBA count,
+		    const void *buf);
+EFI_LBA media_readv(media_t *media, storage_segment_t *segs, UINTN nb);
+EFI_LBA media_writev(media_t *media, const storage_segment_t *segs, UINTN nb);
+EFI_STATUS media_erase(media_t *media, EFI_LBA start, UINTN size);
+EFI_STATUS media_flush(media_t *media);
+/* Prepare the START to START + COUNT range to be read, or written if
+ * WRITE is TRUE, without going through the block cache */
+EFI_STATUS media_sync(media_t *media, BOOLEAN write, EFI_LBA start,
+		      EFI_LBA count);
+
 EFI_STATUS media_register(EFI_SYSTEM_TABLE *st, media_t *media,
 			  EFI_HANDLE *handle);
 EFI_STATUS media_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle);
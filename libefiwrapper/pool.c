@@ -0,0 +1,479 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ewpool.h>
+
+#include "event.h"
+#include "htable.h"
+#include "interface.h"
+#include "lib.h"
+#include "pool.h"
+
+/* Small allocations are served from per size class slabs to limit
+ * the heap fragmentation and the cost of the short-lived allocations.
+ * Larger allocations go straight to malloc().  Each allocation is
+ * preceded by a header identifying its slab and memory type.
+ *
+ * FreePool() decides whether it owns a buffer without reading the
+ * memory around it: the large allocations are indexed by address and
+ * the slabs are kept sorted by address.  Other buffers are released
+ * with free() as FreePool() always did.
+ *
+ * The slabs and the statistics are protected by the event backend
+ * lock as AllocatePool() and FreePool() can be called from the
+ * notify functions run by the backend threads. */
+#define POOL_MAGIC		0x4c4f4f50 /* "POOL" */
+#define SLAB_MIN_SIZE		4096
+#define SLAB_MIN_OBJECTS	8
+#define LARGE_HTABLE_SIZE	64
+
+/* The headers sizes are multiple of POOL_ALIGN so that the buffers
+ * are as aligned as malloc() returns them, at least 8 bytes as
+ * required by the UEFI specification */
+#define POOL_ALIGN		16
+
+/* Accounting slot of the OEM and OS reserved memory types */
+#define OTHER_TYPE		EfiMaxMemoryType
+
+typedef struct pool_hdr {
+	struct slab *slab;	/* NULL for a large allocation */
+	UINTN size;
+	UINT32 type;
+	UINT32 magic;		/* POOL_MAGIC while allocated */
+} __attribute__((aligned(POOL_ALIGN))) pool_hdr_t;
+
+/* The buffer directly follows the large_t structure */
+typedef struct large {
+	hnode_t node;		/* Indexed by buffer address */
+	pool_hdr_t hdr;
+} large_t;
+
+typedef struct pool_class pool_class_t;
+
+typedef struct slab {
+	struct slab *prev;
+	struct slab *next;
+	pool_class_t *class;
+	pool_hdr_t *free;	/* Chained through the object payload */
+	UINTN used;
+} __attribute__((aligned(POOL_ALIGN))) slab_t;
+
+struct pool_class {
+	UINTN size;		/* Largest allocation of this class */
+	slab_t *partial;	/* Slabs with at least one free object */
+	UINTN nb_empty;
+};
+
+static pool_class_t CLASSES[] = {
+	{ .size = 16 }, { .size = 32 }, { .size = 64 }, { .size = 128 },
+	{ .size = 256 }, { .size = 512 }, { .size = 1024 }, { .size = 2048 }
+};
+
+static EFIWRAPPER_POOL_STATS stats[OTHER_TYPE + 1];
+
+static htable_t large_allocs;
+static slab_t **slabs;		/* Sorted by address */
+static UINTN nb_slabs, slabs_capacity;
+
+static inline pool_hdr_t **next_free(pool_hdr_t *hdr)
+{
+	return (pool_hdr_t **)(hdr + 1);
+}
+
+static UINTN object_size(pool_class_t *class)
+{
+	return sizeof(pool_hdr_t) + class->size;
+}
+
+static UINTN slab_objects(pool_class_t *class)
+{
+	return max((UINTN)SLAB_MIN_OBJECTS,
+		   (SLAB_MIN_SIZE - sizeof(slab_t)) / object_size(class));
+}
+
+static UINT8 *slab_end(slab_t *slab)
+{
+	return (UINT8 *)(slab + 1) +
+		slab_objects(slab->class) * object_size(slab->class);
+}
+
+/* Number of slabs starting at or below ADDR */
+static UINTN slab_rank(const void *addr)
+{
+	UINTN low = 0, high = nb_slabs, mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if ((UINTN)slabs[mid] <= (UINTN)addr)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static EFI_STATUS slab_register(slab_t *slab)
+{
+	UINTN i, capacity;
+	slab_t **tmp;
+
+	if (nb_slabs == slabs_capacity) {
+		capacity = slabs_capacity ? slabs_capacity * 2 : 16;
+		tmp = realloc(slabs, capacity * sizeof(*slabs));
+		if (!tmp)
+			return EFI_OUT_OF_RESOURCES;
+		slabs = tmp;
+		slabs_capacity = capacity;
+	}
+
+	for (i = nb_slabs++; i > 0 && slabs[i - 1] > slab; i--)
+		slabs[i] = slabs[i - 1];
+	slabs[i] = slab;
+
+	return EFI_SUCCESS;
+}
+
+static void slab_unregister(slab_t *slab)
+{
+	UINTN i;
+
+	for (i = slab_rank(slab); i < nb_slabs; i++)
+		slabs[i - 1] = slabs[i];
+	nb_slabs--;
+}
+
+static slab_t *slab_find(const void *addr)
+{
+	UINTN i = slab_rank(addr);
+
+	if (i == 0 || (UINT8 *)addr >= slab_end(slabs[i - 1]))
+		return NULL;
+	return slabs[i - 1];
+}
+
+static void slab_link(slab_t *slab)
+{
+	pool_class_t *class = slab->class;
+
+	slab->prev = NULL;
+	slab->next = class->partial;
+	if (class->partial)
+		class->partial->prev = slab;
+	class->partial = slab;
+}
+
+static void slab_unlink(slab_t *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		slab->class->partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+}
+
+static slab_t *slab_new(pool_class_t *class)
+{
+	slab_t *slab;
+	pool_hdr_t *hdr;
+	UINTN i, nb = slab_objects(class);
+
+	slab = malloc(sizeof(*slab) + nb * object_size(class));
+	if (!slab)
+		return NULL;
+
+	slab->class = class;
+	if (EFI_ERROR(slab_register(slab))) {
+		free(slab);
+		return NULL;
+	}
+
+	slab->used = 0;
+	slab->free = NULL;
+	for (i = nb; i > 0; i--) {
+		hdr = (pool_hdr_t *)((UINT8 *)(slab + 1) +
+				     (i - 1) * object_size(class));
+		hdr->magic = 0;
+		*next_free(hdr) = slab->free;
+		slab->free = hdr;
+	}
+
+	slab_link(slab);
+	class->nb_empty++;
+
+	return slab;
+}
+
+static pool_hdr_t *slab_alloc(pool_class_t *class)
+{
+	slab_t *slab = class->partial;
+	pool_hdr_t *hdr;
+
+	if (!slab) {
+		slab = slab_new(class);
+		if (!slab)
+			return NULL;
+	}
+
+	hdr = slab->free;
+	slab->free = *next_free(hdr);
+	if (slab->used++ == 0)
+		class->nb_empty--;
+	if (!slab->free)
+		slab_unlink(slab);
+
+	hdr->slab = slab;
+	return hdr;
+}
+
+static void slab_release(pool_hdr_t *hdr)
+{
+	slab_t *slab = hdr->slab;
+	pool_class_t *class = slab->class;
+
+	if (!slab->free)
+		slab_link(slab);
+	*next_free(hdr) = slab->free;
+	slab->free = hdr;
+
+	if (--slab->used)
+		return;
+
+	/* Keep a single empty slab per class to absorb alloc/free
+	 * sequences around a slab boundary */
+	if (class->nb_empty++ == 0)
+		return;
+
+	slab_unlink(slab);
+	slab_unregister(slab);
+	class->nb_empty--;
+	free(slab);
+}
+
+static BOOLEAN large_match(hnode_t *node, const void *key)
+{
+	return (VOID *)((large_t *)node + 1) == key;
+}
+
+/* Header of BUF if it was allocated by pool_alloc() and not released
+ * yet.  *OWNED tells whether BUF belongs to the pool at all. */
+static pool_hdr_t *lookup(VOID *buf, BOOLEAN *owned)
+{
+	pool_hdr_t *hdr;
+	hnode_t *node;
+	slab_t *slab;
+	UINTN offset;
+
+	node = htable_find(&large_allocs, hash_ptr(buf), large_match, buf);
+	if (node) {
+		*owned = TRUE;
+		return &((large_t *)node)->hdr;
+	}
+
+	slab = slab_find(buf);
+	*owned = slab != NULL;
+	if (!slab)
+		return NULL;
+
+	offset = (UINT8 *)buf - (UINT8 *)(slab + 1);
+	if (offset % object_size(slab->class) != sizeof(*hdr))
+		return NULL;
+
+	hdr = (pool_hdr_t *)buf - 1;
+	return hdr->magic == POOL_MAGIC ? hdr : NULL;
+}
+
+static EFIWRAPPER_POOL_STATS *type_stats(UINT32 type)
+{
+	return &stats[type < OTHER_TYPE ? type : OTHER_TYPE];
+}
+
+EFI_STATUS pool_alloc(EFI_MEMORY_TYPE type, UINTN size, VOID **buf)
+{
+	EFIWRAPPER_POOL_STATS *s;
+	large_t *large = NULL;
+	pool_hdr_t *hdr;
+	EFI_STATUS ret;
+	size_t i;
+
+	if (!buf || type == EfiConventionalMemory ||
+	    (type >= EfiMaxMemoryType && type <= 0x7fffffff))
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < ARRAY_SIZE(CLASSES); i++)
+		if (size <= CLASSES[i].size)
+			break;
+
+	if (i == ARRAY_SIZE(CLASSES)) {
+		if (size > (UINTN)-1 - sizeof(*large))
+			return EFI_OUT_OF_RESOURCES;
+		large = malloc(sizeof(*large) + size);
+		if (!large)
+			return EFI_OUT_OF_RESOURCES;
+	}
+
+	event_lock();
+
+	if (large) {
+		if (!large_allocs.buckets) {
+			ret = htable_init(&large_allocs, LARGE_HTABLE_SIZE);
+			if (EFI_ERROR(ret)) {
+				event_unlock();
+				free(large);
+				return ret;
+			}
+		}
+		hdr = &large->hdr;
+		hdr->slab = NULL;
+		htable_add(&large_allocs, &large->node, hash_ptr(large + 1));
+	} else {
+		hdr = slab_alloc(&CLASSES[i]);
+		if (!hdr) {
+			event_unlock();
+			return EFI_OUT_OF_RESOURCES;
+		}
+	}
+
+	hdr->size = size;
+	hdr->type = type;
+	hdr->magic = POOL_MAGIC;
+
+	s = type_stats(type);
+	s->CurrentBytes += size;
+	s->PeakBytes = max(s->PeakBytes, s->CurrentBytes);
+	s->CurrentCount++;
+	s->TotalCount++;
+
+	event_unlock();
+
+	*buf = hdr + 1;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS pool_release(VOID *buf)
+{
+	EFIWRAPPER_POOL_STATS *s;
+	large_t *large = NULL;
+	pool_hdr_t *hdr;
+	BOOLEAN owned;
+
+	if (!buf)
+		return EFI_INVALID_PARAMETER;
+
+	event_lock();
+
+	hdr = lookup(buf, &owned);
+	if (!hdr) {
+		event_unlock();
+		/* Buffers allocated by other means are released as
+		 * FreePool() always did */
+		if (owned)
+			return EFI_INVALID_PARAMETER;
+		free(buf);
+		return EFI_SUCCESS;
+	}
+
+	hdr->magic = 0;
+	s = type_stats(hdr->type);
+	s->CurrentBytes -= hdr->size;
+	s->CurrentCount--;
+
+	if (hdr->slab)
+		slab_release(hdr);
+	else {
+		large = (large_t *)buf - 1;
+		htable_del(&large_allocs, &large->node);
+	}
+
+	event_unlock();
+
+	free(large);
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+pool_get_stats(EFIWRAPPER_POOL_STATS_PROTOCOL *This,
+	       EFI_MEMORY_TYPE MemoryType,
+	       EFIWRAPPER_POOL_STATS *Stats)
+{
+	if (!This || !Stats)
+		return EFI_INVALID_PARAMETER;
+
+	event_lock();
+	memcpy(Stats, type_stats(MemoryType), sizeof(*Stats));
+	event_unlock();
+
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+pool_reset_peak(EFIWRAPPER_POOL_STATS_PROTOCOL *This)
+{
+	size_t i;
+
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	event_lock();
+	for (i = 0; i < ARRAY_SIZE(stats); i++)
+		stats[i].PeakBytes = stats[i].CurrentBytes;
+	event_unlock();
+
+	return EFI_SUCCESS;
+}
+
+static EFI_GUID pool_stats_guid = EFIWRAPPER_POOL_STATS_PROTOCOL_GUID;
+static EFI_HANDLE handle;
+
+EFI_STATUS pool_init(EFI_SYSTEM_TABLE *st)
+{
+	EFIWRAPPER_POOL_STATS_PROTOCOL *pool_stats;
+	static EFIWRAPPER_POOL_STATS_PROTOCOL pool_stats_default = {
+		.Revision = EFIWRAPPER_POOL_STATS_PROTOCOL_REVISION,
+		.GetStats = pool_get_stats,
+		.ResetPeak = pool_reset_peak
+	};
+
+	return interface_init(st, &pool_stats_guid, &handle,
+			      &pool_stats_default, sizeof(pool_stats_default),
+			      (void **)&pool_stats);
+}
+
+EFI_STATUS pool_free(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	ret = interface_free(st, &pool_stats_guid, handle);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	handle = NULL;
+	return EFI_SUCCESS;
+}
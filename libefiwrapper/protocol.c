@@ -30,21 +30,369 @@
  */
 
 #include <ewvar.h>
+#include "htable.h"
 #include "lib.h"
 #include "protocol.h"
 
 static EFI_GUID dp_guid = DEVICE_PATH_PROTOCOL;
 
-#define MAX_INTERFACE_NUMBER 32
+/* The protocol database is indexed three ways: by protocol GUID, by
+ * handle and by (handle, protocol GUID) pair.  Each installed
+ * interface is linked both in the list of its handle and in the list
+ * of its protocol so that LocateHandle() and friends enumerate the
+ * result without scanning the whole database. */
+struct interface;
+struct notify;
+struct dp_node;
+
+typedef struct protocol {
+	hnode_t node;
+	EFI_GUID guid;
+	struct interface *first;
+	struct interface *last;
+	UINTN nb;
+	struct notify *notifies;
+} protocol_t;
+
+typedef struct handle {
+	hnode_t node;
+	EFI_HANDLE handle;
+	struct interface *first;
+	struct handle *prev;
+	struct handle *next;
+} handle_t;
 
 typedef struct interface {
-	EFI_HANDLE handle;
-	EFI_GUID protocol;
+	hnode_t node;
+	handle_t *handle;
+	protocol_t *protocol;
 	VOID *interface;
-	BOOLEAN installed;
+	struct interface *hprev;
+	struct interface *hnext;
+	struct interface *pprev;
+	struct interface *pnext;
+	struct dp_node *dpnode;
+	struct interface *dpnext;
 } interface_t;
 
-static interface_t INTERFACES[MAX_INTERFACE_NUMBER];
+/* Device path trie.  Each node stores a copy of one device path node
+ * and the list of DEVICE_PATH_PROTOCOL interfaces whose path ends
+ * there.  It lets LocateDevicePath() find the longest matching prefix
+ * in a single walk of the requested device path. */
+typedef struct dp_node {
+	struct dp_node *parent;
+	struct dp_node *child;
+	struct dp_node *sibling;
+	interface_t *interfaces;
+	UINT8 data[];
+} dp_node_t;
+
+/* RegisterProtocolNotify() registration.  POSITION is the last
+ * interface of the protocol list already reported through this
+ * registration, NULL meaning the beginning of the list. */
+typedef struct notify {
+	struct notify *next;
+	struct notify *pnext;
+	protocol_t *protocol;
+	EFI_EVENT event;
+	interface_t *position;
+} notify_t;
+
+typedef struct interface_key {
+	EFI_HANDLE handle;
+	EFI_GUID *guid;
+} interface_key_t;
+
+#define HTABLE_INITIAL_SIZE 64
+
+static htable_t protocols;
+static htable_t handles;
+static htable_t interfaces;
+
+static handle_t *first_handle, *last_handle;
+static UINTN nb_handles;
+
+static notify_t *notifies;
+static EFI_BOOT_SERVICES *boot_services;
+
+static dp_node_t dp_root;
+
+static inline UINT32 protocol_hash(EFI_GUID *guid)
+{
+	return hash_buf(guid, sizeof(*guid), HASH_INIT);
+}
+
+static inline UINT32 interface_hash(EFI_HANDLE handle, EFI_GUID *guid)
+{
+	return hash_buf(&handle, sizeof(handle), protocol_hash(guid));
+}
+
+static BOOLEAN protocol_match(hnode_t *node, const void *key)
+{
+	return !guidcmp(&((protocol_t *)node)->guid, (EFI_GUID *)key);
+}
+
+static BOOLEAN handle_match(hnode_t *node, const void *key)
+{
+	return ((handle_t *)node)->handle == key;
+}
+
+static BOOLEAN interface_match(hnode_t *node, const void *key)
+{
+	interface_t *inte = (interface_t *)node;
+	const interface_key_t *k = key;
+
+	return inte->handle->handle == k->handle &&
+		!guidcmp(&inte->protocol->guid, k->guid);
+}
+
+static protocol_t *get_protocol(EFI_GUID *guid)
+{
+	return (protocol_t *)htable_find(&protocols, protocol_hash(guid),
+					 protocol_match, guid);
+}
+
+static handle_t *get_handle(EFI_HANDLE handle)
+{
+	return (handle_t *)htable_find(&handles, hash_ptr(handle),
+				       handle_match, handle);
+}
+
+static interface_t *get_interface(EFI_HANDLE handle, EFI_GUID *guid)
+{
+	interface_key_t key = { .handle = handle, .guid = guid };
+
+	return (interface_t *)htable_find(&interfaces,
+					  interface_hash(handle, guid),
+					  interface_match, &key);
+}
+
+/* Protocol entries are never released: the number of distinct
+ * protocol GUIDs is small and keeping them makes the entry a stable
+ * anchor for the per-GUID lists. */
+static protocol_t *protocol_get_or_new(EFI_GUID *guid)
+{
+	protocol_t *prot;
+
+	prot = get_protocol(guid);
+	if (prot)
+		return prot;
+
+	prot = calloc(1, sizeof(*prot));
+	if (!prot)
+		return NULL;
+
+	memcpy(&prot->guid, guid, sizeof(*guid));
+	htable_add(&protocols, &prot->node, protocol_hash(guid));
+
+	return prot;
+}
+
+static handle_t *handle_new(EFI_HANDLE value)
+{
+	handle_t *handle;
+
+	handle = calloc(1, sizeof(*handle));
+	if (!handle)
+		return NULL;
+
+	handle->handle = value ? value : handle;
+	htable_add(&handles, &handle->node, hash_ptr(handle->handle));
+
+	handle->prev = last_handle;
+	if (last_handle)
+		last_handle->next = handle;
+	else
+		first_handle = handle;
+	last_handle = handle;
+	nb_handles++;
+
+	return handle;
+}
+
+static void handle_free(handle_t *handle)
+{
+	htable_del(&handles, &handle->node);
+
+	if (handle->prev)
+		handle->prev->next = handle->next;
+	else
+		first_handle = handle->next;
+	if (handle->next)
+		handle->next->prev = handle->prev;
+	else
+		last_handle = handle->prev;
+	nb_handles--;
+
+	free(handle);
+}
+
+static void interface_link(interface_t *inte)
+{
+	handle_t *handle = inte->handle;
+	protocol_t *prot = inte->protocol;
+
+	htable_add(&interfaces, &inte->node,
+		   interface_hash(handle->handle, &prot->guid));
+
+	inte->hnext = handle->first;
+	if (handle->first)
+		handle->first->hprev = inte;
+	handle->first = inte;
+
+	inte->pprev = prot->last;
+	if (prot->last)
+		prot->last->pnext = inte;
+	else
+		prot->first = inte;
+	prot->last = inte;
+	prot->nb++;
+}
+
+static void interface_unlink(interface_t *inte)
+{
+	handle_t *handle = inte->handle;
+	protocol_t *prot = inte->protocol;
+
+	notify_t *reg;
+
+	htable_del(&interfaces, &inte->node);
+
+	for (reg = prot->notifies; reg; reg = reg->pnext)
+		if (reg->position == inte)
+			reg->position = inte->pprev;
+
+	if (inte->hprev)
+		inte->hprev->hnext = inte->hnext;
+	else
+		handle->first = inte->hnext;
+	if (inte->hnext)
+		inte->hnext->hprev = inte->hprev;
+
+	if (inte->pprev)
+		inte->pprev->pnext = inte->pnext;
+	else
+		prot->first = inte->pnext;
+	if (inte->pnext)
+		inte->pnext->pprev = inte->pprev;
+	else
+		prot->last = inte->pprev;
+	prot->nb--;
+}
+
+static void notify_signal(protocol_t *prot)
+{
+	notify_t *reg, *next;
+
+	for (reg = prot->notifies; reg; reg = next) {
+		next = reg->pnext;
+		uefi_call_wrapper(boot_services->SignalEvent, 1, reg->event);
+	}
+}
+
+static notify_t *get_notify(VOID *registration)
+{
+	notify_t *reg;
+
+	for (reg = notifies; reg; reg = reg->next)
+		if (reg == registration)
+			return reg;
+
+	return NULL;
+}
+
+/* Return the next interface installed since the last call for the
+ * REG registration and move the registration cursor forward. */
+static interface_t *notify_next(notify_t *reg)
+{
+	interface_t *inte;
+
+	inte = reg->position ? reg->position->pnext : reg->protocol->first;
+	if (inte)
+		reg->position = inte;
+
+	return inte;
+}
+
+static inline BOOLEAN dp_node_is_last(EFI_DEVICE_PATH *path)
+{
+	return IsDevicePathEndType(path) ||
+		DevicePathNodeLength(path) < sizeof(*path);
+}
+
+static dp_node_t *dp_child(dp_node_t *parent, EFI_DEVICE_PATH *path)
+{
+	dp_node_t *node;
+	UINTN len = DevicePathNodeLength(path);
+
+	for (node = parent->child; node; node = node->sibling)
+		if (DevicePathNodeLength((EFI_DEVICE_PATH *)node->data) == len &&
+		    !memcmp(node->data, path, len))
+			return node;
+
+	return NULL;
+}
+
+static void dp_prune(dp_node_t *node)
+{
+	dp_node_t **cur, *parent;
+
+	while (node != &dp_root && !node->interfaces && !node->child) {
+		parent = node->parent;
+		for (cur = &parent->child; *cur != node; cur = &(*cur)->sibling)
+			;
+		*cur = node->sibling;
+		free(node);
+		node = parent;
+	}
+}
+
+static EFI_STATUS dp_insert(interface_t *inte)
+{
+	EFI_DEVICE_PATH *path = inte->interface;
+	dp_node_t *node = &dp_root, *child;
+	UINTN len;
+
+	for (; !dp_node_is_last(path); path = NextDevicePathNode(path)) {
+		child = dp_child(node, path);
+		if (!child) {
+			len = DevicePathNodeLength(path);
+			child = calloc(1, sizeof(*child) + len);
+			if (!child) {
+				dp_prune(node);
+				return EFI_OUT_OF_RESOURCES;
+			}
+			memcpy(child->data, path, len);
+			child->parent = node;
+			child->sibling = node->child;
+			node->child = child;
+		}
+		node = child;
+	}
+
+	inte->dpnode = node;
+	inte->dpnext = node->interfaces;
+	node->interfaces = inte;
+
+	return EFI_SUCCESS;
+}
+
+static void dp_remove(interface_t *inte)
+{
+	interface_t **cur;
+	dp_node_t *node = inte->dpnode;
+
+	if (!node)
+		return;
+
+	for (cur = &node->interfaces; *cur != inte; cur = &(*cur)->dpnext)
+		;
+	*cur = inte->dpnext;
+	inte->dpnode = NULL;
+	inte->dpnext = NULL;
+
+	dp_prune(node);
+}
 
 static EFIAPI EFI_STATUS
 install_protocol_interface(EFI_HANDLE *Handle,
@@ -53,38 +401,54 @@ install_protocol_interface(EFI_HANDLE *Handle,
 			   VOID *Interface)
 {
 	interface_t *inte;
-	unsigned int i;
+	protocol_t *prot;
+	handle_t *handle = NULL;
 
 	if (!Handle || !Protocol ||
 	    InterfaceType != EFI_NATIVE_INTERFACE)
 		return EFI_INVALID_PARAMETER;
 
 	if (*Handle) {
-		for (i = 0; i < ARRAY_SIZE(INTERFACES); i++)
-			if (INTERFACES[i].installed &&
-			    !guidcmp(&INTERFACES[i].protocol, Protocol) &&
-			    INTERFACES[i].handle == *Handle)
-				return EFI_INVALID_PARAMETER;
+		if (get_interface(*Handle, Protocol))
+			return EFI_INVALID_PARAMETER;
+		handle = get_handle(*Handle);
 	}
 
-	for (i = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (!inte->installed) {
-			if (*Handle)
-				inte->handle = *Handle;
-			else {
-				inte->handle = inte;
-				*Handle = inte->handle;
-			}
-			memcpy(&inte->protocol, Protocol, sizeof(*Protocol));
-			inte->interface = Interface;
-			inte->installed = TRUE;
+	prot = protocol_get_or_new(Protocol);
+	if (!prot)
+		return EFI_OUT_OF_RESOURCES;
 
-			return EFI_SUCCESS;
+	inte = calloc(1, sizeof(*inte));
+	if (!inte)
+		return EFI_OUT_OF_RESOURCES;
+
+	if (!handle) {
+		handle = handle_new(*Handle);
+		if (!handle) {
+			free(inte);
+			return EFI_OUT_OF_RESOURCES;
 		}
 	}
 
-	return EFI_OUT_OF_RESOURCES;
+	inte->handle = handle;
+	inte->protocol = prot;
+	inte->interface = Interface;
+
+	if (Interface && !guidcmp(Protocol, &dp_guid) &&
+	    EFI_ERROR(dp_insert(inte))) {
+		if (!handle->first)
+			handle_free(handle);
+		free(inte);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	interface_link(inte);
+
+	*Handle = handle->handle;
+
+	notify_signal(prot);
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -93,20 +457,39 @@ reinstall_protocol_interface(EFI_HANDLE Handle,
 			     VOID *OldInterface,
 			     VOID *NewInterface)
 {
-	unsigned int i;
+	EFI_STATUS ret;
+	interface_t *inte;
 
 	if (!Handle || !Protocol)
 		return EFI_INVALID_PARAMETER;
 
-	for (i = 0; i < ARRAY_SIZE(INTERFACES); i++)
-		if (INTERFACES[i].installed &&
-		    INTERFACES[i].handle == Handle &&
-		    INTERFACES[i].interface == OldInterface) {
-			INTERFACES[i].interface = NewInterface;
-			return EFI_SUCCESS;
+	inte = get_interface(Handle, Protocol);
+	if (!inte || inte->interface != OldInterface)
+		return EFI_NOT_FOUND;
+
+	dp_remove(inte);
+	inte->interface = NewInterface;
+
+	if (NewInterface && !guidcmp(Protocol, &dp_guid)) {
+		ret = dp_insert(inte);
+		if (EFI_ERROR(ret)) {
+			/* Best effort: the old path nodes may have been
+			 * pruned and need to be allocated again */
+			inte->interface = OldInterface;
+			if (OldInterface)
+				dp_insert(inte);
+			return ret;
 		}
+	}
+
+	/* Move the interface to the end of the protocol list so that
+	 * the RegisterProtocolNotify() registrations report it again */
+	interface_unlink(inte);
+	interface_link(inte);
 
-	return EFI_NOT_FOUND;
+	notify_signal(inte->protocol);
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -115,22 +498,24 @@ uninstall_protocol_interface(EFI_HANDLE Handle,
 			     VOID *Interface)
 {
 	interface_t *inte;
-	unsigned int i;
+	handle_t *handle;
 
 	if (!Handle || !Protocol)
 		return EFI_INVALID_PARAMETER;
 
-	for (i = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (inte->installed && inte->handle == Handle &&
-		    !guidcmp(&inte->protocol, Protocol) &&
-		    inte->interface == Interface) {
-			inte->installed = FALSE;
-			return EFI_SUCCESS;
-		}
-	}
+	inte = get_interface(Handle, Protocol);
+	if (!inte || inte->interface != Interface)
+		return EFI_NOT_FOUND;
+
+	handle = inte->handle;
+	dp_remove(inte);
+	interface_unlink(inte);
+	free(inte);
+
+	if (!handle->first)
+		handle_free(handle);
 
-	return EFI_NOT_FOUND;
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -139,35 +524,75 @@ handle_protocol(EFI_HANDLE Handle,
 		VOID **Interface)
 {
 	interface_t *inte;
-	unsigned int i;
 
 	if (!Handle || !Protocol || !Interface)
 		return EFI_INVALID_PARAMETER;
 
-	for (i = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (inte->installed &&
-		    inte->handle == Handle &&
-		    !guidcmp(&inte->protocol, Protocol)) {
-			*Interface = inte->interface;
-			return EFI_SUCCESS;
-		}
+	inte = get_interface(Handle, Protocol);
+	if (!inte)
+		return EFI_NOT_FOUND;
+
+	*Interface = inte->interface;
+
+	return EFI_SUCCESS;
+}
+
+static UINTN count_handles(EFI_LOCATE_SEARCH_TYPE SearchType,
+			   protocol_t *prot)
+{
+	if (SearchType == AllHandles)
+		return nb_handles;
+
+	return prot ? prot->nb : 0;
+}
+
+static void fill_handles(EFI_LOCATE_SEARCH_TYPE SearchType,
+			 protocol_t *prot, EFI_HANDLE *buf)
+{
+	handle_t *handle;
+	interface_t *inte;
+
+	if (SearchType == AllHandles) {
+		for (handle = first_handle; handle; handle = handle->next)
+			*buf++ = handle->handle;
+		return;
 	}
 
-	return EFI_NOT_FOUND;
+	for (inte = prot->first; inte; inte = inte->pnext)
+		*buf++ = inte->handle->handle;
+}
+
+/* ByRegisterNotify search returns one handle at a time, the next one
+ * installed since the previous call for this registration. */
+static EFI_STATUS locate_notify_handle(VOID *SearchKey, EFI_HANDLE *handle)
+{
+	notify_t *reg;
+	interface_t *inte;
+
+	reg = get_notify(SearchKey);
+	if (!reg)
+		return EFI_INVALID_PARAMETER;
+
+	inte = notify_next(reg);
+	if (!inte)
+		return EFI_NOT_FOUND;
+
+	*handle = inte->handle->handle;
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
 locate_handle(EFI_LOCATE_SEARCH_TYPE SearchType,
 	      EFI_GUID *Protocol,
-	      __attribute__((__unused__)) VOID *SearchKey,
+	      VOID *SearchKey,
 	      UINTN *BufferSize,
 	      EFI_HANDLE *Buffer)
 {
-	interface_t *inte;
-	unsigned int i, nb = 0;
+	protocol_t *prot = NULL;
+	UINTN nb;
 
-	if (!Protocol || !BufferSize || !Buffer)
+	if (!BufferSize)
 		return EFI_INVALID_PARAMETER;
 
 	if (SearchType != AllHandles &&
@@ -175,89 +600,75 @@ locate_handle(EFI_LOCATE_SEARCH_TYPE SearchType,
 	    SearchType != ByProtocol)
 		return EFI_INVALID_PARAMETER;
 
-	if (SearchType == ByRegisterNotify)
-		return EFI_UNSUPPORTED;
-
-	for (i = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (!inte->installed)
-			continue;
-
-		if (SearchType == ByProtocol &&
-		    guidcmp(&inte->protocol, Protocol))
-			continue;
-
-		if ((nb + 1) * sizeof(*Buffer) > *BufferSize)
+	if (SearchType == ByRegisterNotify) {
+		if (*BufferSize < sizeof(*Buffer)) {
+			*BufferSize = sizeof(*Buffer);
 			return EFI_BUFFER_TOO_SMALL;
+		}
+		if (!Buffer)
+			return EFI_INVALID_PARAMETER;
+		*BufferSize = sizeof(*Buffer);
+		return locate_notify_handle(SearchKey, Buffer);
+	}
 
-		Buffer[nb++] = inte->handle;
+	if (SearchType == ByProtocol) {
+		if (!Protocol)
+			return EFI_INVALID_PARAMETER;
+		prot = get_protocol(Protocol);
 	}
 
+	nb = count_handles(SearchType, prot);
 	if (nb == 0)
 		return EFI_NOT_FOUND;
 
-	*BufferSize = nb * sizeof(*Buffer);
-
-	return EFI_SUCCESS;
-}
+	if (nb * sizeof(*Buffer) > *BufferSize) {
+		*BufferSize = nb * sizeof(*Buffer);
+		return EFI_BUFFER_TOO_SMALL;
+	}
 
-static int dpcmp(EFI_DEVICE_PATH *p1, EFI_DEVICE_PATH *p2)
-{
-	int cmp;
+	if (!Buffer)
+		return EFI_INVALID_PARAMETER;
 
-	while (!IsDevicePathEndType(p1) && !IsDevicePathEndType(p2)) {
-		if (DevicePathNodeLength(p1) < DevicePathNodeLength(p2))
-			return -1;
-		if (DevicePathNodeLength(p1) > DevicePathNodeLength(p2))
-			return 1;
-		cmp = memcmp(p1, p2, DevicePathNodeLength(p1));
-		if (cmp)
-			return cmp;
-		p1 = NextDevicePathNode(p1);
-		p2 = NextDevicePathNode(p2);
-	}
+	fill_handles(SearchType, prot, Buffer);
+	*BufferSize = nb * sizeof(*Buffer);
 
-	return !(IsDevicePathEndType(p1) && IsDevicePathEndType(p2));
+	return EFI_SUCCESS;
 }
 
-static EFIAPI EFI_STATUS
-locate_handle_buffer(EFI_LOCATE_SEARCH_TYPE SearchType,
-		     EFI_GUID *Protocol,
-		     VOID *SearchKey,
-		     UINTN *NoHandles,
-		     EFI_HANDLE **Buffer);
-
 static EFIAPI EFI_STATUS
 locate_device_path(EFI_GUID *Protocol,
 		   EFI_DEVICE_PATH **DevicePath,
 		   EFI_HANDLE *Device)
 {
-	EFI_STATUS ret;
-	UINTN nb_handle, i;
-	EFI_HANDLE *handles;
-	EFI_DEVICE_PATH *path;
+	EFI_DEVICE_PATH *path, *best_path = NULL;
+	dp_node_t *node = &dp_root;
+	interface_t *inte;
+	handle_t *best = NULL;
 
-	if (!Protocol || !DevicePath || !*DevicePath)
+	if (!Protocol || !DevicePath || !*DevicePath || !Device)
 		return EFI_INVALID_PARAMETER;
 
-	ret = locate_handle_buffer(ByProtocol, Protocol, NULL, &nb_handle, &handles);
-	if (EFI_ERROR(ret) || nb_handle == 0)
-		return EFI_NOT_FOUND;
+	for (path = *DevicePath; node; path = NextDevicePathNode(path)) {
+		for (inte = node->interfaces; inte; inte = inte->dpnext)
+			if (get_interface(inte->handle->handle, Protocol)) {
+				best = inte->handle;
+				best_path = path;
+				break;
+			}
 
-	for (i = 0; i < nb_handle; i++) {
-		ret = handle_protocol(handles[i], &dp_guid, (VOID **)&path);
-		if (EFI_ERROR(ret))
-			continue;
+		if (dp_node_is_last(path))
+			break;
 
-		if (path == *DevicePath || !dpcmp(*DevicePath, path)) {
-			*Device = handles[i];
-			free(handles);
-			return EFI_SUCCESS;
-		}
+		node = dp_child(node, path);
 	}
-	free(handles);
 
-	return EFI_UNSUPPORTED;
+	if (!best)
+		return EFI_NOT_FOUND;
+
+	*Device = best->handle;
+	*DevicePath = best_path;
+
+	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
@@ -294,15 +705,16 @@ protocols_per_handle(__attribute__((__unused__)) EFI_HANDLE Handle,
 static EFIAPI EFI_STATUS
 locate_handle_buffer(EFI_LOCATE_SEARCH_TYPE SearchType,
 		     EFI_GUID *Protocol,
-		     __attribute__((__unused__)) VOID *SearchKey,
+		     VOID *SearchKey,
 		     UINTN *NoHandles,
 		     EFI_HANDLE **Buffer)
 {
-	interface_t *inte;
-	unsigned int i, nb, cur;
-	EFI_HANDLE *buf;
+	EFI_STATUS ret;
+	protocol_t *prot = NULL;
+	EFI_HANDLE *buf, handle;
+	UINTN nb;
 
-	if (!Protocol || !NoHandles || !Buffer)
+	if (!NoHandles || !Buffer)
 		return EFI_INVALID_PARAMETER;
 
 	if (SearchType != AllHandles &&
@@ -310,57 +722,162 @@ locate_handle_buffer(EFI_LOCATE_SEARCH_TYPE SearchType,
 	    SearchType != ByProtocol)
 		return EFI_INVALID_PARAMETER;
 
-	if (SearchType == ByRegisterNotify)
-		return EFI_UNSUPPORTED;
+	if (SearchType == ByRegisterNotify) {
+		ret = locate_notify_handle(SearchKey, &handle);
+		if (EFI_ERROR(ret))
+			return ret;
 
-	for (i = 0, nb = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (!inte->installed)
-			continue;
+		ret = uefi_call_wrapper(boot_services->AllocatePool, 3,
+					EfiBootServicesData,
+					sizeof(EFI_HANDLE), (VOID **)&buf);
+		if (EFI_ERROR(ret))
+			return ret;
 
-		if (SearchType == ByProtocol &&
-		    !guidcmp(&inte->protocol, Protocol))
-			nb++;
+		buf[0] = handle;
+		*NoHandles = 1;
+		*Buffer = buf;
+		return EFI_SUCCESS;
 	}
 
+	if (SearchType == ByProtocol) {
+		if (!Protocol)
+			return EFI_INVALID_PARAMETER;
+		prot = get_protocol(Protocol);
+	}
+
+	nb = count_handles(SearchType, prot);
 	if (nb == 0)
 		return EFI_NOT_FOUND;
 
-	buf = malloc(sizeof(EFI_HANDLE) * nb);
-	if (!buf)
-		return EFI_OUT_OF_RESOURCES;
+	ret = uefi_call_wrapper(boot_services->AllocatePool, 3,
+				EfiBootServicesData,
+				sizeof(EFI_HANDLE) * nb, (VOID **)&buf);
+	if (EFI_ERROR(ret))
+		return ret;
 
-	for (i = 0, cur = 0; i < ARRAY_SIZE(INTERFACES); i++) {
-		inte = &INTERFACES[i];
-		if (!inte->installed)
-			continue;
+	fill_handles(SearchType, prot, buf);
 
-		if (SearchType == ByProtocol &&
-		    guidcmp(&inte->protocol, Protocol))
-			continue;
+	*NoHandles = nb;
+	*Buffer = buf;
 
-		buf[cur++] = inte->handle;
+	return EFI_SUCCESS;
+}
+
+static EFIAPI EFI_STATUS
+locate_protocol(EFI_GUID *Protocol,
+		VOID *Registration,
+		VOID **Interface)
+{
+	protocol_t *prot;
+	interface_t *inte;
+	notify_t *reg;
+
+	if (!Interface)
+		return EFI_INVALID_PARAMETER;
+
+	*Interface = NULL;
+
+	if (Registration) {
+		reg = get_notify(Registration);
+		if (!reg)
+			return EFI_NOT_FOUND;
+		inte = notify_next(reg);
+	} else {
+		if (!Protocol)
+			return EFI_INVALID_PARAMETER;
+		prot = get_protocol(Protocol);
+		inte = prot ? prot->first : NULL;
 	}
 
-	*NoHandles = nb;
-	*Buffer = buf;
+	if (!inte)
+		return EFI_NOT_FOUND;
+
+	*Interface = inte->interface;
 
 	return EFI_SUCCESS;
 }
 
 static EFIAPI EFI_STATUS
-locate_protocol(__attribute__((__unused__)) EFI_GUID *Protocol,
-		__attribute__((__unused__)) VOID *Registration,
-		__attribute__((__unused__)) VOID **Interface)
+register_protocol_notify(EFI_GUID *Protocol,
+			 EFI_EVENT Event,
+			 VOID **Registration)
 {
-	return EFI_UNSUPPORTED;
+	protocol_t *prot;
+	notify_t *reg;
+
+	if (!Protocol || !Event || !Registration)
+		return EFI_INVALID_PARAMETER;
+
+	prot = protocol_get_or_new(Protocol);
+	if (!prot)
+		return EFI_OUT_OF_RESOURCES;
+
+	reg = calloc(1, sizeof(*reg));
+	if (!reg)
+		return EFI_OUT_OF_RESOURCES;
+
+	reg->protocol = prot;
+	reg->event = Event;
+	reg->position = prot->last;
+
+	reg->pnext = prot->notifies;
+	prot->notifies = reg;
+	reg->next = notifies;
+	notifies = reg;
+
+	*Registration = reg;
+
+	return EFI_SUCCESS;
+}
+
+void protocol_unregister_notify(EFI_EVENT event)
+{
+	notify_t **cur, **pcur, *reg;
+
+	for (cur = &notifies; *cur;) {
+		reg = *cur;
+		if (reg->event != event) {
+			cur = &reg->next;
+			continue;
+		}
+
+		for (pcur = &reg->protocol->notifies; *pcur != reg;
+		     pcur = &(*pcur)->pnext)
+			;
+		*pcur = reg->pnext;
+
+		*cur = reg->next;
+		free(reg);
+	}
 }
 
 EFI_STATUS protocol_init_bs(EFI_BOOT_SERVICES *bs)
 {
+	EFI_STATUS ret;
+
 	if (!bs)
 		return EFI_INVALID_PARAMETER;
 
+	if (!protocols.buckets) {
+		ret = htable_init(&protocols, HTABLE_INITIAL_SIZE);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	if (!handles.buckets) {
+		ret = htable_init(&handles, HTABLE_INITIAL_SIZE);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	if (!interfaces.buckets) {
+		ret = htable_init(&interfaces, HTABLE_INITIAL_SIZE);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	boot_services = bs;
+
 	bs->InstallProtocolInterface = install_protocol_interface;
 	bs->ReinstallProtocolInterface = reinstall_protocol_interface;
 	bs->UninstallProtocolInterface = uninstall_protocol_interface;
@@ -370,6 +887,7 @@ EFI_STATUS protocol_init_bs(EFI_BOOT_SERVICES *bs)
 	bs->ProtocolsPerHandle = protocols_per_handle;
 	bs->LocateHandleBuffer = locate_handle_buffer;
 	bs->LocateProtocol = locate_protocol;
+	bs->RegisterProtocolNotify = register_protocol_notify;
 	bs->OpenProtocol = open_protocol;
 	bs->CloseProtocol = close_protocol;
 
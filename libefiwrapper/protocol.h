@@ -36,5 +36,6 @@
 #include <efiapi.h>
 
 EFI_STATUS protocol_init_bs(EFI_BOOT_SERVICES *bs);
+void protocol_unregister_notify(EFI_EVENT event);
 
 #endif	/* _PROTOCOL_H_ */
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "external.h"
+#include "lib.h"
+#include "readahead.h"
+
+#include <ewlog.h>
+
+/* The window starts at READAHEAD_MIN_SIZE when a sequential stream is
+ * detected and doubles on each following sequential read, up to the
+ * size given by the storage, the block cache size by default, and at
+ * most READAHEAD_MAX_SIZE.  Two windows of that size are allocated on
+ * the first prefetch. */
+#ifndef READAHEAD_MIN_SIZE
+#define READAHEAD_MIN_SIZE	(64 * 1024)
+#endif
+
+#ifndef READAHEAD_MAX_SIZE
+#define READAHEAD_MAX_SIZE	(1024 * 1024)
+#endif
+
+/* Number of reads adjacent to the previous one making a sequential
+ * stream.  The partition table reads (GPT header then partition array)
+ * are left to the block cache. */
+#define STREAM_THRESHOLD	2
+
+#define NB_WINDOWS	2
+
+typedef struct window {
+	storage_request_t req;	/* Must be first */
+	UINT8 *data;
+	EFI_LBA start;
+	EFI_LBA count;		/* Prefetched blocks, 0 if empty */
+	BOOLEAN pending;	/* Asynchronous request in flight */
+} window_t;
+
+struct readahead {
+	storage_t *storage;
+	blkcache_t *cache;
+	EFI_LBA next;		/* LBA following the previous read */
+	UINTN streak;		/* Consecutive adjacent reads */
+	EFI_LBA size;		/* Current window size in blocks */
+	EFI_LBA min_size;
+	EFI_LBA max_size;
+	BOOLEAN disabled;	/* The windows could not be allocated */
+	UINT8 *data;
+	window_t windows[NB_WINDOWS];
+};
+
+static BOOLEAN is_async(readahead_t *ra)
+{
+	return ra->storage->submit && ra->storage->poll;
+}
+
+/* Unaligned sequential reads, through DiskIo for instance, share
+ * their boundary block with the previous read */
+static BOOLEAN adjacent(readahead_t *ra, EFI_LBA start)
+{
+	return start == ra->next || start + 1 == ra->next;
+}
+
+static BOOLEAN contains(window_t *w, EFI_LBA lba)
+{
+	return w->count && lba >= w->start && lba < w->start + w->count;
+}
+
+static void wait(readahead_t *ra, window_t *w)
+{
+	while (w->pending)
+		ra->storage->poll(ra->storage);
+}
+
+static window_t *find(readahead_t *ra, EFI_LBA lba)
+{
+	size_t i;
+
+	for (i = 0; i < NB_WINDOWS; i++)
+		if (contains(&ra->windows[i], lba))
+			return &ra->windows[i];
+
+	return NULL;
+}
+
+/* Return a window which does not hold block KEEP, ready to be
+ * filled */
+static window_t *victim(readahead_t *ra, EFI_LBA keep)
+{
+	window_t *w = &ra->windows[0];
+	size_t i;
+
+	for (i = 0; i < NB_WINDOWS; i++)
+		if (!contains(&ra->windows[i], keep)) {
+			w = &ra->windows[i];
+			break;
+		}
+
+	wait(ra, w);
+	return w;
+}
+
+static void fill_done(storage_request_t *req, EFI_STATUS status)
+{
+	window_t *w = (window_t *)req;
+
+	if (EFI_ERROR(status))
+		w->count = 0;
+	w->pending = FALSE;
+}
+
+/* Prefetch COUNT blocks starting at START into W.  The request is
+ * left in flight if the storage is asynchronous. */
+static void fill(readahead_t *ra, window_t *w, EFI_LBA start, EFI_LBA count)
+{
+	storage_t *storage = ra->storage;
+
+	if (start >= storage->blk_cnt)
+		return;
+	count = min(count, storage->blk_cnt - start);
+
+	if (!ra->data) {
+		ra->data = malloc(NB_WINDOWS * ra->max_size * storage->blk_sz);
+		if (!ra->data) {
+			ewerr("Failed to allocate the read-ahead windows, "
+			      "read-ahead disabled");
+			ra->disabled = TRUE;
+			return;
+		}
+		ra->windows[0].data = ra->data;
+		ra->windows[1].data = ra->data + ra->max_size * storage->blk_sz;
+	}
+
+	/* The storage must be up to date to be read directly */
+	if (ra->cache && EFI_ERROR(blkcache_flush(ra->cache)))
+		return;
+
+	w->start = start;
+	w->count = count;
+
+	if (!is_async(ra)) {
+		w->count = storage->read(storage, start, count, w->data);
+		return;
+	}
+
+	w->req.write = FALSE;
+	w->req.start = start;
+	w->req.count = count;
+	w->req.buf = w->data;
+	w->req.done = fill_done;
+	w->pending = TRUE;
+	if (EFI_ERROR(storage->submit(storage, &w->req))) {
+		w->pending = FALSE;
+		w->count = 0;
+	}
+}
+
+/* Copy the blocks of the START to START + COUNT range which are
+ * prefetched, starting from START, to BUF.  Return the number of
+ * blocks copied. */
+static EFI_LBA copy(readahead_t *ra, EFI_LBA start, EFI_LBA count,
+		    UINT8 *buf)
+{
+	UINT32 blksz = ra->storage->blk_sz;
+	EFI_LBA done = 0, n;
+	window_t *w;
+
+	while (done < count && (w = find(ra, start + done))) {
+		wait(ra, w);
+		if (!contains(w, start + done))
+			continue;
+
+		n = min(w->start + w->count - (start + done), count - done);
+		memcpy(buf + done * blksz,
+		       w->data + (start + done - w->start) * blksz,
+		       n * blksz);
+		done += n;
+	}
+
+	return done;
+}
+
+static EFI_LBA read_direct(readahead_t *ra, EFI_LBA start, EFI_LBA count,
+			   void *buf)
+{
+	if (ra->cache)
+		return blkcache_read(ra->cache, start, count, buf);
+
+	return ra->storage->read(ra->storage, start, count, buf);
+}
+
+/* Keep the window following the one holding the next expected block
+ * in flight so that it is ready when the caller asks for it */
+static void prefetch(readahead_t *ra)
+{
+	EFI_LBA lba = ra->next;
+	window_t *w;
+
+	w = find(ra, lba);
+	if (w) {
+		if (!is_async(ra))
+			return;
+		lba = w->start + w->count;
+		if (find(ra, lba))
+			return;
+	}
+
+	fill(ra, victim(ra, ra->next), lba, ra->size);
+}
+
+EFI_LBA readahead_read(readahead_t *ra, EFI_LBA start, EFI_LBA count,
+		       void *buf)
+{
+	UINT32 blksz = ra->storage->blk_sz;
+	UINT8 *p = buf;
+	EFI_LBA done, rest, n;
+	BOOLEAN sequential;
+
+	if (ra->disabled)
+		return read_direct(ra, start, count, buf);
+
+	ra->streak = adjacent(ra, start) ? ra->streak + 1 : 0;
+	ra->next = start + count;
+
+	sequential = ra->streak >= STREAM_THRESHOLD;
+	if (ra->streak > STREAM_THRESHOLD)
+		ra->size = min(ra->size * 2, ra->max_size);
+	else
+		ra->size = ra->min_size;
+
+	done = copy(ra, start, count, p);
+	rest = count - done;
+
+	/* The rest of a sequential read is read along with the next
+	 * window with a single larger request */
+	if (rest && sequential && rest < ra->max_size) {
+		fill(ra, victim(ra, start + done), start + done,
+		     min(rest + ra->size, ra->max_size));
+		done += copy(ra, start + done, rest, p + done * blksz);
+		rest = count - done;
+	}
+
+	if (rest) {
+		n = read_direct(ra, start + done, rest, p + done * blksz);
+		done += n;
+		if (n != rest)
+			return done;
+	}
+
+	if (sequential)
+		prefetch(ra);
+
+	return done;
+}
+
+/* The segments of a vectored read belonging to a sequential stream
+ * are served from the windows one by one.  Otherwise they are passed
+ * through as a single request, only accounted for the detection of
+ * the stream. */
+EFI_LBA readahead_readv(readahead_t *ra, storage_segment_t *segs, UINTN nb)
+{
+	EFI_LBA done, total = 0;
+	UINTN i;
+
+	if (!nb)
+		return 0;
+
+	if (!ra->disabled && adjacent(ra, segs[0].start) &&
+	    ra->streak + 1 >= STREAM_THRESHOLD) {
+		for (i = 0; i < nb; i++) {
+			done = readahead_read(ra, segs[i].start, segs[i].count,
+					      segs[i].buf);
+			total += done;
+			if (done != segs[i].count)
+				break;
+		}
+		return total;
+	}
+
+	ra->streak = adjacent(ra, segs[0].start) ? ra->streak + 1 : 0;
+	ra->next = segs[nb - 1].start + segs[nb - 1].count;
+
+	if (ra->cache)
+		return blkcache_readv(ra->cache, segs, nb);
+
+	return storage_readv(ra->storage, segs, nb);
+}
+
+void readahead_invalidate(readahead_t *ra, EFI_LBA start, EFI_LBA count)
+{
+	window_t *w;
+	size_t i;
+
+	for (i = 0; i < NB_WINDOWS; i++) {
+		w = &ra->windows[i];
+		if (!w->count || w->start >= start + count ||
+		    w->start + w->count <= start)
+			continue;
+
+		wait(ra, w);
+		w->count = 0;
+	}
+}
+
+readahead_t *readahead_new(storage_t *storage, blkcache_t *cache,
+			   UINT32 max_size)
+{
+	readahead_t *ra;
+
+	if (!storage || !storage->blk_sz || !storage->blk_cnt)
+		return NULL;
+
+	ra = calloc(1, sizeof(*ra));
+	if (!ra)
+		return NULL;
+
+	ra->storage = storage;
+	ra->cache = cache;
+	ra->next = (EFI_LBA)-1;
+	max_size = min(max_size, (UINT32)READAHEAD_MAX_SIZE);
+	ra->max_size = max(max_size / storage->blk_sz, (UINT32)1);
+	ra->min_size = min((EFI_LBA)READAHEAD_MIN_SIZE / storage->blk_sz,
+			   ra->max_size);
+	ra->min_size = max(ra->min_size, (EFI_LBA)1);
+	ra->size = ra->min_size;
+
+	return ra;
+}
+
+void readahead_free(readahead_t *ra)
+{
+	size_t i;
+
+	if (!ra)
+		return;
+
+	for (i = 0; i < NB_WINDOWS; i++)
+		wait(ra, &ra->windows[i]);
+
+	free(ra->data);
+	free(ra);
+}
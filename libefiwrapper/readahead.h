@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _READAHEAD_H_
+#define _READAHEAD_H_
+
+#include <efi.h>
+#include <efiapi.h>
+#include <storage.h>
+
+#include "blkcache.h"
+
+typedef struct readahead readahead_t;
+
+/* Readahead of the sequential reads of STORAGE.  CACHE, which may be
+ * NULL, is the block cache the non sequential reads go through. */
+/* MAX_SIZE is the largest prefetch window in bytes */
+readahead_t *readahead_new(storage_t *storage, blkcache_t *cache,
+			   UINT32 max_size);
+void readahead_free(readahead_t *ra);
+
+EFI_LBA readahead_read(readahead_t *ra, EFI_LBA start, EFI_LBA count,
+		       void *buf);
+/* Drop the prefetched blocks of the START to START + COUNT range */
+EFI_LBA readahead_readv(readahead_t *ra, storage_segment_t *segs, UINTN nb);
+void readahead_invalidate(readahead_t *ra, EFI_LBA start, EFI_LBA count);
+
+#endif	/* _READAHEAD_H_ */
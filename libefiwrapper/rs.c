@@ -29,6 +29,9 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ewevent.h>
+#include <ewlog.h>
+
 #include "ewvar.h"
 #include "lib.h"
 #include "rs.h"
@@ -42,7 +45,7 @@ rs_get_variable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 *Attributes,
 	if (!VariableName || !VendorGuid || !Attributes || !DataSize || !Data)
 		return EFI_INVALID_PARAMETER;
 
-	var = ewvar_get(VariableName, VendorGuid, NULL);
+	var = ewvar_get(VariableName, VendorGuid);
 	if (!var)
 		return EFI_NOT_FOUND;
 
@@ -72,7 +75,7 @@ rs_get_next_variable_name(UINTN *VariableNameSize,
 	if (VariableName[0] == '\0')
 		var = ewvar_get_first();
 	else {
-		var = ewvar_get(VariableName, VendorGuid, NULL);
+		var = ewvar_get(VariableName, VendorGuid);
 		var = var ? var->next : NULL;
 	}
 
@@ -96,7 +99,7 @@ rs_set_variable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
 		UINTN DataSize, VOID *Data)
 {
 	EFI_STATUS ret;
-	ewvar_t *var, *prev;
+	ewvar_t *var;
 
 	if (!VariableName || !VendorGuid)
 		return EFI_INVALID_PARAMETER;
@@ -105,12 +108,12 @@ rs_set_variable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
 	    Attributes & EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
 		return EFI_UNSUPPORTED;
 
-	var = ewvar_get(VariableName, VendorGuid, &prev);
+	var = ewvar_get(VariableName, VendorGuid);
 
 	if (!Data) {
 		if (!var)
 			return EFI_NOT_FOUND;
-		return ewvar_del(var, prev);
+		return ewvar_del(var);
 	}
 
 	if (var) {
@@ -128,9 +131,11 @@ rs_set_variable(CHAR16 *VariableName, EFI_GUID *VendorGuid, UINT32 Attributes,
 	if (!var)
 		return EFI_OUT_OF_RESOURCES;
 
-	ewvar_add(var);
+	ret = ewvar_add(var);
+	if (EFI_ERROR(ret))
+		ewvar_free(var);
 
-	return EFI_SUCCESS;
+	return ret;
 }
 
 static EFIAPI EFI_STATUS
@@ -240,15 +245,57 @@ static EFI_RUNTIME_SERVICES runtime_services_default = {
 	.QueryVariableInfo = rs_query_variable_info
 };
 
+static EFI_EVENT exit_bs_event;
+
+static EFIAPI VOID
+flush_variables(__attribute__((__unused__)) EFI_EVENT Event,
+		__attribute__((__unused__)) VOID *Context)
+{
+	EFI_STATUS ret;
+
+	ret = ewvar_flush();
+	if (EFI_ERROR(ret))
+		ewerr("Failed to flush the variables: %x", (UINT32)ret);
+}
+
 EFI_STATUS rs_init(EFI_SYSTEM_TABLE *st)
 {
+	static EFI_GUID exit_bs_group = EFI_EVENT_GROUP_EXIT_BOOT_SERVICES;
 	EFI_RUNTIME_SERVICES *rs;
+	EFI_STATUS ret;
 
-	if (!st || !st->RuntimeServices)
+	if (!st || !st->RuntimeServices || !st->BootServices)
 		return EFI_INVALID_PARAMETER;
 
 	rs = st->RuntimeServices;
 	memcpy(rs, &runtime_services_default, sizeof(*rs));
 
+	/* Variable writes may be buffered by the storage backend */
+	ret = uefi_call_wrapper(st->BootServices->CreateEventEx, 6,
+				EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+				flush_variables, NULL, &exit_bs_group,
+				&exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
 	return crc32((void *)rs, sizeof(*rs), &rs->Hdr.CRC32);
 }
+
+EFI_STATUS rs_free(EFI_SYSTEM_TABLE *st)
+{
+	EFI_STATUS ret;
+
+	if (!st || !st->BootServices)
+		return EFI_INVALID_PARAMETER;
+
+	if (!exit_bs_event)
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(st->BootServices->CloseEvent, 1,
+				exit_bs_event);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	exit_bs_event = NULL;
+	return EFI_SUCCESS;
+}
@@ -36,5 +36,6 @@
 #include <efiapi.h>
 
 EFI_STATUS rs_init(EFI_SYSTEM_TABLE *st);
+EFI_STATUS rs_free(EFI_SYSTEM_TABLE *st);
 
 #endif	/* _RS_H_ */
@@ -29,7 +29,8 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "external.h"
+#include "console.h"
+#include "event.h"
 #include "interface.h"
 #include "serialio.h"
 
@@ -43,26 +44,43 @@ static EFIAPI EFI_STATUS
 serialio_write(__attribute__((__unused__)) SERIAL_IO_INTERFACE *This,
 	       UINTN *BufferSize, VOID *Buffer)
 {
-	size_t i;
-
 	if (!This || !BufferSize || !Buffer)
 		return EFI_INVALID_PARAMETER;
 
-	for (i = 0; i < *BufferSize; i++)
-		printf("%c", ((char *)Buffer)[i]);
+	event_lock();
+	console_write(Buffer, *BufferSize);
+	console_flush();
+	event_unlock();
 
 	return EFI_SUCCESS;
 }
 
+#define DEFAULT_BAUD_RATE	115200
+#define DEFAULT_FIFO_DEPTH	1
+#define DEFAULT_TIMEOUT		1000000	/* Microseconds */
+#define DEFAULT_DATA_BITS	8
+
 static EFIAPI EFI_STATUS
-serialio_set_attributes(__attribute__((__unused__)) struct _SERIAL_IO_INTERFACE *This,
-			__attribute__((__unused__)) UINT64 BaudRate,
-			__attribute__((__unused__)) UINT32 ReceiveFifoDepth,
-			__attribute__((__unused__)) UINT32 Timeout,
-			__attribute__((__unused__)) EFI_PARITY_TYPE Parity,
-			__attribute__((__unused__)) UINT8 DataBits,
-			__attribute__((__unused__)) EFI_STOP_BITS_TYPE StopBits)
+serialio_set_attributes(struct _SERIAL_IO_INTERFACE *This,
+			UINT64 BaudRate,
+			UINT32 ReceiveFifoDepth,
+			UINT32 Timeout,
+			EFI_PARITY_TYPE Parity,
+			UINT8 DataBits,
+			EFI_STOP_BITS_TYPE StopBits)
 {
+	if (!This)
+		return EFI_INVALID_PARAMETER;
+
+	This->Mode->BaudRate = BaudRate ? BaudRate : DEFAULT_BAUD_RATE;
+	This->Mode->ReceiveFifoDepth = ReceiveFifoDepth ? ReceiveFifoDepth :
+		DEFAULT_FIFO_DEPTH;
+	This->Mode->Timeout = Timeout ? Timeout : DEFAULT_TIMEOUT;
+	This->Mode->Parity = Parity == DefaultParity ? NoParity : Parity;
+	This->Mode->DataBits = DataBits ? DataBits : DEFAULT_DATA_BITS;
+	This->Mode->StopBits = StopBits == DefaultStopBits ? OneStopBit :
+		StopBits;
+
 	return EFI_SUCCESS;
 }
 
@@ -88,7 +106,14 @@ serialio_read(__attribute__((__unused__)) SERIAL_IO_INTERFACE *This,
 	return EFI_UNSUPPORTED;
 }
 
-static SERIAL_IO_MODE io_mode;
+static SERIAL_IO_MODE io_mode = {
+	.Timeout = DEFAULT_TIMEOUT,
+	.BaudRate = DEFAULT_BAUD_RATE,
+	.ReceiveFifoDepth = DEFAULT_FIFO_DEPTH,
+	.DataBits = DEFAULT_DATA_BITS,
+	.Parity = NoParity,
+	.StopBits = OneStopBit
+};
 static EFI_GUID serialio_guid = SERIAL_IO_PROTOCOL;
 static EFI_HANDLE handle;
 
@@ -29,10 +29,13 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "blkcache.h"
 #include "blockio.h"
+#include "blockio2.h"
 #include "diskio.h"
 #include "eraseblk.h"
 #include "external.h"
+#include "iostats.h"
 #include "lib.h"
 #include "media.h"
 #include "interface.h"
@@ -145,7 +148,10 @@ static struct storage_interface {
 	{ "media", media_register, media_free },
 	{ "device path", dp_init, dp_free },
 	{ "blockio", blockio_init, blockio_free },
+	{ "blockio2", blockio2_init, blockio2_free },
 	{ "diskio", diskio_init, diskio_free },
+	{ "block cache", blkcache_register, blkcache_unregister },
+	{ "I/O statistics", iostats_register, iostats_unregister },
 	{ "eraseblock", erase_block_init, erase_block_free }
 };
 
@@ -187,13 +193,24 @@ EFI_STATUS storage_init(EFI_SYSTEM_TABLE *st, storage_t *storage,
 	return EFI_SUCCESS;
 
 err:
-	for (j = 0; j < i; j++) {
-		tmp_ret = STORAGE_INTERFACES[i].free(st, handle);
-		if (EFI_ERROR(tmp_ret))
+	/* Reverse order as the interfaces rely on the media one, whose
+	 * release frees the media.  If an interface cannot be released,
+	 * the media is leaked as it is still referenced. */
+	for (j = i; j-- > 0; ) {
+		res = strcmp("eraseblock", STORAGE_INTERFACES[j].name);
+		if (!res && (boot_dev.type != STORAGE_VIRTUAL))
+			continue;
+
+		tmp_ret = STORAGE_INTERFACES[j].free(st, *handle);
+		if (EFI_ERROR(tmp_ret)) {
 			ewerr("Failed to unregister %s interface",
-			      STORAGE_INTERFACES[i].name);
+			      STORAGE_INTERFACES[j].name);
+			return ret;
+		}
 	}
-	free(media);
+
+	if (i == 0)
+		media_delete(media);
 	return ret;
 }
 
@@ -206,7 +223,8 @@ EFI_STATUS storage_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
 	if (!st || !handle)
 		return EFI_INVALID_PARAMETER;
 
-	for (i = 0; i < ARRAY_SIZE(STORAGE_INTERFACES); i++) {
+	/* Reverse order as the interfaces rely on the media one */
+	for (i = ARRAY_SIZE(STORAGE_INTERFACES); i-- > 0; ) {
 		res = strcmp("eraseblock", STORAGE_INTERFACES[i].name);
 		if (!res && (boot_dev.type != STORAGE_VIRTUAL))
 			continue;
@@ -222,6 +240,45 @@ EFI_STATUS storage_free(EFI_SYSTEM_TABLE *st, EFI_HANDLE handle)
 	return EFI_SUCCESS;
 }
 
+EFI_LBA storage_readv(storage_t *storage, storage_segment_t *segs, UINTN nb)
+{
+	EFI_LBA done, total = 0;
+	UINTN i;
+
+	if (storage->readv)
+		return storage->readv(storage, segs, nb);
+
+	for (i = 0; i < nb; i++) {
+		done = storage->read(storage, segs[i].start, segs[i].count,
+				     segs[i].buf);
+		total += done;
+		if (done != segs[i].count)
+			break;
+	}
+
+	return total;
+}
+
+EFI_LBA storage_writev(storage_t *storage, const storage_segment_t *segs,
+		       UINTN nb)
+{
+	EFI_LBA done, total = 0;
+	UINTN i;
+
+	if (storage->writev)
+		return storage->writev(storage, segs, nb);
+
+	for (i = 0; i < nb; i++) {
+		done = storage->write(storage, segs[i].start, segs[i].count,
+				      segs[i].buf);
+		total += done;
+		if (done != segs[i].count)
+			break;
+	}
+
+	return total;
+}
+
 static enum storage_type convert_sbl_dev_type(SBL_OS_BOOT_MEDIUM_TYPE type)
 {
 	switch(type) {
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lib.h"
+#include "timer_wheel.h"
+
+#define LEVEL_SHIFT(l)	((l) * WHEEL_BITS)
+#define LEVEL_SPAN(l)	((UINT64)1 << LEVEL_SHIFT(l))
+#define SLOT(e, l)	(((e) >> LEVEL_SHIFT(l)) & (WHEEL_SIZE - 1))
+
+static void list_init(wtimer_t *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static BOOLEAN list_empty(wtimer_t *head)
+{
+	return head->next == head;
+}
+
+static void list_add_tail(wtimer_t *head, wtimer_t *t)
+{
+	t->next = head;
+	t->prev = head->prev;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+static void list_del(wtimer_t *t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = t->prev = NULL;
+}
+
+void wheel_init(wheel_t *w, UINT64 tick)
+{
+	size_t l, i;
+
+	w->tick = tick;
+	w->count = 0;
+	list_init(&w->expired);
+	for (l = 0; l < WHEEL_LEVELS; l++)
+		for (i = 0; i < WHEEL_SIZE; i++)
+			list_init(&w->slots[l][i]);
+}
+
+static void queue(wheel_t *w, wtimer_t *t)
+{
+	UINT64 e = t->expires, delta;
+	size_t l;
+
+	if (e <= w->tick) {
+		list_add_tail(&w->expired, t);
+		return;
+	}
+
+	delta = e - w->tick;
+	for (l = 0; l < WHEEL_LEVELS - 1; l++)
+		if (delta < LEVEL_SPAN(l + 1))
+			break;
+
+	/* Timers beyond the wheel range wait in the farthest slot of
+	 * the last level and are queued again from there */
+	if (delta >= LEVEL_SPAN(WHEEL_LEVELS))
+		e = w->tick + LEVEL_SPAN(WHEEL_LEVELS) - 1;
+
+	list_add_tail(&w->slots[l][SLOT(e, l)], t);
+}
+
+void wheel_add(wheel_t *w, wtimer_t *t)
+{
+	queue(w, t);
+	w->count++;
+}
+
+void wheel_del(wheel_t *w, wtimer_t *t)
+{
+	if (!wtimer_pending(t))
+		return;
+
+	list_del(t);
+	w->count--;
+}
+
+static void cascade(wheel_t *w, size_t level, size_t slot)
+{
+	wtimer_t *head = &w->slots[level][slot], *t;
+
+	while (!list_empty(head)) {
+		t = head->next;
+		list_del(t);
+		queue(w, t);
+	}
+}
+
+static void step(wheel_t *w)
+{
+	wtimer_t *head;
+	size_t l, slot;
+
+	w->tick++;
+	slot = SLOT(w->tick, 0);
+
+	if (slot == 0)
+		for (l = 1; l < WHEEL_LEVELS; l++) {
+			cascade(w, l, SLOT(w->tick, l));
+			if (SLOT(w->tick, l))
+				break;
+		}
+
+	head = &w->slots[0][slot];
+	if (list_empty(head))
+		return;
+
+	/* Splice the slot at the end of the expired list */
+	head->next->prev = w->expired.prev;
+	w->expired.prev->next = head->next;
+	head->prev->next = &w->expired;
+	w->expired.prev = head->prev;
+	list_init(head);
+}
+
+wtimer_t *wheel_expire(wheel_t *w, UINT64 tick)
+{
+	wtimer_t *t;
+	UINT64 next;
+
+	for (;;) {
+		if (!list_empty(&w->expired)) {
+			t = w->expired.next;
+			list_del(t);
+			w->count--;
+			return t;
+		}
+
+		if (w->tick >= tick)
+			return NULL;
+
+		if (!w->count) {
+			w->tick = tick;
+			return NULL;
+		}
+
+		/* Nothing happens until the next expiration or cascade */
+		next = wheel_next(w);
+		next = min(next, tick);
+		if (next > w->tick + 1)
+			w->tick = next - 1;
+
+		step(w);
+	}
+}
+
+UINT64 wheel_next(wheel_t *w)
+{
+	UINT64 next = WHEEL_NEVER, base;
+	size_t l, i;
+
+	if (!list_empty(&w->expired))
+		return w->tick;
+
+	for (i = 1; i < WHEEL_SIZE; i++)
+		if (!list_empty(&w->slots[0][SLOT(w->tick + i, 0)])) {
+			next = w->tick + i;
+			break;
+		}
+
+	for (l = 1; l < WHEEL_LEVELS; l++) {
+		base = w->tick >> LEVEL_SHIFT(l);
+		for (i = 1; i <= WHEEL_SIZE; i++)
+			if (!list_empty(&w->slots[l][SLOT(base + i, 0)])) {
+				next = min(next, (base + i) << LEVEL_SHIFT(l));
+				break;
+			}
+	}
+
+	return next;
+}
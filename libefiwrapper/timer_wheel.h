@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <efi.h>
+#include <efiapi.h>
+
+/* Hierarchical timer wheel.  Level N slots cover 64^N ticks; timers
+ * are moved down one level when their slot comes up. */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_LEVELS	4
+#define WHEEL_NEVER	((UINT64)-1)
+
+typedef struct wtimer {
+	struct wtimer *next;	/* NULL when not queued */
+	struct wtimer *prev;
+	UINT64 expires;		/* In ticks */
+} wtimer_t;
+
+typedef struct wheel {
+	UINT64 tick;
+	UINTN count;
+	wtimer_t expired;
+	wtimer_t slots[WHEEL_LEVELS][WHEEL_SIZE];
+} wheel_t;
+
+void wheel_init(wheel_t *w, UINT64 tick);
+void wheel_add(wheel_t *w, wtimer_t *t);
+void wheel_del(wheel_t *w, wtimer_t *t);
+
+/* Return one of the timers expired at TICK and remove it from the
+ * wheel, NULL if there is none left. */
+wtimer_t *wheel_expire(wheel_t *w, UINT64 tick);
+
+/* Earliest tick at which wheel_expire() may return a timer */
+UINT64 wheel_next(wheel_t *w);
+
+static inline BOOLEAN wtimer_pending(wtimer_t *t)
+{
+	return t->next != NULL;
+}
+
+#endif	/* _TIMER_WHEEL_H_ */
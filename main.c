@@ -36,6 +36,7 @@
 #include <ewvar.h>
 #include <ewdrv.h>
 #include <ewlog.h>
+#include <ewprof.h>
 
 /* Entry point */
 int main(int argc, char **argv)
@@ -56,10 +57,20 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+#ifdef PROFILE_SERVICES
+	ret = ewprof_start(st);
+	if (EFI_ERROR(ret))
+		ewerr("Failed to start the services profiler");
+#endif
+
 	ret = efi_main(image, st);
 	if (EFI_ERROR(ret))
 		ewerr("The EFI program exited with error code: 0x%x", ret);
 
+#ifdef PROFILE_SERVICES
+	ewprof_stop(st);
+#endif
+
 	ret = ewdrv_exit(st);
 	if (ret)
 		ewerr("drivers release failed");